@@ -10,6 +10,7 @@
 #include <iostream>
 #include <sstream>
 #include <cstring>
+#include <cstddef>
 
 START_NKF_NET
 
@@ -35,11 +36,20 @@ Address::Address(std::string addr, unsigned short port) :
 
 	INC_WS_REF	// winsock needs to be initialized to use this
 
+	struct addrinfo hints;
 	struct addrinfo *result;
 
-	RoR(::getaddrinfo(addr.c_str(), NULL, NULL, &result));
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
 
-	memcpy(&_addrIn, result->ai_addr, sizeof(_addr));
+	int error = ::getaddrinfo(addr.c_str(), NULL, &hints, &result);
+	if (error != 0) {
+		DEC_WS_REF
+		throw SocketException(gai_strerror(error), error);
+	}
+
+	init(0, port);
+	_addrIn.sin_addr = reinterpret_cast<sockaddr_in*>(result->ai_addr)->sin_addr;
 
 	::freeaddrinfo(result);
 
@@ -50,13 +60,70 @@ Address::Address(std::string addr, unsigned short port) :
 
 Address::Address(const Address & addr) :
 	_addr(reinterpret_cast<sockaddr*> (&_addrIn)) {
-	init(ntohl(addr._addrIn.sin_addr.s_addr), ntohs(addr._addrIn.sin_port));
+	memcpy(&_addrUn, &addr._addrUn, sizeof(_addrUn));
+	_addrSize = addr._addrSize;
+}
+
+// --------------------------------------------------------------------------
+
+Address::Address(const sockaddr * addr, socklen_t size) :
+	_addr(reinterpret_cast<sockaddr*> (&_addrIn)) {
+	if (size > _addrMaxSize) size = _addrMaxSize;
+	memset(&_addrUn, 0, sizeof(_addrUn));
+	memcpy(&_addrUn, addr, size);
+	_addrSize = size;
+}
+
+// --------------------------------------------------------------------------
+
+Address & Address::operator=(const Address & addr) {
+	// do not copy _addr, it must keep pointing to our own storage
+	if (this != &addr) {
+		memcpy(&_addrUn, &addr._addrUn, sizeof(_addrUn));
+		_addrSize = addr._addrSize;
+	}
+	return (*this);
+}
+
+// --------------------------------------------------------------------------
+
+bool Address::operator==(const Address & addr) const {
+	return _addrSize == addr._addrSize && memcmp(_addr, addr._addr, _addrSize) == 0;
+}
+
+// --------------------------------------------------------------------------
+
+Address Address::unixPath(const std::string & path) {
+	sockaddr_un un;
+	if (path.length() >= sizeof(un.sun_path))
+		throw SocketException("Unix socket path too long", ENAMETOOLONG);
+
+	memset(&un, 0, sizeof(un));
+	un.sun_family = AF_UNIX;
+	memcpy(un.sun_path, path.c_str(), path.length());
+	return Address(reinterpret_cast<sockaddr*> (&un),
+			offsetof(sockaddr_un, sun_path) + path.length() + 1);
+}
+
+// --------------------------------------------------------------------------
+
+Address Address::unixAbstract(const std::string & name) {
+	sockaddr_un un;
+	if (name.length() + 1 > sizeof(un.sun_path))
+		throw SocketException("Unix socket name too long", ENAMETOOLONG);
+
+	memset(&un, 0, sizeof(un));
+	un.sun_family = AF_UNIX;
+	memcpy(un.sun_path + 1, name.c_str(), name.length());	// leading '\0'
+	return Address(reinterpret_cast<sockaddr*> (&un),
+			offsetof(sockaddr_un, sun_path) + name.length() + 1);
 }
 
 // --------------------------------------------------------------------------
 
 void Address::init(unsigned long ip4addr, unsigned short port) {
-	memset(&_addrIn, 0, sizeof(_addrIn));
+	memset(&_addrUn, 0, sizeof(_addrUn));
+	_addrSize				= sizeof(sockaddr_in);
 	_addrIn.sin_family		= AF_INET;
 	_addrIn.sin_addr.s_addr	= htonl(ip4addr);
 	_addrIn.sin_port		= htons(port);
@@ -66,11 +133,36 @@ void Address::init(unsigned long ip4addr, unsigned short port) {
 
 bool  Address::isNull()
 {
+	if (isUnix())
+		return _addrSize <= offsetof(sockaddr_un, sun_path);
 	return (_addrIn.sin_addr.s_addr == 0 && _addrIn.sin_port == 0);
 }
 
 // --------------------------------------------------------------------------
 
+bool Address::isUnix()
+{
+	return _addrUn.sun_family == AF_UNIX;
+}
+
+// --------------------------------------------------------------------------
+
+std::string Address::path()
+{
+	size_t offset = offsetof(sockaddr_un, sun_path);
+	if (!isUnix() || _addrSize <= offset)
+		return std::string();
+
+	size_t len = _addrSize - offset;
+	if (_addrUn.sun_path[0] == '\0') {
+		// abstract namespace, name is not null terminated
+		return "@" + std::string(_addrUn.sun_path + 1, len - 1);
+	}
+	return std::string(_addrUn.sun_path, strnlen(_addrUn.sun_path, len));
+}
+
+// --------------------------------------------------------------------------
+
 unsigned short Address::port()
 {
 	return ntohs(_addrIn.sin_port);
@@ -86,6 +178,9 @@ unsigned long Address::ip4addr()
 // --------------------------------------------------------------------------
 
 std::string Address::toString() {
+	if (isUnix())
+		return path();
+
 	unsigned long ip4 = ip4addr();
 	std::ostringstream ss;
 	ss << ( (ip4 >> 24) & 0xff) << ".";
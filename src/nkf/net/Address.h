@@ -28,11 +28,21 @@ class Socket;
 
 
 /**
- * Encapsulates an IP4 address and port.
+ * Encapsulates an IP4 address and port, or a Unix domain socket address.
+ *
+ * Unix domain addresses are created with unixPath() for addresses in the
+ * file system, or unixAbstract() for addresses in the (Linux only)
+ * abstract namespace:
+ *
+ * \code
+ * Socket s(UNIX_STREAM);
+ * s.connect(Address::unixPath("/var/run/readout.sock"));
+ * \endcode
  */
 class NKFNET_API Address {
 
 	friend class Socket;
+	friend class BasicSocket;
 
 public:
 	/**
@@ -62,13 +72,85 @@ public:
 	 */
 	Address(unsigned short port);
 
+	/**
+	 * Creates a Unix domain socket address for a path in the file system.
+	 *
+	 * \param	path		The path of the socket, e.g. "/tmp/my.sock"
+	 *
+	 * \return				The address.
+	 */
+	static Address unixPath(const std::string & path);
+
+	/**
+	 * Creates a Unix domain socket address in the abstract namespace. This
+	 * address is not visible in the file system and disappears when the
+	 * last socket bound to it is closed. Linux only.
+	 *
+	 * \param	name		The name of the socket, without the leading
+	 * 						null character.
+	 *
+	 * \return				The address.
+	 */
+	static Address unixAbstract(const std::string & name);
+
+	/**
+	 * Creates a copy of an address.
+	 *
+	 * \param	addr		The address to copy.
+	 */
+	Address(const Address & addr);
+
+	/**
+	 * Assigns the value of another address to this address.
+	 *
+	 * \param	addr		The address to copy its value from.
+	 */
+	Address & operator=(const Address & addr);
+
+	/**
+	 * Compares two addresses, e.g. the senders of two datagrams.
+	 *
+	 * \param	addr		The address to compare with.
+	 *
+	 * \return	true if both refer to the same host and port, or path.
+	 */
+	bool	operator==(const Address & addr) const;
+
+	/**
+	 * Compares two addresses, see operator==.
+	 *
+	 * \param	addr		The address to compare with.
+	 *
+	 * \return	true if the addresses differ.
+	 */
+	bool	operator!=(const Address & addr) const {
+		return !(*this == addr);
+	}
+
 	/**
 	 * Returns whether or not this is a null address (= unspecified / any)
 	 *
-	 * \return	true if both address and port are 0.
+	 * \return	true if both address and port are 0, or if this is an
+	 * 			unnamed Unix domain address.
 	 */
 	bool	isNull();
 
+	/**
+	 * Returns whether or not this is a Unix domain socket address.
+	 *
+	 * \return	true if this is a Unix domain address.
+	 */
+	bool	isUnix();
+
+	/**
+	 * Returns the path of a Unix domain socket address. For an abstract
+	 * address the name is returned, prefixed by a '@'.
+	 *
+	 * \return	The path, or an empty string if this is not a Unix domain
+	 * 			address or the address is unnamed.
+	 */
+	std::string path();
+
 	/**
 	 * Returns the port of this address.
 	 *
@@ -89,7 +171,8 @@ public:
 
 	/**
 	 * Returns the string representation of this address, as
-	 * <a1>.<a2>.<a3>.<a4>:<port>, eg. "127.0.0.1:1234"
+	 * <a1>.<a2>.<a3>.<a4>:<port>, eg. "127.0.0.1:1234". For Unix domain
+	 * addresses the path is returned, see path().
 	 */
 	std::string toString();
 
@@ -100,7 +183,7 @@ public:
 
 
 private:
-	Address(const Address & addr);
+	Address(const sockaddr * addr, socklen_t size);
 
 	void init(unsigned long ip4addr, unsigned short port);
 
@@ -108,11 +191,16 @@ private:
 
 	unsigned		_port;
 
-	sockaddr_in		_addrIn;
+	union {
+		sockaddr_in	_addrIn;
+		sockaddr_un	_addrUn;
+	};
 
 	sockaddr*		_addr;
 
-	static const int _addrSize = sizeof(sockaddr);	// convenience.
+	socklen_t		_addrSize;
+
+	static const socklen_t _addrMaxSize = sizeof(sockaddr_un);
 };
 
 END_NKF_NET
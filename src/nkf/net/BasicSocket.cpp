@@ -0,0 +1,98 @@
+/*
+ * BasicSocket.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "BasicSocket.h"
+
+START_NKF_NET
+
+// --------------------------------------------------------------------------
+// BasicSocket
+// --------------------------------------------------------------------------
+
+BasicSocket::BasicSocket(int af, int type, int proto) :
+	_handle(INVALID_SOCKET) {
+	INC_WS_REF
+	_handle = ::socket(af, type, proto);
+	if (_handle == INVALID_SOCKET) {
+		DEC_WS_REF
+		SocketException::raiseLastError();
+	}
+}
+
+// --------------------------------------------------------------------------
+
+BasicSocket::BasicSocket(SOCKET handle) :
+	_handle(handle) {
+	if (_handle == INVALID_SOCKET)
+		throw SocketException("Provided socket has invalid handle!", 0);
+	INC_WS_REF
+}
+
+// --------------------------------------------------------------------------
+
+void BasicSocket::close() {
+	if (_handle == INVALID_SOCKET)
+		return;
+
+#ifdef WIN32_API
+	closesocket(_handle);
+#else
+	::close(_handle);
+#endif
+	_handle = INVALID_SOCKET;
+	DEC_WS_REF
+}
+
+// --------------------------------------------------------------------------
+
+SOCKET BasicSocket::release() {
+	SOCKET handle = _handle;
+	if (handle != INVALID_SOCKET) {
+		_handle = INVALID_SOCKET;
+		DEC_WS_REF
+	}
+	return handle;
+}
+
+// --------------------------------------------------------------------------
+
+void BasicSocket::setBlocking(bool blocking) {
+#ifdef WIN32_API
+	unsigned long mode = blocking ? 0 : 1;
+	RoR(::ioctlsocket(_handle, FIONBIO, &mode));
+#else
+	int flags = ::fcntl(_handle, F_GETFL, 0);
+	flags = blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+	RoR(::fcntl(_handle, F_SETFL, flags));
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+int BasicSocket::getIntOption(int option) const {
+	int value = 0;
+	socklen_t size = sizeof(value);
+	RoR(::getsockopt(_handle, SOL_SOCKET, option, reinterpret_cast<char*> (&value), &size));
+	return value;
+}
+
+// --------------------------------------------------------------------------
+
+Address BasicSocket::localAddress() const {
+	sockaddr_un addr;	// large enough for any supported family
+	socklen_t size = sizeof(addr);
+	RoR(::getsockname(_handle, reinterpret_cast<sockaddr*> (&addr), &size));
+	return toAddress(reinterpret_cast<sockaddr*> (&addr), size);
+}
+
+// --------------------------------------------------------------------------
+
+BasicSocket::~BasicSocket() {
+	close();
+}
+
+END_NKF_NET
@@ -0,0 +1,198 @@
+/*
+ * BasicSocket.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef BASICSOCKET_H_
+#define BASICSOCKET_H_
+
+#include "net.h"
+#include "Address.h"
+#include "SocketException.h"
+
+/** \file */
+
+START_NKF_NET
+
+#ifdef MSG_NOSIGNAL
+/** Flags for sending on a stream, a closed peer raises an error, not SIGPIPE. */
+#define NKF_STREAM_SEND_FLAGS	MSG_NOSIGNAL
+#else
+#define NKF_STREAM_SEND_FLAGS	0
+#endif
+
+/**
+ * BasicSocket is the common part of the statically typed sockets TcpSocket,
+ * UdpSocket and TcpListener. Unlike Socket, it holds nothing but the
+ * handle: there are no virtual functions and no cached addresses, so an
+ * object is the size of a file descriptor, and the calls on the data path
+ * are inlined.
+ *
+ * Typed sockets can not be copied, but can be moved, e.g. to be returned
+ * from TcpListener::accept() or stored in a std::vector. A moved-from
+ * socket is closed. Errors raise a SocketException, like Socket, except
+ * for the destructor, which ignores them.
+ */
+class NKFNET_API BasicSocket {
+public:
+	/**
+	 * Returns the OS-specific socket handle.
+	 *
+	 * \return	The socket handle, or INVALID_SOCKET if closed.
+	 */
+	SOCKET	handle() const {
+		return _handle;
+	}
+
+	/**
+	 * Returns whether the socket is open.
+	 *
+	 * \return	true if the socket has a valid handle.
+	 */
+	bool	isOpen() const {
+		return _handle != INVALID_SOCKET;
+	}
+
+	/**
+	 * Closes the socket. Closing a closed socket has no effect.
+	 */
+	void	close();
+
+	/**
+	 * Gives up ownership of the handle, which will no longer be closed by
+	 * this object.
+	 *
+	 * \return	The handle.
+	 */
+	SOCKET	release();
+
+	/**
+	 * Sets the socket in blocking or non-blocking mode.
+	 *
+	 * \param	blocking	If true, calls on the socket block.
+	 */
+	void	setBlocking(bool blocking);
+
+	/**
+	 * Sets a socket option, see Socket::setOption.
+	 *
+	 * \param	level	The level of the option, e.g. SOL_SOCKET.
+	 * \param	option	The option.
+	 * \param	value	The value.
+	 * \param	size	The size of the value in bytes.
+	 */
+	void	setOption(int level, int option, const void * value, size_t size) {
+		RoR(::setsockopt(_handle, level, option, static_cast<const char*> (value), size));
+	}
+
+	/**
+	 * Sets an integer socket option at the SOL_SOCKET level.
+	 *
+	 * \param	option	The option, see SO_* constants.
+	 * \param	value	The value.
+	 */
+	void	setOption(int option, int value) {
+		setOption(SOL_SOCKET, option, &value, sizeof(value));
+	}
+
+	/**
+	 * Gets an integer socket option at the SOL_SOCKET level.
+	 *
+	 * \param	option	The option, see SO_* constants.
+	 *
+	 * \return			The value.
+	 */
+	int		getIntOption(int option) const;
+
+	/**
+	 * Returns the address the socket is bound to. Not cached, so every call
+	 * asks the kernel.
+	 *
+	 * \return	The local address.
+	 */
+	Address	localAddress() const;
+
+protected:
+	/**
+	 * Creates a new socket handle.
+	 */
+	BasicSocket(int af, int type, int proto);
+
+	/**
+	 * Takes ownership of an existing handle.
+	 */
+	explicit BasicSocket(SOCKET handle);
+
+	BasicSocket(BasicSocket && other) : _handle(other._handle) {
+		other._handle = INVALID_SOCKET;
+	}
+
+	BasicSocket & operator=(BasicSocket && other) {
+		if (this != &other) {
+			close();
+			_handle = other._handle;
+			other._handle = INVALID_SOCKET;
+		}
+		return (*this);
+	}
+
+	/**
+	 * Closes the socket, ignoring errors. Not virtual, typed sockets are
+	 * not used through a BasicSocket pointer.
+	 */
+	~BasicSocket();
+
+	/**
+	 * Returns the native address and size of an Address.
+	 */
+	static const sockaddr * native(const Address & addr, socklen_t * size) {
+		(*size) = addr._addrSize;
+		return addr._addr;
+	}
+
+	/**
+	 * Creates an Address from a native address.
+	 */
+	static Address toAddress(const sockaddr * addr, socklen_t size) {
+		return Address(addr, size);
+	}
+
+	/**
+	 * Receives, and fills in the source address.
+	 */
+	size_t	receiveFrom(void * buf, size_t len, Address * addr) {
+		socklen_t size = Address::_addrMaxSize;
+		ssize_t bytes = ::recvfrom(_handle, static_cast<char*> (buf), len, 0, addr->_addr, &size);
+		if (bytes < 0)
+			SocketException::raiseLastError();
+		addr->_addrSize = size;
+		return bytes;
+	}
+
+	/**
+	 * Connects the socket.
+	 */
+	void	connectTo(const Address & addr) {
+		RoR(::connect(_handle, addr._addr, addr._addrSize));
+	}
+
+	/**
+	 * Binds the socket.
+	 */
+	void	bindTo(const Address & addr) {
+		RoR(::bind(_handle, addr._addr, addr._addrSize));
+	}
+
+	SOCKET	_handle;
+
+private:
+	BasicSocket(const BasicSocket &);
+
+	BasicSocket & operator=(const BasicSocket &);
+};
+
+END_NKF_NET
+
+#endif /* BASICSOCKET_H_ */
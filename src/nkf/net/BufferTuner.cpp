@@ -0,0 +1,185 @@
+/*
+ * BufferTuner.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "BufferTuner.h"
+#include "SocketException.h"
+#include <iostream>
+
+#ifdef __linux__
+#include <linux/sock_diag.h>
+#endif
+
+START_NKF_NET
+
+// --------------------------------------------------------------------------
+// BufferTuner
+// --------------------------------------------------------------------------
+
+BufferTuner::BufferTuner(Socket & sock) :
+	_sock(sock),
+	_forcePermitted(true),
+	_lastDrops(0),
+	_shrinkDelay(16),
+	_adjustments(0),
+	_log(&std::clog) {
+#ifndef __linux__
+	throw SocketException("BufferTuner not supported on this platform", 0);
+#else
+	_rcv.name			= "SO_RCVBUF";
+	_rcv.option			= SO_RCVBUF;
+	_rcv.forceOption	= SO_RCVBUFFORCE;
+	_rcv.size			= _sock.getIntOption(SO_RCVBUF) / 2;	// Linux reports double
+	_rcv.min			= 64 * 1024;
+	_rcv.max			= 8 * 1024 * 1024;
+	_rcv.idle			= 0;
+
+	_snd.name			= "SO_SNDBUF";
+	_snd.option			= SO_SNDBUF;
+	_snd.forceOption	= SO_SNDBUFFORCE;
+	_snd.size			= _sock.getIntOption(SO_SNDBUF) / 2;
+	_snd.min			= 64 * 1024;
+	_snd.max			= 8 * 1024 * 1024;
+	_snd.idle			= 0;
+
+	_sock.setDropTracking(true);
+	_lastDrops = _sock.dropCount();
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+void BufferTuner::setReceiveBounds(int min, int max) {
+	_rcv.min = min;
+	_rcv.max = max;
+}
+
+// --------------------------------------------------------------------------
+
+void BufferTuner::setSendBounds(int min, int max) {
+	_snd.min = min;
+	_snd.max = max;
+}
+
+// --------------------------------------------------------------------------
+
+void BufferTuner::setShrinkDelay(unsigned int samples) {
+	_shrinkDelay = samples;
+}
+
+// --------------------------------------------------------------------------
+
+void BufferTuner::setLog(std::ostream * log) {
+	_log = log;
+}
+
+// --------------------------------------------------------------------------
+
+bool BufferTuner::sample() {
+	unsigned long drops = _sock.dropCount();
+	bool dropped = drops != _lastDrops;
+	_lastDrops = drops;
+
+	size_t inq;
+#ifdef SO_MEMINFO
+	// For UDP SIOCINQ only reports the size of the next datagram, the
+	// allocated receive memory is a much better measure.
+	uint32_t meminfo[SK_MEMINFO_VARS];
+	size_t size = sizeof(meminfo);
+	_sock.getOption(SOL_SOCKET, SO_MEMINFO, meminfo, &size);
+	inq = meminfo[SK_MEMINFO_RMEM_ALLOC] / 2;
+#else
+	inq = _sock.pendingInput();
+#endif
+
+	bool adjusted = tune(_rcv, inq, dropped);
+	if (tune(_snd, _sock.pendingOutput(), false)) adjusted = true;
+	return adjusted;
+}
+
+// --------------------------------------------------------------------------
+
+bool BufferTuner::tune(Buffer & buf, size_t queued, bool grow) {
+	int size = buf.size;
+
+	if (grow || queued > static_cast<size_t>(size) / 4 * 3) {
+		buf.idle = 0;
+		if (size < buf.max) {
+			return apply(buf, size > buf.max / 2 ? buf.max : size * 2,
+					grow ? "kernel dropped datagrams" : "queue nearly full");
+		}
+	} else if (queued < static_cast<size_t>(size) / 8) {
+		if (++buf.idle >= _shrinkDelay && size > buf.min) {
+			buf.idle = 0;
+			return apply(buf, size / 2 < buf.min ? buf.min : size / 2, "queue nearly empty");
+		}
+	} else {
+		buf.idle = 0;
+	}
+
+	// keep within bounds, also when the bounds have been changed
+	if (size < buf.min) {
+		return apply(buf, buf.min, "below minimum");
+	} else if (size > buf.max) {
+		return apply(buf, buf.max, "above maximum");
+	}
+	return false;
+}
+
+// --------------------------------------------------------------------------
+
+bool BufferTuner::apply(Buffer & buf, int size, const char * reason) {
+	bool forced = false;
+	if (_forcePermitted) {
+		try {
+			_sock.setOption(buf.forceOption, size);
+			forced = true;
+		} catch (SocketException & se) {
+			if (se.code() != EPERM) throw;
+			_forcePermitted = false;
+		}
+	}
+	if (!forced) {
+		_sock.setOption(buf.option, size);
+	}
+
+	// without force, the kernel caps the size at rmem_max / wmem_max
+	int applied = _sock.getIntOption(buf.option) / 2;	// Linux reports double
+	if (applied == buf.size)
+		return false;
+
+	if (_log != NULL) {
+		(*_log) << "BufferTuner: socket " << _sock.handle() << " " << buf.name
+				<< " " << buf.size << " -> " << applied;
+		if (applied != size)
+			(*_log) << " of " << size << " requested";
+		(*_log) << " (" << reason << (forced ? ", forced" : "") << ")" << std::endl;
+	}
+
+	buf.size = applied;
+	++_adjustments;
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+int BufferTuner::receiveBufferSize() {
+	return _rcv.size;
+}
+
+// --------------------------------------------------------------------------
+
+int BufferTuner::sendBufferSize() {
+	return _snd.size;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long BufferTuner::adjustments() {
+	return _adjustments;
+}
+
+END_NKF_NET
@@ -0,0 +1,158 @@
+/*
+ * BufferTuner.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef BUFFERTUNER_H_
+#define BUFFERTUNER_H_
+
+#include <ostream>
+#include "net.h"
+#include "Socket.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * BufferTuner adjusts the kernel receive and send buffer sizes of a
+ * socket (SO_RCVBUF and SO_SNDBUF) based on what is observed, instead of
+ * guessing them up front.
+ *
+ * Every call to sample() looks at the kernel drop counter (SO_RXQ_OVFL)
+ * and the queue occupancy (SIOCINQ / SIOCOUTQ) of the socket:
+ * - If datagrams were dropped since the last sample, or the receive queue
+ *   is almost full, the receive buffer is grown.
+ * - If the send queue is almost full, the send buffer is grown.
+ * - If a queue has been nearly empty for a number of consecutive samples,
+ *   its buffer is shrunk again.
+ *
+ * Sizes always stay within the configured bounds. Sizes are set with
+ * SO_RCVBUFFORCE / SO_SNDBUFFORCE when the process is permitted to do so
+ * (CAP_NET_ADMIN), which allows exceeding the system wide maximum, else
+ * with SO_RCVBUF / SO_SNDBUF, which the kernel caps at net.core.rmem_max /
+ * wmem_max. The size the kernel applied is read back after each change,
+ * and every adjustment is written to the log.
+ *
+ * The tuner enables drop tracking on the socket, so the drop counter is
+ * only updated while the application is receiving on the socket.
+ *
+ * \code
+ * Socket s(UDP);
+ * s.bind(Address(12345));
+ * BufferTuner tuner(s);
+ * tuner.setReceiveBounds(256 * 1024, 16 * 1024 * 1024);
+ * while (1) {
+ *   s.receive(&buf, sizeof(buf));
+ *   if (++count % 1000 == 0) tuner.sample();
+ * }
+ * \endcode
+ *
+ * Linux only.
+ */
+class NKFNET_API BufferTuner {
+public:
+	/**
+	 * Creates a new tuner for the given socket. The socket must stay valid
+	 * for the lifetime of the tuner.
+	 *
+	 * \param	sock	The socket to tune.
+	 */
+	BufferTuner(Socket & sock);
+
+	/**
+	 * Sets the bounds of the receive buffer, in bytes.
+	 *
+	 * \param	min		The minimum receive buffer size.
+	 * \param	max		The maximum receive buffer size.
+	 */
+	void	setReceiveBounds(int min, int max);
+
+	/**
+	 * Sets the bounds of the send buffer, in bytes.
+	 *
+	 * \param	min		The minimum send buffer size.
+	 * \param	max		The maximum send buffer size.
+	 */
+	void	setSendBounds(int min, int max);
+
+	/**
+	 * Sets the number of consecutive samples a queue must be nearly empty
+	 * before its buffer is shrunk. Default is 16.
+	 *
+	 * \param	samples		The number of samples.
+	 */
+	void	setShrinkDelay(unsigned int samples);
+
+	/**
+	 * Sets the stream to log the adjustments to. Default is std::clog.
+	 *
+	 * \param	log		The stream to log to, or NULL to disable logging.
+	 */
+	void	setLog(std::ostream * log);
+
+	/**
+	 * Samples the socket state and adjusts the buffers if required.
+	 *
+	 * \return	true if any of the buffers was adjusted.
+	 */
+	bool	sample();
+
+	/**
+	 * Returns the receive buffer size, as applied by the kernel.
+	 *
+	 * \return	The receive buffer size in bytes.
+	 */
+	int		receiveBufferSize();
+
+	/**
+	 * Returns the send buffer size, as applied by the kernel.
+	 *
+	 * \return	The send buffer size in bytes.
+	 */
+	int		sendBufferSize();
+
+	/**
+	 * Returns the total number of adjustments made.
+	 *
+	 * \return	The number of adjustments.
+	 */
+	unsigned long adjustments();
+
+private:
+	struct Buffer {
+		const char *	name;
+		int				option;
+		int				forceOption;
+		int				size;
+		int				min;
+		int				max;
+		unsigned int	idle;
+	};
+
+	bool	tune(Buffer & buf, size_t queued, bool grow);
+
+	bool	apply(Buffer & buf, int size, const char * reason);
+
+	Socket &		_sock;
+
+	Buffer			_rcv;
+
+	Buffer			_snd;
+
+	bool			_forcePermitted;
+
+	unsigned long	_lastDrops;
+
+	unsigned int	_shrinkDelay;
+
+	unsigned long	_adjustments;
+
+	std::ostream *	_log;
+};
+
+END_NKF_NET
+
+#endif /* BUFFERTUNER_H_ */
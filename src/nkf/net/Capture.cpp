@@ -0,0 +1,258 @@
+/*
+ * Capture.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "Capture.h"
+#include "SocketException.h"
+#include <cstring>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+START_NKF_NET
+
+static const char		CAPTURE_MAGIC[8] = { 'N', 'K', 'F', 'C', 'A', 'P', '0', '1' };
+static const uint32_t	CAPTURE_BOM = 0x01020304;
+
+struct CaptureFileHeader {
+	char		magic[8];
+	uint32_t	bom;		// byte order mark
+	uint32_t	reserved;
+};
+
+struct CaptureRecordHeader {
+	uint64_t	timestamp;	// ns since the epoch, 0 marks the end
+	uint32_t	length;
+	uint16_t	family;		// AF_INET, or 0 if not recorded
+	uint16_t	port;
+	uint32_t	ip4addr;
+	uint32_t	reserved;
+};
+
+static inline size_t recordSize(size_t len) {
+	return sizeof(CaptureRecordHeader) + ((len + 7) & ~static_cast<size_t> (7));
+}
+
+// --------------------------------------------------------------------------
+// CaptureRecorder
+// --------------------------------------------------------------------------
+
+CaptureRecorder::CaptureRecorder(const std::string & path, size_t initialSize) :
+	_fd(-1),
+	_map(NULL),
+	_mapSize(0),
+	_used(0),
+	_count(0) {
+
+	if (initialSize < sizeof(CaptureFileHeader))
+		initialSize = sizeof(CaptureFileHeader);
+
+	_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (_fd < 0)
+		SocketException::raiseLastError();
+
+	try {
+		grow(initialSize);
+	} catch (const SocketException &) {
+		::close(_fd);
+		_fd = -1;
+		throw;
+	}
+
+	CaptureFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+	header.bom = CAPTURE_BOM;
+	memcpy(_map, &header, sizeof(header));
+	_used = sizeof(header);
+}
+
+// --------------------------------------------------------------------------
+
+void CaptureRecorder::grow(size_t needed) {
+	size_t size = _mapSize > 0 ? _mapSize : needed;
+	while (size < needed) size <<= 1;
+
+	RoR(::ftruncate(_fd, size));
+
+	void * map;
+#ifdef __linux__
+	if (_map != NULL)
+		map = ::mremap(_map, _mapSize, size, MREMAP_MAYMOVE);
+	else
+#endif
+	{
+		if (_map != NULL) ::munmap(_map, _mapSize);
+		map = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+	}
+	if (map == MAP_FAILED) {
+		_map = NULL;
+		SocketException::raiseLastError();
+	}
+	_map = static_cast<char*> (map);
+	_mapSize = size;
+}
+
+// --------------------------------------------------------------------------
+
+size_t CaptureRecorder::record(Socket & sock, void * buf, size_t len) {
+	Address source(Address::ANY);
+	size_t bytes = sock.receive(buf, len, &source);
+	append(buf, bytes, source);
+	return bytes;
+}
+
+// --------------------------------------------------------------------------
+
+void CaptureRecorder::append(const void * data, size_t len, Address & source,
+		unsigned long long timestamp) {
+	if (_map == NULL)
+		throw SocketException("Capture file closed", EBADF);
+
+	if (timestamp == 0) {
+		timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		timestamp = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	}
+
+	size_t size = recordSize(len);
+	if (_used + size > _mapSize)
+		grow(_used + size);
+
+	CaptureRecordHeader header;
+	memset(&header, 0, sizeof(header));
+	header.length = len;
+	if (!source.isUnix()) {
+		header.family = AF_INET;
+		header.port = source.port();
+		header.ip4addr = source.ip4addr();
+	}
+
+	// the timestamp goes in last, it marks the record as complete
+	char * rec = _map + _used;
+	memcpy(rec + sizeof(header), data, len);
+	memcpy(rec, &header, sizeof(header));
+	uint64_t ts = timestamp;
+	memcpy(rec + offsetof(CaptureRecordHeader, timestamp), &ts, sizeof(ts));
+
+	_used += size;
+	++_count;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long CaptureRecorder::count() {
+	return _count;
+}
+
+// --------------------------------------------------------------------------
+
+size_t CaptureRecorder::size() {
+	return _used;
+}
+
+// --------------------------------------------------------------------------
+
+void CaptureRecorder::close() {
+	if (_fd < 0) return;
+	if (_map != NULL) {
+		::munmap(_map, _mapSize);
+		_map = NULL;
+	}
+	int rc = ::ftruncate(_fd, _used);
+	::close(_fd);
+	_fd = -1;
+	RoR(rc);
+}
+
+// --------------------------------------------------------------------------
+
+CaptureRecorder::~CaptureRecorder() {
+	try {
+		close();
+	} catch (const SocketException &) {
+		// nothing to report to
+	}
+}
+
+// --------------------------------------------------------------------------
+// CaptureReader
+// --------------------------------------------------------------------------
+
+CaptureReader::CaptureReader(const std::string & path) :
+	_map(NULL),
+	_size(0),
+	_pos(sizeof(CaptureFileHeader)) {
+
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		SocketException::raiseLastError();
+
+	struct stat st;
+	if (::fstat(fd, &st) != 0) {
+		::close(fd);
+		SocketException::raiseLastError();
+	}
+	_size = st.st_size;
+
+	if (_size < sizeof(CaptureFileHeader)) {
+		::close(fd);
+		throw SocketException("Not a capture file", EINVAL);
+	}
+
+	void * map = ::mmap(NULL, _size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (map == MAP_FAILED)
+		SocketException::raiseLastError();
+	_map = static_cast<const char*> (map);
+
+	CaptureFileHeader header;
+	memcpy(&header, _map, sizeof(header));
+	if (memcmp(header.magic, CAPTURE_MAGIC, sizeof(header.magic)) != 0) {
+		::munmap(const_cast<char*> (_map), _size);
+		throw SocketException("Not a capture file", EINVAL);
+	}
+	if (header.bom != CAPTURE_BOM) {
+		::munmap(const_cast<char*> (_map), _size);
+		throw SocketException("Capture file has a different byte order", EINVAL);
+	}
+}
+
+// --------------------------------------------------------------------------
+
+bool CaptureReader::next(CapturedDatagram & dgram) {
+	if (_pos + sizeof(CaptureRecordHeader) > _size)
+		return false;
+
+	CaptureRecordHeader header;
+	memcpy(&header, _map + _pos, sizeof(header));
+	if (header.timestamp == 0 || _pos + recordSize(header.length) > _size)
+		return false;	// end of an unfinished capture
+
+	dgram.timestamp = header.timestamp;
+	dgram.source = header.family == AF_INET ?
+			Address(header.ip4addr, header.port) : Address::ANY;
+	dgram.data = _map + _pos + sizeof(header);
+	dgram.length = header.length;
+
+	_pos += recordSize(header.length);
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+void CaptureReader::rewind() {
+	_pos = sizeof(CaptureFileHeader);
+}
+
+// --------------------------------------------------------------------------
+
+CaptureReader::~CaptureReader() {
+	::munmap(const_cast<char*> (_map), _size);
+}
+
+END_NKF_NET
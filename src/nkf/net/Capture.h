@@ -0,0 +1,189 @@
+/*
+ * Capture.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include <string>
+#include "net.h"
+#include "Socket.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * A datagram read from a capture file by CaptureReader.
+ */
+struct NKFNET_API CapturedDatagram {
+	/** The receive time, in nanoseconds since the epoch. */
+	unsigned long long	timestamp;
+	/** The source address. Only IPv4 sources are recorded, others are ANY. */
+	Address				source;
+	/** The payload, pointing into the capture file. */
+	const char *		data;
+	/** The payload length in bytes. */
+	size_t				length;
+
+	CapturedDatagram() : timestamp(0), source(Address::ANY), data(NULL), length(0) {}
+};
+
+/**
+ * CaptureRecorder writes received datagrams, with their source address
+ * and receive time, to an append-only capture file. The file is memory
+ * mapped and grows as needed, so recording is a copy into memory.
+ *
+ * \code
+ * Socket s(UDP);
+ * s.bind(Address(IP4(0,0,0,0), 9000));
+ * CaptureRecorder rec("/data/run42.nkfcap");
+ * char buf[9000];
+ * while (running) {
+ *   size_t len = rec.record(s, buf, sizeof(buf));
+ *   process(buf, len);
+ * }
+ * rec.close();
+ * \endcode
+ *
+ * The file starts with the 8 byte magic "NKFCAP01" and a byte order mark,
+ * followed by records of a 24 byte header (timestamp, length, address) and
+ * the payload, padded to 8 bytes. Numbers are in host byte order. Until
+ * close() the file may have zero padding at the end, which readers treat
+ * as end of file, so a capture survives a crash of the recorder.
+ *
+ * The captured traffic can be sent again with the nkfreplay tool.
+ * Posix only, not thread safe.
+ */
+class NKFNET_API CaptureRecorder {
+public:
+	/**
+	 * Creates a new capture file, replacing any existing one.
+	 *
+	 * \param	path		The path of the file.
+	 * \param	initialSize	The initial size of the file, doubled when full.
+	 */
+	CaptureRecorder(const std::string & path, size_t initialSize = 64 * 1024 * 1024);
+
+	/**
+	 * Receives a datagram on a socket, and records it.
+	 *
+	 * \param	sock	The socket to receive on.
+	 * \param	buf		The buffer to receive in.
+	 * \param	len		The length of the buffer in bytes.
+	 *
+	 * \return			The number of bytes received.
+	 */
+	size_t	record(Socket & sock, void * buf, size_t len);
+
+	/**
+	 * Records a datagram received by other means.
+	 *
+	 * \param	data		The payload.
+	 * \param	len			The length of the payload in bytes.
+	 * \param	source		The source address.
+	 * \param	timestamp	The receive time in nanoseconds since the epoch,
+	 * 						or 0 for now.
+	 */
+	void	append(const void * data, size_t len, Address & source,
+			unsigned long long timestamp = 0);
+
+	/**
+	 * Returns the number of datagrams recorded.
+	 */
+	unsigned long count();
+
+	/**
+	 * Returns the number of bytes written to the file.
+	 */
+	size_t	size();
+
+	/**
+	 * Truncates the file to the recorded data, and closes it. Calling
+	 * close() multiple times has no effect.
+	 */
+	void	close();
+
+	/**
+	 * Closes the file, see close().
+	 */
+	virtual ~CaptureRecorder();
+
+private:
+	void	grow(size_t needed);
+
+	CaptureRecorder(const CaptureRecorder &);
+
+	CaptureRecorder & operator=(const CaptureRecorder &);
+
+	int				_fd;
+
+	char *			_map;
+
+	size_t			_mapSize;
+
+	size_t			_used;
+
+	unsigned long	_count;
+};
+
+/**
+ * CaptureReader reads a capture file written by CaptureRecorder. The file
+ * is memory mapped read-only, and datagrams point directly into it.
+ *
+ * \code
+ * CaptureReader cap("/data/run42.nkfcap");
+ * CapturedDatagram dgram;
+ * while (cap.next(dgram)) {
+ *   s.send(dgram.data, dgram.length, dst);
+ * }
+ * \endcode
+ *
+ * Posix only.
+ */
+class NKFNET_API CaptureReader {
+public:
+	/**
+	 * Opens a capture file.
+	 *
+	 * \param	path	The path of the file.
+	 */
+	CaptureReader(const std::string & path);
+
+	/**
+	 * Reads the next datagram.
+	 *
+	 * \param	dgram	Receives the datagram, valid while the reader is.
+	 *
+	 * \return			false at the end of the capture.
+	 */
+	bool	next(CapturedDatagram & dgram);
+
+	/**
+	 * Goes back to the first datagram.
+	 */
+	void	rewind();
+
+	/**
+	 * Closes the file.
+	 */
+	virtual ~CaptureReader();
+
+private:
+	CaptureReader(const CaptureReader &);
+
+	CaptureReader & operator=(const CaptureReader &);
+
+	const char *	_map;
+
+	size_t			_size;
+
+	size_t			_pos;
+};
+
+END_NKF_NET
+
+#endif /* CAPTURE_H_ */
@@ -0,0 +1,456 @@
+/*
+ * CompressedStream.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "CompressedStream.h"
+#include "SocketException.h"
+#include <cstring>
+#include <stdint.h>
+
+START_NKF_NET
+
+/*
+ * Each block starts with two 32 bit little endian words: the number of
+ * bytes which follow, with the top bit set if the block is stored as is,
+ * and the size of the block after decompression.
+ *
+ * Blocks are compressed in the LZ4 block format, so they can be inspected
+ * with the LZ4 tools. The compressor is a plain greedy one, with a single
+ * entry hash table, which is what the LZ4 'fast' mode does as well.
+ */
+
+static const size_t		HEADER_SIZE = 8;
+
+static const uint32_t	STORED = 0x80000000;
+
+static const size_t		MAX_BLOCK = 4 * 1024 * 1024;
+
+static const size_t		MIN_MATCH = 4;
+
+static const size_t		LAST_LITERALS = 5;		// the last bytes are always literals
+
+static const size_t		MF_LIMIT = 12;			// no match starts in the last bytes
+
+static const int		HASH_LOG = 12;
+
+static const size_t		MAX_OFFSET = 65535;
+
+static const size_t		LZ4_ERROR = ~static_cast<size_t> (0);
+
+// --------------------------------------------------------------------------
+
+static inline uint32_t read32(const unsigned char * p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+// --------------------------------------------------------------------------
+
+static inline uint32_t hash32(uint32_t v) {
+	return (v * 2654435761U) >> (32 - HASH_LOG);
+}
+
+// --------------------------------------------------------------------------
+
+static inline void writeLength(unsigned char *& op, size_t len) {
+	while (len >= 255) {
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = static_cast<unsigned char> (len);
+}
+
+// --------------------------------------------------------------------------
+
+/*
+ * Compresses a block, returns the compressed size, or 0 if it does not
+ * fit in cap bytes.
+ */
+static size_t lz4Compress(const unsigned char * src, size_t len, unsigned char * dst, size_t cap) {
+	uint32_t table[1 << HASH_LOG];
+	memset(table, 0, sizeof(table));
+
+	unsigned char * op = dst;
+	unsigned char * oend = dst + cap;
+	size_t anchor = 0;
+
+	if (len >= MF_LIMIT + 1) {
+		const size_t mfLimit = len - MF_LIMIT;
+		const size_t matchLimit = len - LAST_LITERALS;
+		size_t ip = 1;
+		size_t misses = 0;
+		while (ip <= mfLimit) {
+			uint32_t seq = read32(src + ip);
+			uint32_t h = hash32(seq);
+			size_t ref = table[h];
+			table[h] = static_cast<uint32_t> (ip);
+			if (ref >= ip || ip - ref > MAX_OFFSET || read32(src + ref) != seq) {
+				// skip faster through data which does not compress
+				ip += 1 + (misses++ >> 6);
+				continue;
+			}
+			misses = 0;
+
+			while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+				--ip;
+				--ref;
+			}
+			size_t match = MIN_MATCH;
+			while (ip + match < matchLimit && src[ip + match] == src[ref + match]) {
+				++match;
+			}
+
+			size_t literals = ip - anchor;
+			if (op + 1 + literals / 255 + 1 + literals + 2 + match / 255 + 1 > oend)
+				return 0;
+			unsigned char * token = op++;
+			*token = static_cast<unsigned char> ((literals < 15 ? literals : 15) << 4);
+			if (literals >= 15) writeLength(op, literals - 15);
+			memcpy(op, src + anchor, literals);
+			op += literals;
+
+			size_t offset = ip - ref;
+			*op++ = static_cast<unsigned char> (offset);
+			*op++ = static_cast<unsigned char> (offset >> 8);
+
+			size_t extra = match - MIN_MATCH;
+			*token |= static_cast<unsigned char> (extra < 15 ? extra : 15);
+			if (extra >= 15) writeLength(op, extra - 15);
+
+			ip += match;
+			anchor = ip;
+			if (ip - 2 <= mfLimit) table[hash32(read32(src + ip - 2))] = static_cast<uint32_t> (ip - 2);
+		}
+	}
+
+	size_t literals = len - anchor;
+	if (op + 1 + literals / 255 + 1 + literals > oend)
+		return 0;
+	unsigned char * token = op++;
+	*token = static_cast<unsigned char> ((literals < 15 ? literals : 15) << 4);
+	if (literals >= 15) writeLength(op, literals - 15);
+	memcpy(op, src + anchor, literals);
+	op += literals;
+	return op - dst;
+}
+
+// --------------------------------------------------------------------------
+
+static inline bool readLength(const unsigned char *& ip, const unsigned char * iend, size_t & len) {
+	unsigned char b;
+	do {
+		if (ip >= iend) return false;
+		b = *ip++;
+		len += b;
+	} while (b == 255);
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+/*
+ * Decompresses a block, returns the decompressed size, or LZ4_ERROR if the
+ * block is corrupt or does not fit in cap bytes.
+ */
+static size_t lz4Decompress(const unsigned char * src, size_t len, unsigned char * dst, size_t cap) {
+	const unsigned char * ip = src;
+	const unsigned char * iend = src + len;
+	unsigned char * op = dst;
+	unsigned char * oend = dst + cap;
+
+	while (ip < iend) {
+		unsigned token = *ip++;
+		size_t literals = token >> 4;
+		if (literals == 15 && !readLength(ip, iend, literals))
+			return LZ4_ERROR;
+		if (literals > static_cast<size_t> (iend - ip) || literals > static_cast<size_t> (oend - op))
+			return LZ4_ERROR;
+		memcpy(op, ip, literals);
+		ip += literals;
+		op += literals;
+		if (ip == iend) break;		// the last sequence has no match
+
+		if (iend - ip < 2)
+			return LZ4_ERROR;
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > static_cast<size_t> (op - dst))
+			return LZ4_ERROR;
+
+		size_t match = token & 15;
+		if (match == 15 && !readLength(ip, iend, match))
+			return LZ4_ERROR;
+		match += MIN_MATCH;
+		if (match > static_cast<size_t> (oend - op))
+			return LZ4_ERROR;
+
+		const unsigned char * ref = op - offset;
+		if (offset >= match) {
+			memcpy(op, ref, match);
+			op += match;
+		} else {
+			// overlapping, repeats the last offset bytes
+			for (size_t i = 0; i < match; ++i) {
+				*op++ = *ref++;
+			}
+		}
+	}
+	return op - dst;
+}
+
+// --------------------------------------------------------------------------
+
+static inline void putLE32(unsigned char * p, uint32_t v) {
+	p[0] = static_cast<unsigned char> (v);
+	p[1] = static_cast<unsigned char> (v >> 8);
+	p[2] = static_cast<unsigned char> (v >> 16);
+	p[3] = static_cast<unsigned char> (v >> 24);
+}
+
+// --------------------------------------------------------------------------
+
+static inline uint32_t getLE32(const unsigned char * p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t> (p[3]) << 24);
+}
+
+// --------------------------------------------------------------------------
+// CompressedStream
+// --------------------------------------------------------------------------
+
+CompressedStream::CompressedStream(Socket & sock, size_t blockSize) :
+	_sock(sock),
+	_blockSize(0),
+	_minSaving(10),
+	_outLen(0),
+	_inPos(0),
+	_inLen(0),
+	_rawSent(0),
+	_compressedSent(0),
+	_rawReceived(0),
+	_compressedReceived(0),
+	_bypassed(0) {
+	setBlockSize(blockSize);
+}
+
+// --------------------------------------------------------------------------
+
+void CompressedStream::write(const void * buf, size_t len) {
+	const char * data = static_cast<const char*> (buf);
+	while (len > 0) {
+		if (_outLen == 0 && len >= _blockSize) {
+			// whole blocks are compressed straight from the caller's buffer
+			sendBlock(data, _blockSize);
+			data += _blockSize;
+			len -= _blockSize;
+			continue;
+		}
+		size_t part = _blockSize - _outLen;
+		if (part > len) part = len;
+		memcpy(&_out[_outLen], data, part);
+		_outLen += part;
+		data += part;
+		len -= part;
+		if (_outLen == _blockSize) flush();
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void CompressedStream::flush() {
+	if (_outLen == 0) return;
+	// on failure the data is lost, the stream can not be continued anyway
+	size_t len = _outLen;
+	_outLen = 0;
+	sendBlock(&_out[0], len);
+}
+
+// --------------------------------------------------------------------------
+
+size_t CompressedStream::send(const void * buf, size_t len) {
+	write(buf, len);
+	flush();
+	return len;
+}
+
+// --------------------------------------------------------------------------
+
+void CompressedStream::sendBlock(const char * data, size_t len) {
+	unsigned char * header = reinterpret_cast<unsigned char*> (&_packed[0]);
+	unsigned char * packed = header + HEADER_SIZE;
+
+	// only worth it if it saves at least _minSaving percent
+	size_t limit = len - len * _minSaving / 100;
+	size_t size = lz4Compress(reinterpret_cast<const unsigned char*> (data), len, packed, limit);
+
+	iovec vec[2];
+	size_t count;
+	vec[0].iov_base = header;
+	vec[0].iov_len = HEADER_SIZE;
+	if (size == 0) {
+		putLE32(header, static_cast<uint32_t> (len) | STORED);
+		vec[1].iov_base = const_cast<char*> (data);
+		vec[1].iov_len = len;
+		count = 2;
+		size = len;
+		++_bypassed;
+	} else {
+		putLE32(header, static_cast<uint32_t> (size));
+		vec[0].iov_len += size;
+		count = 1;
+	}
+	putLE32(header + 4, static_cast<uint32_t> (len));
+
+	size_t total = HEADER_SIZE + size;
+	size_t sent = 0;
+	while (sent < total) {
+		size_t bytes = _sock.send(vec, count);
+		sent += bytes;
+		// skip what was sent
+		while (count > 0 && bytes >= vec[0].iov_len) {
+			bytes -= vec[0].iov_len;
+			vec[0] = vec[1];
+			--count;
+		}
+		if (count > 0) {
+			vec[0].iov_base = static_cast<char*> (vec[0].iov_base) + bytes;
+			vec[0].iov_len -= bytes;
+		}
+	}
+	_rawSent += len;
+	_compressedSent += total;
+}
+
+// --------------------------------------------------------------------------
+
+size_t CompressedStream::receive(void * buf, size_t len) {
+	if (_inPos == _inLen && !receiveBlock())
+		return 0;
+	size_t part = _inLen - _inPos;
+	if (part > len) part = len;
+	memcpy(buf, &_in[_inPos], part);
+	_inPos += part;
+	return part;
+}
+
+// --------------------------------------------------------------------------
+
+bool CompressedStream::receiveBlock() {
+	// skip empty blocks, which a peer may send
+	do {
+		unsigned char header[HEADER_SIZE];
+		if (!receiveAll(header, HEADER_SIZE, true))
+			return false;
+		uint32_t size = getLE32(header);
+		uint32_t rawSize = getLE32(header + 4);
+		bool stored = (size & STORED) != 0;
+		size &= ~STORED;
+		if (rawSize > MAX_BLOCK || (stored ? size != rawSize : size > rawSize + rawSize / 255 + 16))
+			throw SocketException("Invalid compressed block header", EPROTO);
+
+		// the buffers may still be empty, so never index them for 0 bytes
+		if (_in.size() < rawSize) _in.resize(rawSize);
+		if (stored) {
+			if (size > 0) receiveAll(&_in[0], size, false);
+		} else if (size > 0) {
+			if (_inPacked.size() < size) _inPacked.resize(size);
+			receiveAll(&_inPacked[0], size, false);
+			if (rawSize > 0) {
+				size_t len = lz4Decompress(reinterpret_cast<unsigned char*> (&_inPacked[0]), size,
+						reinterpret_cast<unsigned char*> (&_in[0]), rawSize);
+				if (len != rawSize)
+					throw SocketException("Corrupt compressed block", EPROTO);
+			}
+		} else if (rawSize > 0) {
+			throw SocketException("Corrupt compressed block", EPROTO);
+		}
+		_inPos = 0;
+		_inLen = rawSize;
+		_rawReceived += rawSize;
+		_compressedReceived += HEADER_SIZE + size;
+	} while (_inLen == 0);
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+bool CompressedStream::receiveAll(void * buf, size_t len, bool eofAllowed) {
+	char * data = static_cast<char*> (buf);
+	size_t got = 0;
+	while (got < len) {
+		size_t bytes = _sock.receive(data + got, len - got);
+		if (bytes == 0) {
+			if (got == 0 && eofAllowed) return false;
+			throw SocketException("Connection closed within a compressed block", EPROTO);
+		}
+		got += bytes;
+	}
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+void CompressedStream::setBlockSize(size_t blockSize) {
+	if (blockSize == 0 || blockSize > MAX_BLOCK)
+		throw SocketException("Invalid block size", EINVAL);
+	flush();
+	_blockSize = blockSize;
+	_out.resize(blockSize);
+	_packed.resize(HEADER_SIZE + blockSize);
+}
+
+// --------------------------------------------------------------------------
+
+void CompressedStream::setMinSaving(unsigned percent) {
+	_minSaving = percent < 100 ? percent : 99;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long CompressedStream::rawSent() {
+	return _rawSent;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long CompressedStream::compressedSent() {
+	return _compressedSent;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long CompressedStream::rawReceived() {
+	return _rawReceived;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long CompressedStream::compressedReceived() {
+	return _compressedReceived;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long CompressedStream::bypassed() {
+	return _bypassed;
+}
+
+// --------------------------------------------------------------------------
+
+void CompressedStream::resetCounters() {
+	_rawSent = 0;
+	_compressedSent = 0;
+	_rawReceived = 0;
+	_compressedReceived = 0;
+	_bypassed = 0;
+}
+
+// --------------------------------------------------------------------------
+
+CompressedStream::~CompressedStream() {
+}
+
+END_NKF_NET
@@ -0,0 +1,202 @@
+/*
+ * CompressedStream.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef COMPRESSEDSTREAM_H_
+#define COMPRESSEDSTREAM_H_
+
+#include <vector>
+#include "net.h"
+#include "Socket.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * CompressedStream compresses the data sent over a TCP connection with
+ * LZ4, and decompresses the data received, for links where bandwidth is
+ * scarcer than CPU time and the data compresses well.
+ *
+ * The stream is cut in blocks of at most the block size, each compressed
+ * on its own and sent with a small header, so at most one block is held
+ * back: data is sent as soon as a block is full, or on flush(). Blocks
+ * which do not compress well enough are sent as they are, which costs
+ * little more than the compression attempt.
+ *
+ * \code
+ * // sender
+ * CompressedStream out(sock);
+ * out.write(&header, sizeof(header));
+ * out.write(hits, hitsLen);
+ * out.flush();						// or: out.send(buf, len)
+ *
+ * // receiver
+ * CompressedStream in(conn);
+ * while ((len = in.receive(buf, sizeof(buf))) > 0) { ... }
+ * cout << in.compressedReceived() << " -> " << in.rawReceived() << endl;
+ * \endcode
+ *
+ * Both ends must use a CompressedStream, the block size only needs to be
+ * set at the sending end. The socket must be blocking. One thread may
+ * send while another receives, but neither direction is thread safe.
+ */
+class NKFNET_API CompressedStream {
+public:
+	/**
+	 * Creates a new compressed stream.
+	 *
+	 * \param	sock		The connected TCP socket.
+	 * \param	blockSize	The maximum size of a block, at most 4 MiB.
+	 */
+	CompressedStream(Socket & sock, size_t blockSize = 64 * 1024);
+
+	/**
+	 * Writes data. Complete blocks are compressed and sent, the rest is
+	 * held until the block is full, or flush() is called.
+	 *
+	 * \param	buf		The data.
+	 * \param	len		The length of the data in bytes.
+	 */
+	void	write(const void * buf, size_t len);
+
+	/**
+	 * Compresses and sends the data held by write(), if any.
+	 */
+	void	flush();
+
+	/**
+	 * Writes data and flushes, see write() and flush().
+	 *
+	 * \param	buf		The data.
+	 * \param	len		The length of the data in bytes.
+	 *
+	 * \return			The number of bytes send, i.e. len.
+	 */
+	size_t	send(const void * buf, size_t len);
+
+	/**
+	 * Receives decompressed data, reading a new block from the socket
+	 * when all data of the last block has been returned.
+	 *
+	 * \param	buf		The buffer to receive in.
+	 * \param	len		The size of the buffer in bytes.
+	 *
+	 * \return			The number of bytes received, 0 if the peer closed
+	 * 					the connection.
+	 */
+	size_t	receive(void * buf, size_t len);
+
+	/**
+	 * Changes the block size. Larger blocks compress better, smaller
+	 * blocks hold back less data. Flushes data held by write().
+	 *
+	 * \param	blockSize	The maximum size of a block, at most 4 MiB.
+	 */
+	void	setBlockSize(size_t blockSize);
+
+	/**
+	 * Sets how much a block must shrink to be sent compressed, in percent
+	 * of its size. Other blocks are sent as they are, and the receiver
+	 * does not need to decompress them. The default is 10%.
+	 *
+	 * \param	percent		The minimum saving, 0 to compress any block
+	 * 						which does not grow.
+	 */
+	void	setMinSaving(unsigned percent);
+
+	/**
+	 * Returns the number of bytes written, before compression.
+	 *
+	 * \return	The number of bytes.
+	 */
+	unsigned long long rawSent();
+
+	/**
+	 * Returns the number of bytes sent on the socket, headers included.
+	 *
+	 * \return	The number of bytes.
+	 */
+	unsigned long long compressedSent();
+
+	/**
+	 * Returns the number of bytes received, after decompression.
+	 *
+	 * \return	The number of bytes.
+	 */
+	unsigned long long rawReceived();
+
+	/**
+	 * Returns the number of bytes received from the socket, headers
+	 * included.
+	 *
+	 * \return	The number of bytes.
+	 */
+	unsigned long long compressedReceived();
+
+	/**
+	 * Returns the number of blocks sent uncompressed, because they did
+	 * not compress well enough.
+	 *
+	 * \return	The number of blocks.
+	 */
+	unsigned long bypassed();
+
+	/**
+	 * Sets the byte and block counters back to 0.
+	 */
+	void	resetCounters();
+
+	/**
+	 * Destroys the stream, without flushing.
+	 */
+	virtual ~CompressedStream();
+
+private:
+	void	sendBlock(const char * data, size_t len);
+
+	bool	receiveBlock();
+
+	bool	receiveAll(void * buf, size_t len, bool eofAllowed);
+
+	CompressedStream(const CompressedStream &);
+
+	CompressedStream & operator=(const CompressedStream &);
+
+	Socket &			_sock;
+
+	size_t				_blockSize;
+
+	unsigned			_minSaving;
+
+	std::vector<char>	_out;		// raw data held by write()
+
+	size_t				_outLen;
+
+	std::vector<char>	_packed;	// compressed block to send
+
+	std::vector<char>	_in;		// decompressed block
+
+	size_t				_inPos;
+
+	size_t				_inLen;
+
+	std::vector<char>	_inPacked;	// compressed block received
+
+	unsigned long long	_rawSent;
+
+	unsigned long long	_compressedSent;
+
+	unsigned long long	_rawReceived;
+
+	unsigned long long	_compressedReceived;
+
+	unsigned long		_bypassed;
+};
+
+END_NKF_NET
+
+#endif /* COMPRESSEDSTREAM_H_ */
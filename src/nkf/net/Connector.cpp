@@ -0,0 +1,174 @@
+/*
+ * Connector.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "Connector.h"
+#include "SocketSet.h"
+#include "SocketException.h"
+#include <chrono>
+
+START_NKF_NET
+
+// --------------------------------------------------------------------------
+// Connector
+// --------------------------------------------------------------------------
+
+Connector::Attempt::Attempt(const Address & a) :
+	addr(a),
+	socket(NULL),
+	status(CONNECT_PENDING),
+	error(0) {
+	elapsed = mktv(0, 0);
+}
+
+// --------------------------------------------------------------------------
+
+Connector::Connector() {
+}
+
+// --------------------------------------------------------------------------
+
+size_t Connector::add(const Address & addr) {
+	_attempts.push_back(Attempt(addr));
+	return _attempts.size() - 1;
+}
+
+// --------------------------------------------------------------------------
+
+size_t Connector::run(timeval timeout) {
+	// monotonic, a step of the wall clock must not move the deadline
+	unsigned long long start = now();
+	unsigned long long deadline = start + timeout.tv_sec * 1000000ULL + timeout.tv_usec;
+
+	// start all attempts at once
+	for (size_t i = 0; i < _attempts.size(); ++i) {
+		Attempt & a = _attempts[i];
+		if (a.status != CONNECT_PENDING || a.socket != NULL) continue;
+		try {
+			a.socket = new Socket(TCP);
+			a.socket->setBlocking(false);
+			if (a.socket->beginConnect(a.addr)) {
+				complete(a, CONNECT_OK, 0, start);
+			}
+		} catch (SocketException & se) {
+			complete(a, CONNECT_FAILED, se.code(), start);
+		}
+	}
+
+	SocketSet write, error;
+	while (true) {
+		write.zero();
+		error.zero();
+		bool pending = false;
+		for (size_t i = 0; i < _attempts.size(); ++i) {
+			Attempt & a = _attempts[i];
+			if (a.status != CONNECT_PENDING) continue;
+			write.set(*a.socket);
+			error.set(*a.socket);
+			pending = true;
+		}
+		if (!pending) break;
+
+		unsigned long long time = now();
+		if (time >= deadline) {
+			for (size_t i = 0; i < _attempts.size(); ++i) {
+				if (_attempts[i].status == CONNECT_PENDING)
+					complete(_attempts[i], CONNECT_TIMEOUT, ETIMEDOUT, start);
+			}
+			break;
+		}
+		unsigned long long left = deadline - time;
+		timeval remaining = mktv(static_cast<unsigned long> (left / 1000000), static_cast<unsigned long> (left % 1000000));
+
+		if (SocketSet::select(NULL, &write, &error, remaining) == 0) continue;
+
+		for (size_t i = 0; i < _attempts.size(); ++i) {
+			Attempt & a = _attempts[i];
+			if (a.status != CONNECT_PENDING) continue;
+			if (!write.isSet(*a.socket) && !error.isSet(*a.socket)) continue;
+			int code = a.socket->connectError();
+			complete(a, code == 0 ? CONNECT_OK : CONNECT_FAILED, code, start);
+		}
+	}
+
+	size_t connected = 0;
+	for (size_t i = 0; i < _attempts.size(); ++i) {
+		if (_attempts[i].status == CONNECT_OK) ++connected;
+	}
+	return connected;
+}
+
+// --------------------------------------------------------------------------
+
+void Connector::complete(Attempt & attempt, ConnectStatus status, int error, unsigned long long start) {
+	unsigned long long took = now() - start;
+	attempt.elapsed = mktv(static_cast<unsigned long> (took / 1000000), static_cast<unsigned long> (took % 1000000));
+	attempt.status = status;
+	attempt.error = error;
+
+	if (status == CONNECT_OK) {
+		attempt.socket->setBlocking(true);
+	} else {
+		delete attempt.socket;
+		attempt.socket = NULL;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long Connector::now() {
+	return std::chrono::duration_cast<std::chrono::microseconds> (
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// --------------------------------------------------------------------------
+
+size_t Connector::count() {
+	return _attempts.size();
+}
+
+// --------------------------------------------------------------------------
+
+Address Connector::address(size_t index) {
+	return _attempts.at(index).addr;
+}
+
+// --------------------------------------------------------------------------
+
+ConnectStatus Connector::status(size_t index) {
+	return _attempts.at(index).status;
+}
+
+// --------------------------------------------------------------------------
+
+int Connector::error(size_t index) {
+	return _attempts.at(index).error;
+}
+
+// --------------------------------------------------------------------------
+
+timeval Connector::elapsed(size_t index) {
+	return _attempts.at(index).elapsed;
+}
+
+// --------------------------------------------------------------------------
+
+Socket* Connector::take(size_t index) {
+	Attempt & a = _attempts.at(index);
+	Socket * sock = a.socket;
+	a.socket = NULL;
+	return sock;
+}
+
+// --------------------------------------------------------------------------
+
+Connector::~Connector() {
+	for (size_t i = 0; i < _attempts.size(); ++i) {
+		delete _attempts[i].socket;
+	}
+}
+
+END_NKF_NET
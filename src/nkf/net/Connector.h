@@ -0,0 +1,156 @@
+/*
+ * Connector.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef CONNECTOR_H_
+#define CONNECTOR_H_
+
+#include <vector>
+#include "net.h"
+#include "Socket.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * The state of a connection attempt made by a Connector.
+ */
+enum ConnectStatus {
+	CONNECT_PENDING /* < Not yet completed */,
+	CONNECT_OK /* < Connected */,
+	CONNECT_FAILED /* < Failed, see Connector::error */,
+	CONNECT_TIMEOUT /* < Not connected before the deadline */
+};
+
+/**
+ * Connector connects to many hosts at once. All connection attempts are
+ * started non-blocking and then driven to completion together using
+ * SocketSet::select, so a dead host only costs the deadline instead of a
+ * full TCP timeout for every host in turn.
+ *
+ * \code
+ * Connector conn;
+ * for (int i = 0; i < doms; ++i) {
+ *   conn.add(Address(IP4(10, 0, 1, i), 5000));
+ * }
+ * conn.run(mktv(2, 0));
+ * for (size_t i = 0; i < conn.count(); ++i) {
+ *   if (conn.status(i) == CONNECT_OK) {
+ *     Socket * s = conn.take(i);	// now owned by caller
+ *     // ...
+ *   }
+ * }
+ * \endcode
+ *
+ * Because SocketSet is used, all handles must be below FD_SETSIZE.
+ */
+class NKFNET_API Connector {
+public:
+	/**
+	 * Creates a new, empty Connector.
+	 */
+	Connector();
+
+	/**
+	 * Adds a TCP connection attempt to the given address.
+	 *
+	 * \param	addr	The remote address to connect to.
+	 *
+	 * \return			The index of the attempt.
+	 */
+	size_t	add(const Address & addr);
+
+	/**
+	 * Runs all pending connection attempts until they are either connected,
+	 * have failed, or the timeout expires.
+	 *
+	 * Connected sockets are returned to blocking mode.
+	 *
+	 * \param	timeout		The maximum time to wait for all attempts.
+	 *
+	 * \return				The number of successful connections.
+	 */
+	size_t	run(timeval timeout);
+
+	/**
+	 * Returns the number of connection attempts.
+	 *
+	 * \return	The number of attempts.
+	 */
+	size_t	count();
+
+	/**
+	 * Returns the address of the given attempt.
+	 *
+	 * \param	index	The index of the attempt.
+	 */
+	Address	address(size_t index);
+
+	/**
+	 * Returns the status of the given attempt.
+	 *
+	 * \param	index	The index of the attempt.
+	 */
+	ConnectStatus status(size_t index);
+
+	/**
+	 * Returns the native error code of a failed attempt, ETIMEDOUT for an
+	 * attempt which timed out, or 0.
+	 *
+	 * \param	index	The index of the attempt.
+	 */
+	int		error(size_t index);
+
+	/**
+	 * Returns the time the attempt took until it completed, failed or timed
+	 * out.
+	 *
+	 * \param	index	The index of the attempt.
+	 */
+	timeval	elapsed(size_t index);
+
+	/**
+	 * Takes the socket of a successful attempt. The caller becomes the
+	 * owner of the socket and must delete it.
+	 *
+	 * \param	index	The index of the attempt.
+	 *
+	 * \return			The connected socket, or NULL if the attempt was
+	 * 					not successful or the socket was already taken.
+	 */
+	Socket*	take(size_t index);
+
+	/**
+	 * Destroys the Connector, closing all sockets which were not taken.
+	 */
+	virtual ~Connector();
+
+private:
+	struct Attempt {
+		Address			addr;
+		Socket *		socket;
+		ConnectStatus	status;
+		int				error;
+		timeval			elapsed;
+
+		Attempt(const Address & a);
+	};
+
+	void	complete(Attempt & attempt, ConnectStatus status, int error, unsigned long long start);
+
+	static unsigned long long now();
+
+	Connector(const Connector &);
+
+	Connector & operator=(const Connector &);
+
+	std::vector<Attempt> _attempts;
+};
+
+END_NKF_NET
+
+#endif /* CONNECTOR_H_ */
@@ -0,0 +1,305 @@
+/*
+ * Crc32c.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "Crc32c.h"
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define CRC32C_SSE42
+#include <nmmintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__linux__) && defined(__GNUC__)
+#define CRC32C_ARMV8
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+START_NKF_NET
+
+/*
+ * The table version is 'slicing by 8'. The SSE4.2 version computes three
+ * CRCs over adjacent blocks at once, to hide the latency of the crc32
+ * instruction, and combines them by shifting the first two over the
+ * length of the blocks that follow, with tables made at start-up. This
+ * is the method of Mark Adler's crc32c.c.
+ */
+
+static const uint32_t	POLY = 0x82f63b78;		// reflected
+
+typedef uint32_t (*Crc32cFunc)(uint32_t crc, const unsigned char * buf, size_t len);
+
+static uint32_t			slicing[8][256];
+
+// --------------------------------------------------------------------------
+
+static void initSlicing() {
+	for (uint32_t n = 0; n < 256; ++n) {
+		uint32_t crc = n;
+		for (int k = 0; k < 8; ++k) {
+			crc = crc & 1 ? (crc >> 1) ^ POLY : crc >> 1;
+		}
+		slicing[0][n] = crc;
+	}
+	for (uint32_t n = 0; n < 256; ++n) {
+		uint32_t crc = slicing[0][n];
+		for (int k = 1; k < 8; ++k) {
+			crc = slicing[0][crc & 0xff] ^ (crc >> 8);
+			slicing[k][n] = crc;
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+
+static uint32_t crcTable(uint32_t crc, const unsigned char * buf, size_t len) {
+	while (len > 0 && (reinterpret_cast<uintptr_t> (buf) & 7) != 0) {
+		crc = slicing[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+		--len;
+	}
+	while (len >= 8) {
+		uint64_t word;
+		memcpy(&word, buf, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		word = __builtin_bswap64(word);
+#endif
+		word ^= crc;
+		crc = slicing[7][word & 0xff] ^
+				slicing[6][(word >> 8) & 0xff] ^
+				slicing[5][(word >> 16) & 0xff] ^
+				slicing[4][(word >> 24) & 0xff] ^
+				slicing[3][(word >> 32) & 0xff] ^
+				slicing[2][(word >> 40) & 0xff] ^
+				slicing[1][(word >> 48) & 0xff] ^
+				slicing[0][word >> 56];
+		buf += 8;
+		len -= 8;
+	}
+	while (len > 0) {
+		crc = slicing[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+		--len;
+	}
+	return crc;
+}
+
+#ifdef CRC32C_SSE42
+
+static const size_t		LONG_BLOCK = 8192;
+
+static const size_t		SHORT_BLOCK = 256;
+
+static uint32_t			longShift[4][256];
+
+static uint32_t			shortShift[4][256];
+
+// --------------------------------------------------------------------------
+
+static uint32_t gf2Times(const uint32_t * mat, uint32_t vec) {
+	uint32_t sum = 0;
+	while (vec != 0) {
+		if (vec & 1) sum ^= *mat;
+		vec >>= 1;
+		++mat;
+	}
+	return sum;
+}
+
+// --------------------------------------------------------------------------
+
+static void gf2Square(uint32_t * square, const uint32_t * mat) {
+	for (int n = 0; n < 32; ++n) {
+		square[n] = gf2Times(mat, mat[n]);
+	}
+}
+
+// --------------------------------------------------------------------------
+
+/*
+ * Makes the tables which shift a CRC over len zero bytes.
+ */
+static void initShift(uint32_t zeros[4][256], size_t len) {
+	uint32_t even[32];
+	uint32_t odd[32];
+
+	// the operator for one zero bit
+	odd[0] = POLY;
+	uint32_t row = 1;
+	for (int n = 1; n < 32; ++n) {
+		odd[n] = row;
+		row <<= 1;
+	}
+	gf2Square(even, odd);		// two zero bits
+	gf2Square(odd, even);		// four zero bits
+
+	// square until the bits of len are used up, 8 zero bits at first
+	const uint32_t * op;
+	for (;;) {
+		gf2Square(even, odd);
+		len >>= 1;
+		if (len == 0) {
+			op = even;
+			break;
+		}
+		gf2Square(odd, even);
+		len >>= 1;
+		if (len == 0) {
+			op = odd;
+			break;
+		}
+	}
+
+	for (uint32_t n = 0; n < 256; ++n) {
+		zeros[0][n] = gf2Times(op, n);
+		zeros[1][n] = gf2Times(op, n << 8);
+		zeros[2][n] = gf2Times(op, n << 16);
+		zeros[3][n] = gf2Times(op, n << 24);
+	}
+}
+
+// --------------------------------------------------------------------------
+
+static inline uint32_t shift(uint32_t zeros[4][256], uint32_t crc) {
+	return zeros[0][crc & 0xff] ^ zeros[1][(crc >> 8) & 0xff] ^
+			zeros[2][(crc >> 16) & 0xff] ^ zeros[3][crc >> 24];
+}
+
+// --------------------------------------------------------------------------
+
+__attribute__((target("sse4.2")))
+static uint32_t crcSse42(uint32_t crc, const unsigned char * buf, size_t len) {
+	uint64_t crc0 = crc;
+	while (len > 0 && (reinterpret_cast<uintptr_t> (buf) & 7) != 0) {
+		crc0 = _mm_crc32_u8(static_cast<uint32_t> (crc0), *buf++);
+		--len;
+	}
+
+	while (len >= 3 * LONG_BLOCK) {
+		uint64_t crc1 = 0;
+		uint64_t crc2 = 0;
+		const unsigned char * end = buf + LONG_BLOCK;
+		do {
+			crc0 = _mm_crc32_u64(crc0, *reinterpret_cast<const uint64_t*> (buf));
+			crc1 = _mm_crc32_u64(crc1, *reinterpret_cast<const uint64_t*> (buf + LONG_BLOCK));
+			crc2 = _mm_crc32_u64(crc2, *reinterpret_cast<const uint64_t*> (buf + 2 * LONG_BLOCK));
+			buf += 8;
+		} while (buf < end);
+		crc0 = shift(longShift, static_cast<uint32_t> (crc0)) ^ crc1;
+		crc0 = shift(longShift, static_cast<uint32_t> (crc0)) ^ crc2;
+		buf += 2 * LONG_BLOCK;
+		len -= 3 * LONG_BLOCK;
+	}
+
+	while (len >= 3 * SHORT_BLOCK) {
+		uint64_t crc1 = 0;
+		uint64_t crc2 = 0;
+		const unsigned char * end = buf + SHORT_BLOCK;
+		do {
+			crc0 = _mm_crc32_u64(crc0, *reinterpret_cast<const uint64_t*> (buf));
+			crc1 = _mm_crc32_u64(crc1, *reinterpret_cast<const uint64_t*> (buf + SHORT_BLOCK));
+			crc2 = _mm_crc32_u64(crc2, *reinterpret_cast<const uint64_t*> (buf + 2 * SHORT_BLOCK));
+			buf += 8;
+		} while (buf < end);
+		crc0 = shift(shortShift, static_cast<uint32_t> (crc0)) ^ crc1;
+		crc0 = shift(shortShift, static_cast<uint32_t> (crc0)) ^ crc2;
+		buf += 2 * SHORT_BLOCK;
+		len -= 3 * SHORT_BLOCK;
+	}
+
+	while (len >= 8) {
+		crc0 = _mm_crc32_u64(crc0, *reinterpret_cast<const uint64_t*> (buf));
+		buf += 8;
+		len -= 8;
+	}
+	while (len > 0) {
+		crc0 = _mm_crc32_u8(static_cast<uint32_t> (crc0), *buf++);
+		--len;
+	}
+	return static_cast<uint32_t> (crc0);
+}
+
+#endif
+
+#ifdef CRC32C_ARMV8
+
+// --------------------------------------------------------------------------
+
+__attribute__((target("+crc")))
+static uint32_t crcArmv8(uint32_t crc, const unsigned char * buf, size_t len) {
+	while (len > 0 && (reinterpret_cast<uintptr_t> (buf) & 7) != 0) {
+		crc = __crc32cb(crc, *buf++);
+		--len;
+	}
+	while (len >= 8) {
+		uint64_t word;
+		memcpy(&word, buf, sizeof(word));
+		crc = __crc32cd(crc, word);
+		buf += 8;
+		len -= 8;
+	}
+	while (len > 0) {
+		crc = __crc32cb(crc, *buf++);
+		--len;
+	}
+	return crc;
+}
+
+#endif
+
+// --------------------------------------------------------------------------
+
+struct Crc32cImpl {
+	Crc32cFunc		func;
+	const char *	name;
+};
+
+static Crc32cImpl selectImpl() {
+	Crc32cImpl impl;
+#ifdef CRC32C_SSE42
+	if (__builtin_cpu_supports("sse4.2")) {
+		initShift(longShift, LONG_BLOCK);
+		initShift(shortShift, SHORT_BLOCK);
+		impl.func = crcSse42;
+		impl.name = "sse4.2";
+		return impl;
+	}
+#endif
+#ifdef CRC32C_ARMV8
+	if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+		impl.func = crcArmv8;
+		impl.name = "armv8";
+		return impl;
+	}
+#endif
+	initSlicing();
+	impl.func = crcTable;
+	impl.name = "table";
+	return impl;
+}
+
+// --------------------------------------------------------------------------
+
+static const Crc32cImpl & current() {
+	static const Crc32cImpl impl = selectImpl();
+	return impl;
+}
+
+// --------------------------------------------------------------------------
+// Crc32c
+// --------------------------------------------------------------------------
+
+uint32_t Crc32c::update(uint32_t crc, const void * buf, size_t len) {
+	return ~current().func(~crc, static_cast<const unsigned char*> (buf), len);
+}
+
+// --------------------------------------------------------------------------
+
+const char * Crc32c::implementation() {
+	return current().name;
+}
+
+END_NKF_NET
@@ -0,0 +1,72 @@
+/*
+ * Crc32c.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef CRC32C_H_
+#define CRC32C_H_
+
+#include <stdint.h>
+#include "net.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * Crc32c computes CRC-32C (Castagnoli) checksums, as used by iSCSI, SCTP
+ * and ext4, see Socket::setChecksums.
+ *
+ * The CRC instructions of the processor are used when available (SSE4.2
+ * on x86, the CRC extension on ARMv8), else a table driven version which
+ * processes 8 bytes at a time. The choice is made once, at run time.
+ *
+ * \code
+ * uint32_t crc = Crc32c::compute(buf, len);
+ * // or in parts:
+ * uint32_t crc = Crc32c::update(0, header, sizeof(header));
+ * crc = Crc32c::update(crc, payload, payloadLen);
+ * \endcode
+ */
+class NKFNET_API Crc32c {
+public:
+	/**
+	 * Computes the checksum of a buffer.
+	 *
+	 * \param	buf		The data.
+	 * \param	len		The length of the data in bytes.
+	 *
+	 * \return	The checksum.
+	 */
+	static uint32_t compute(const void * buf, size_t len) {
+		return update(0, buf, len);
+	}
+
+	/**
+	 * Continues a checksum with more data.
+	 *
+	 * \param	crc		The checksum of the data so far, 0 to start.
+	 * \param	buf		The data.
+	 * \param	len		The length of the data in bytes.
+	 *
+	 * \return	The checksum of all data.
+	 */
+	static uint32_t update(uint32_t crc, const void * buf, size_t len);
+
+	/**
+	 * Returns the name of the implementation in use: "sse4.2", "armv8" or
+	 * "table".
+	 *
+	 * \return	The name.
+	 */
+	static const char * implementation();
+
+private:
+	Crc32c();
+};
+
+END_NKF_NET
+
+#endif /* CRC32C_H_ */
@@ -0,0 +1,323 @@
+/*
+ * Fragmenter.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "Fragmenter.h"
+#include "SocketException.h"
+#include <chrono>
+#include <cstring>
+
+START_NKF_NET
+
+/*
+ * Fragment header, all fields in network byte order:
+ *
+ *   0  message id
+ *   4  fragment index
+ *   6  fragment count
+ *   8  message length
+ *  12  offset of the fragment in the message
+ *
+ * The offset is sent, instead of derived from the index, so the receiver
+ * does not need to know the MTU of the sender. Message ids start at a
+ * time dependent value, so the fragments of a restarted sender are not
+ * mistaken for those of an older message.
+ */
+
+static const size_t		HEADER_SIZE = 16;
+
+static const size_t		MAX_FRAGMENTS = 65535;
+
+static const size_t		MAX_DATAGRAM = 65536;
+
+// --------------------------------------------------------------------------
+
+static inline void put16(char * p, uint16_t v) {
+	p[0] = static_cast<char> (v >> 8);
+	p[1] = static_cast<char> (v);
+}
+
+static inline void put32(char * p, uint32_t v) {
+	p[0] = static_cast<char> (v >> 24);
+	p[1] = static_cast<char> (v >> 16);
+	p[2] = static_cast<char> (v >> 8);
+	p[3] = static_cast<char> (v);
+}
+
+static inline uint16_t get16(const char * p) {
+	const unsigned char * u = reinterpret_cast<const unsigned char*> (p);
+	return static_cast<uint16_t> ((u[0] << 8) | u[1]);
+}
+
+static inline uint32_t get32(const char * p) {
+	const unsigned char * u = reinterpret_cast<const unsigned char*> (p);
+	return (static_cast<uint32_t> (u[0]) << 24) | (u[1] << 16) | (u[2] << 8) | u[3];
+}
+
+// --------------------------------------------------------------------------
+// Fragmenter
+// --------------------------------------------------------------------------
+
+Fragmenter::Fragmenter(Socket & sock, size_t maxMessage, size_t slots,
+		unsigned int timeout, size_t mtu) :
+	_sock(sock),
+	_maxMessage(maxMessage),
+	_timeout(timeout),
+	_mtu(mtu),
+	_nextId(static_cast<uint32_t> (std::chrono::steady_clock::now().time_since_epoch().count())),
+	_in(MAX_DATAGRAM),
+	_slots(slots),
+	_inUse(0),
+	_messages(0),
+	_timedOut(0),
+	_evicted(0),
+	_invalid(0),
+	_duplicates(0) {
+	if (mtu <= HEADER_SIZE || mtu > MAX_DATAGRAM)
+		throw SocketException("Invalid MTU for fragmentation", EINVAL);
+	if (slots == 0)
+		throw SocketException("At least one reassembly slot is required", EINVAL);
+
+	// a message never has more fragments than the bitmap holds
+	for (size_t i = 0; i < _slots.size(); ++i) {
+		_slots[i].data.resize(maxMessage);
+		_slots[i].have.resize((MAX_FRAGMENTS + 63) / 64);
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void Fragmenter::send(const void * buf, size_t len) {
+	sendFragments(buf, len, NULL);
+}
+
+// --------------------------------------------------------------------------
+
+void Fragmenter::send(const void * buf, size_t len, const Address & addr) {
+	sendFragments(buf, len, &addr);
+}
+
+// --------------------------------------------------------------------------
+
+void Fragmenter::sendFragments(const void * buf, size_t len, const Address * addr) {
+	const char * data = static_cast<const char*> (buf);
+	size_t payload = _mtu - HEADER_SIZE;
+	size_t count = len == 0 ? 1 : (len + payload - 1) / payload;
+	if (count > MAX_FRAGMENTS || len > 0xffffffffUL)
+		throw SocketException("Message too large to fragment", EMSGSIZE);
+
+	if (_out.size() < count * _mtu) _out.resize(count * _mtu);
+	_batch.resize(count);
+	uint32_t id = _nextId++;
+
+	for (size_t i = 0; i < count; ++i) {
+		size_t offset = i * payload;
+		size_t part = len - offset < payload ? len - offset : payload;
+		char * dgram = &_out[i * _mtu];
+		put32(dgram, id);
+		put16(dgram + 4, static_cast<uint16_t> (i));
+		put16(dgram + 6, static_cast<uint16_t> (count));
+		put32(dgram + 8, static_cast<uint32_t> (len));
+		put32(dgram + 12, static_cast<uint32_t> (offset));
+		memcpy(dgram + HEADER_SIZE, data + offset, part);
+
+		_batch[i].data = dgram;
+		_batch[i].length = HEADER_SIZE + part;
+		_batch[i].addr = addr;
+	}
+
+	size_t sent = 0;
+	while (sent < count) {
+		sent += _sock.sendBatch(&_batch[sent], count - sent);
+	}
+}
+
+// --------------------------------------------------------------------------
+
+size_t Fragmenter::receive(void * buf, size_t len, Address * addr) {
+	Address from = Address::ANY;
+	for (;;) {
+		size_t bytes = _sock.receive(&_in[0], _in.size(), &from);
+		unsigned long long time = now();
+		expire(time);
+
+		if (bytes < HEADER_SIZE) {
+			++_invalid;
+			continue;
+		}
+		uint32_t id = get32(&_in[0]);
+		uint16_t index = get16(&_in[4]);
+		uint16_t count = get16(&_in[6]);
+		uint32_t length = get32(&_in[8]);
+		uint32_t offset = get32(&_in[12]);
+		size_t part = bytes - HEADER_SIZE;
+		if (count == 0 || index >= count || offset > length || part > length - offset) {
+			++_invalid;
+			continue;
+		}
+
+		if (count == 1) {
+			if (part != length || part > len) {
+				++_invalid;
+				continue;
+			}
+			memcpy(buf, &_in[HEADER_SIZE], part);
+			if (addr != NULL) *addr = from;
+			++_messages;
+			return part;
+		}
+
+		if (length > _maxMessage) {
+			++_invalid;
+			continue;
+		}
+		Slot & slot = *findSlot(from, id, time);
+		if (slot.length != length || slot.count != count) {
+			++_invalid;
+			continue;
+		}
+		uint64_t bit = static_cast<uint64_t> (1) << (index & 63);
+		if (slot.have[index >> 6] & bit) {
+			++_duplicates;
+			continue;
+		}
+		slot.have[index >> 6] |= bit;
+		memcpy(&slot.data[offset], &_in[HEADER_SIZE], part);
+		++slot.received;
+		slot.bytes += part;
+		_inUse += part;
+
+		if (slot.received == slot.count) {
+			size_t msgLen = slot.length;
+			bool complete = slot.bytes == msgLen && msgLen <= len;
+			if (complete) {
+				memcpy(buf, &slot.data[0], msgLen);
+				if (addr != NULL) *addr = slot.from;
+			}
+			release(slot);
+			if (!complete) {
+				++_invalid;
+				continue;
+			}
+			++_messages;
+			return msgLen;
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+
+Fragmenter::Slot * Fragmenter::findSlot(const Address & from, uint32_t id, unsigned long long time) {
+	Slot * free = NULL;
+	Slot * oldest = NULL;
+	for (size_t i = 0; i < _slots.size(); ++i) {
+		Slot & slot = _slots[i];
+		if (!slot.used) {
+			if (free == NULL) free = &slot;
+		} else if (slot.id == id && slot.from == from) {
+			return &slot;
+		} else if (oldest == NULL || slot.started < oldest->started) {
+			oldest = &slot;
+		}
+	}
+	if (free == NULL) {
+		++_evicted;
+		release(*oldest);
+		free = oldest;
+	}
+	// the message is described by the first fragment which arrives
+	uint32_t length = get32(&_in[8]);
+	uint16_t count = get16(&_in[6]);
+	free->used = true;
+	free->from = from;
+	free->id = id;
+	free->length = length;
+	free->count = count;
+	free->received = 0;
+	free->bytes = 0;
+	free->started = time;
+	return free;
+}
+
+// --------------------------------------------------------------------------
+
+void Fragmenter::expire(unsigned long long time) {
+	for (size_t i = 0; i < _slots.size(); ++i) {
+		if (_slots[i].used && time - _slots[i].started > _timeout) {
+			++_timedOut;
+			release(_slots[i]);
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void Fragmenter::release(Slot & slot) {
+	_inUse -= slot.bytes;
+	memset(&slot.have[0], 0, ((slot.count + 63) / 64) * sizeof(uint64_t));
+	slot.used = false;
+	slot.bytes = 0;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long Fragmenter::now() {
+	return std::chrono::duration_cast<std::chrono::milliseconds> (
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long Fragmenter::messages() {
+	return _messages;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long Fragmenter::timedOut() {
+	return _timedOut;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long Fragmenter::evicted() {
+	return _evicted;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long Fragmenter::invalid() {
+	return _invalid;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long Fragmenter::duplicates() {
+	return _duplicates;
+}
+
+// --------------------------------------------------------------------------
+
+size_t Fragmenter::memoryInUse() {
+	return _inUse;
+}
+
+// --------------------------------------------------------------------------
+
+size_t Fragmenter::memoryReserved() {
+	size_t bytes = _in.size();
+	for (size_t i = 0; i < _slots.size(); ++i) {
+		bytes += _slots[i].data.size() + _slots[i].have.size() * sizeof(uint64_t);
+	}
+	return bytes;
+}
+
+// --------------------------------------------------------------------------
+
+Fragmenter::~Fragmenter() {
+}
+
+END_NKF_NET
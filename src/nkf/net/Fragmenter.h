@@ -0,0 +1,217 @@
+/*
+ * Fragmenter.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef FRAGMENTER_H_
+#define FRAGMENTER_H_
+
+#include <stdint.h>
+#include <vector>
+#include "net.h"
+#include "Socket.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * Fragmenter sends messages larger than the MTU over UDP as a series of
+ * datagrams which each fit in the MTU, and reassembles them at the
+ * receiving end, instead of leaving it to IP fragmentation.
+ *
+ * Every datagram has a 16 byte header with the message id, the fragment
+ * index and count, the message length and the offset of the fragment.
+ * Fragments may arrive in any order and are copied into a preallocated
+ * slot; when all have arrived the message is returned by receive().
+ * Messages of one fragment are returned right away.
+ *
+ * A message which does not complete within the timeout is dropped, and
+ * when all slots are in use, the oldest incomplete message is evicted to
+ * make room for a new one. Both are counted as reassembly failures.
+ * Incomplete messages are only checked when datagrams are received.
+ *
+ * \code
+ * // sender
+ * Fragmenter frag(sock);
+ * frag.send(table, tableLen, Address("daq01", 5000));
+ *
+ * // receiver
+ * Fragmenter frag(sock, 4 * 1024 * 1024, 8, 500);
+ * std::vector<char> buf(4 * 1024 * 1024);
+ * Address from = Address::ANY;
+ * size_t len = frag.receive(&buf[0], buf.size(), &from);
+ * \endcode
+ *
+ * Both ends must use a Fragmenter. Not thread safe, but sending and
+ * receiving may be done by different Fragmenters on the same socket.
+ */
+class NKFNET_API Fragmenter {
+public:
+	/**
+	 * Creates a new fragmenter.
+	 *
+	 * \param	sock		The UDP socket to send and receive on.
+	 * \param	maxMessage	The largest message to reassemble, in bytes.
+	 * \param	slots		The number of messages which can be reassembled
+	 * 						at the same time.
+	 * \param	timeout		The time in milliseconds after which an
+	 * 						incomplete message is dropped.
+	 * \param	mtu			The largest datagram to send, headers included,
+	 * 						1472 bytes fits an Ethernet frame over IPv4.
+	 */
+	Fragmenter(Socket & sock, size_t maxMessage = 1024 * 1024, size_t slots = 16,
+			unsigned int timeout = 1000, size_t mtu = 1472);
+
+	/**
+	 * Sends a message to the connected address.
+	 *
+	 * \param	buf		The message.
+	 * \param	len		The length of the message in bytes.
+	 */
+	void	send(const void * buf, size_t len);
+
+	/**
+	 * Sends a message.
+	 *
+	 * \param	buf		The message.
+	 * \param	len		The length of the message in bytes.
+	 * \param	addr	The address to send to.
+	 */
+	void	send(const void * buf, size_t len, const Address & addr);
+
+	/**
+	 * Receives the next complete message. Messages which do not fit in
+	 * the buffer are dropped, and counted as invalid.
+	 *
+	 * \param	buf		The buffer to receive in.
+	 * \param	len		The size of the buffer in bytes.
+	 * \param	addr	Receives the address of the sender, may be NULL.
+	 *
+	 * \return			The length of the message in bytes.
+	 */
+	size_t	receive(void * buf, size_t len, Address * addr = NULL);
+
+	/**
+	 * Returns the number of complete messages received.
+	 *
+	 * \return	The number of messages.
+	 */
+	unsigned long long messages();
+
+	/**
+	 * Returns the number of incomplete messages dropped after the
+	 * timeout.
+	 *
+	 * \return	The number of messages.
+	 */
+	unsigned long timedOut();
+
+	/**
+	 * Returns the number of incomplete messages evicted because all slots
+	 * were in use.
+	 *
+	 * \return	The number of messages.
+	 */
+	unsigned long evicted();
+
+	/**
+	 * Returns the number of datagrams which were not valid fragments, or
+	 * belonged to a message which was too large.
+	 *
+	 * \return	The number of datagrams.
+	 */
+	unsigned long invalid();
+
+	/**
+	 * Returns the number of fragments received more than once.
+	 *
+	 * \return	The number of fragments.
+	 */
+	unsigned long duplicates();
+
+	/**
+	 * Returns the number of bytes held by incomplete messages.
+	 *
+	 * \return	The number of bytes.
+	 */
+	size_t	memoryInUse();
+
+	/**
+	 * Returns the number of bytes allocated for reassembly, which does not
+	 * change after construction.
+	 *
+	 * \return	The number of bytes.
+	 */
+	size_t	memoryReserved();
+
+	virtual ~Fragmenter();
+
+private:
+	struct Slot {
+		Slot() : used(false), from(Address::ANY), id(0), length(0), count(0),
+				received(0), bytes(0), started(0) {
+		}
+
+		bool					used;
+		Address					from;
+		uint32_t				id;
+		uint32_t				length;
+		uint16_t				count;
+		uint16_t				received;
+		size_t					bytes;
+		unsigned long long		started;
+		std::vector<char>		data;
+		std::vector<uint64_t>	have;	// bit per fragment
+	};
+
+	void	sendFragments(const void * buf, size_t len, const Address * addr);
+
+	Slot *	findSlot(const Address & from, uint32_t id, unsigned long long now);
+
+	void	expire(unsigned long long now);
+
+	void	release(Slot & slot);
+
+	static unsigned long long now();
+
+	Fragmenter(const Fragmenter &);
+
+	Fragmenter & operator=(const Fragmenter &);
+
+	Socket &				_sock;
+
+	size_t					_maxMessage;
+
+	unsigned long long		_timeout;
+
+	size_t					_mtu;
+
+	uint32_t				_nextId;
+
+	std::vector<char>		_out;		// datagrams of the message being sent
+
+	std::vector<Datagram>	_batch;
+
+	std::vector<char>		_in;		// datagram being received
+
+	std::vector<Slot>		_slots;
+
+	size_t					_inUse;
+
+	unsigned long long		_messages;
+
+	unsigned long			_timedOut;
+
+	unsigned long			_evicted;
+
+	unsigned long			_invalid;
+
+	unsigned long			_duplicates;
+};
+
+END_NKF_NET
+
+#endif /* FRAGMENTER_H_ */
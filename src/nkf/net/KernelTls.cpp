@@ -0,0 +1,348 @@
+/*
+ * KernelTls.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "KernelTls.h"
+#include "SocketException.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+#ifndef TCP_ULP
+#define TCP_ULP			31
+#endif
+#ifndef SOL_TLS
+#define SOL_TLS			282
+#endif
+#endif
+
+#ifdef HAVE_OPENSSL
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/hmac.h>
+#include <openssl/evp.h>
+#endif
+
+START_NKF_NET
+
+#if defined(HAVE_OPENSSL) && defined(__linux__) && defined(TLS_1_3_VERSION)
+
+/*
+ * OpenSSL does the handshake. The traffic secrets are taken from the key
+ * log callback, and the record keys are derived from them as in RFC 8446
+ * section 7.3, which is what OpenSSL does internally as well.
+ */
+
+static const char	CLIENT_SECRET[] = "CLIENT_TRAFFIC_SECRET_0";
+
+static const char	SERVER_SECRET[] = "SERVER_TRAFFIC_SECRET_0";
+
+static const size_t	MAX_SECRET = 64;
+
+struct TrafficSecrets {
+	unsigned char	client[MAX_SECRET];
+	unsigned char	server[MAX_SECRET];
+	size_t			clientLen;
+	size_t			serverLen;
+};
+
+// --------------------------------------------------------------------------
+
+static void raiseTlsError(const char * what) {
+	unsigned long err = ERR_get_error();
+	std::string msg(what);
+	if (err != 0) {
+		char buf[256];
+		ERR_error_string_n(err, buf, sizeof(buf));
+		msg += ": ";
+		msg += buf;
+	}
+	ERR_clear_error();
+	throw SocketException(msg, EPROTO);
+}
+
+// --------------------------------------------------------------------------
+
+static size_t parseHex(const char * hex, unsigned char * out, size_t max) {
+	size_t n = 0;
+	while (n < max && isxdigit(hex[0]) && isxdigit(hex[1])) {
+		char byte[3] = { hex[0], hex[1], 0 };
+		out[n++] = static_cast<unsigned char> (strtoul(byte, NULL, 16));
+		hex += 2;
+	}
+	return n;
+}
+
+// --------------------------------------------------------------------------
+
+static void keyLog(const SSL * ssl, const char * line) {
+	// "<label> <client random> <secret>"
+	TrafficSecrets * secrets = static_cast<TrafficSecrets*> (SSL_get_app_data(ssl));
+	if (secrets == NULL) return;
+
+	unsigned char * out;
+	size_t * len;
+	if (strncmp(line, CLIENT_SECRET, sizeof(CLIENT_SECRET) - 1) == 0) {
+		out = secrets->client;
+		len = &secrets->clientLen;
+	} else if (strncmp(line, SERVER_SECRET, sizeof(SERVER_SECRET) - 1) == 0) {
+		out = secrets->server;
+		len = &secrets->serverLen;
+	} else {
+		return;
+	}
+	const char * secret = strrchr(line, ' ');
+	if (secret != NULL) *len = parseHex(secret + 1, out, MAX_SECRET);
+}
+
+// --------------------------------------------------------------------------
+
+/*
+ * HKDF-Expand-Label(secret, label, "", length), for a length of at most
+ * one hash block, which covers all keys and IVs.
+ */
+static void expandLabel(const EVP_MD * md, const unsigned char * secret, size_t secretLen,
+		const char * label, unsigned char * out, size_t length) {
+	unsigned char info[64];
+	size_t labelLen = strlen(label);
+	size_t n = 0;
+	info[n++] = static_cast<unsigned char> (length >> 8);
+	info[n++] = static_cast<unsigned char> (length);
+	info[n++] = static_cast<unsigned char> (6 + labelLen);
+	memcpy(info + n, "tls13 ", 6);
+	n += 6;
+	memcpy(info + n, label, labelLen);
+	n += labelLen;
+	info[n++] = 0;		// no context
+	info[n++] = 1;		// first block
+
+	unsigned char block[EVP_MAX_MD_SIZE];
+	unsigned int blockLen = 0;
+	if (HMAC(md, secret, secretLen, info, n, block, &blockLen) == NULL || blockLen < length)
+		raiseTlsError("Could not derive TLS keys");
+	memcpy(out, block, length);
+	OPENSSL_cleanse(block, sizeof(block));
+}
+
+// --------------------------------------------------------------------------
+
+template<typename CryptoInfo>
+static void installKey(SOCKET handle, int direction, int cipher, const EVP_MD * md,
+		const unsigned char * secret, size_t secretLen) {
+	unsigned char iv[12];
+	CryptoInfo info;
+	memset(&info, 0, sizeof(info));
+	info.info.version = TLS_1_3_VERSION;
+	info.info.cipher_type = cipher;
+	expandLabel(md, secret, secretLen, "key", info.key, sizeof(info.key));
+	expandLabel(md, secret, secretLen, "iv", iv, sizeof(iv));
+	memcpy(info.salt, iv, sizeof(info.salt));
+	memcpy(info.iv, iv + sizeof(info.salt), sizeof(info.iv));
+	// no records have been sent with these keys yet, rec_seq stays 0
+
+	int rc = ::setsockopt(handle, SOL_TLS, direction, &info, sizeof(info));
+	OPENSSL_cleanse(&info, sizeof(info));
+	OPENSSL_cleanse(iv, sizeof(iv));
+	if (rc != 0)
+		SocketException::raiseLastError();
+}
+
+#endif
+
+// --------------------------------------------------------------------------
+// KernelTls
+// --------------------------------------------------------------------------
+
+KernelTls::KernelTls(TlsRole role) :
+	_ctx(NULL),
+	_role(role),
+	_verifyPeer(role == TLS_CLIENT),
+	_verifyHostName(true) {
+#if defined(HAVE_OPENSSL) && defined(__linux__) && defined(TLS_1_3_VERSION)
+	SSL_CTX * ctx = SSL_CTX_new(role == TLS_CLIENT ? TLS_client_method() : TLS_server_method());
+	if (ctx == NULL)
+		raiseTlsError("Could not create TLS context");
+
+	// only what the kernel can take over
+	SSL_CTX_set_min_proto_version(ctx, TLS1_3_VERSION);
+	SSL_CTX_set_max_proto_version(ctx, TLS1_3_VERSION);
+	if (SSL_CTX_set_ciphersuites(ctx, "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384") != 1) {
+		SSL_CTX_free(ctx);
+		raiseTlsError("Could not set TLS cipher suites");
+	}
+	SSL_CTX_set_num_tickets(ctx, 0);
+	SSL_CTX_set_keylog_callback(ctx, keyLog);
+
+	if (role == TLS_CLIENT) {
+		SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, NULL);
+		SSL_CTX_set_default_verify_paths(ctx);
+	}
+	_ctx = ctx;
+#else
+	throw SocketException("Kernel TLS not supported on this platform", 0);
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+void KernelTls::setCertificate(const std::string & certFile, const std::string & keyFile) {
+#if defined(HAVE_OPENSSL) && defined(__linux__) && defined(TLS_1_3_VERSION)
+	SSL_CTX * ctx = static_cast<SSL_CTX*> (_ctx);
+	if (SSL_CTX_use_certificate_chain_file(ctx, certFile.c_str()) != 1)
+		raiseTlsError("Could not load certificate");
+	if (SSL_CTX_use_PrivateKey_file(ctx, keyFile.c_str(), SSL_FILETYPE_PEM) != 1)
+		raiseTlsError("Could not load private key");
+	if (SSL_CTX_check_private_key(ctx) != 1)
+		raiseTlsError("Private key does not match certificate");
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+void KernelTls::setTrustedCertificates(const std::string & caFile) {
+#if defined(HAVE_OPENSSL) && defined(__linux__) && defined(TLS_1_3_VERSION)
+	SSL_CTX * ctx = static_cast<SSL_CTX*> (_ctx);
+	if (SSL_CTX_load_verify_locations(ctx, caFile.c_str(), NULL) != 1)
+		raiseTlsError("Could not load trusted certificates");
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+void KernelTls::setVerifyPeer(bool verify) {
+	_verifyPeer = verify;
+#if defined(HAVE_OPENSSL) && defined(__linux__) && defined(TLS_1_3_VERSION)
+	int mode = SSL_VERIFY_NONE;
+	if (verify) {
+		mode = SSL_VERIFY_PEER;
+		if (_role == TLS_SERVER) mode |= SSL_VERIFY_FAIL_IF_NO_PEER_CERT;
+	}
+	SSL_CTX_set_verify(static_cast<SSL_CTX*> (_ctx), mode, NULL);
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+void KernelTls::setVerifyHostName(bool verify) {
+	_verifyHostName = verify;
+}
+
+// --------------------------------------------------------------------------
+
+void KernelTls::handshake(Socket & sock, const std::string & serverName) {
+#if defined(HAVE_OPENSSL) && defined(__linux__) && defined(TLS_1_3_VERSION)
+	// else any certificate signed by a trusted CA, for any host, is accepted
+	if (_role == TLS_CLIENT && _verifyPeer && _verifyHostName && serverName.empty())
+		throw SocketException("Server name required to verify the server certificate", EINVAL);
+
+	TrafficSecrets secrets;
+	memset(&secrets, 0, sizeof(secrets));
+
+	SSL * ssl = SSL_new(static_cast<SSL_CTX*> (_ctx));
+	if (ssl == NULL)
+		raiseTlsError("Could not create TLS session");
+
+	try {
+		// the socket BIO does not close the handle when freed
+		SSL_set_app_data(ssl, &secrets);
+		if (SSL_set_fd(ssl, sock.handle()) != 1)
+			raiseTlsError("Could not attach socket");
+
+		int rc;
+		if (_role == TLS_CLIENT) {
+			if (!serverName.empty()) {
+				SSL_set_tlsext_host_name(ssl, serverName.c_str());
+				if (_verifyHostName && SSL_set1_host(ssl, serverName.c_str()) != 1)
+					raiseTlsError("Could not set server name to verify");
+			}
+			rc = SSL_connect(ssl);
+		} else {
+			rc = SSL_accept(ssl);
+		}
+		if (rc != 1)
+			raiseTlsError("TLS handshake failed");
+
+		if (secrets.clientLen == 0 || secrets.serverLen == 0)
+			throw SocketException("TLS traffic secrets not available", EPROTO);
+		if (SSL_pending(ssl) > 0 || SSL_has_pending(ssl))
+			throw SocketException("TLS data received before keys were installed", EPROTO);
+
+		const SSL_CIPHER * cipher = SSL_get_current_cipher(ssl);
+		const EVP_MD * md = SSL_CIPHER_get_handshake_digest(cipher);
+		bool aes256 = SSL_CIPHER_get_id(cipher) == TLS1_3_CK_AES_256_GCM_SHA384;
+		if (md == NULL)
+			raiseTlsError("Unknown TLS cipher");
+
+		const unsigned char * tx = _role == TLS_CLIENT ? secrets.client : secrets.server;
+		const unsigned char * rx = _role == TLS_CLIENT ? secrets.server : secrets.client;
+		size_t txLen = _role == TLS_CLIENT ? secrets.clientLen : secrets.serverLen;
+		size_t rxLen = _role == TLS_CLIENT ? secrets.serverLen : secrets.clientLen;
+
+		static const char ulp[] = "tls";
+		if (::setsockopt(sock.handle(), IPPROTO_TCP, TCP_ULP, ulp, sizeof(ulp)) != 0) {
+			if (errno == ENOENT)
+				throw SocketException("Kernel TLS not available, tls module not loaded", ENOENT);
+			SocketException::raiseLastError();
+		}
+		if (aes256) {
+			installKey<tls12_crypto_info_aes_gcm_256>(sock.handle(), TLS_TX,
+					TLS_CIPHER_AES_GCM_256, md, tx, txLen);
+			installKey<tls12_crypto_info_aes_gcm_256>(sock.handle(), TLS_RX,
+					TLS_CIPHER_AES_GCM_256, md, rx, rxLen);
+		} else {
+			installKey<tls12_crypto_info_aes_gcm_128>(sock.handle(), TLS_TX,
+					TLS_CIPHER_AES_GCM_128, md, tx, txLen);
+			installKey<tls12_crypto_info_aes_gcm_128>(sock.handle(), TLS_RX,
+					TLS_CIPHER_AES_GCM_128, md, rx, rxLen);
+		}
+	} catch (...) {
+		SSL_free(ssl);
+		OPENSSL_cleanse(&secrets, sizeof(secrets));
+		throw;
+	}
+	SSL_free(ssl);
+	OPENSSL_cleanse(&secrets, sizeof(secrets));
+#else
+	throw SocketException("Kernel TLS not supported on this platform", 0);
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+bool KernelTls::supported() {
+#if defined(HAVE_OPENSSL) && defined(__linux__) && defined(TLS_1_3_VERSION)
+	// The ULP is only accepted on a connected socket. On an unconnected
+	// one, the kernel looks the ULP up first, failing with ENOENT if the
+	// tls module is not available, and only then refuses it with
+	// ENOTCONN, so ENOTCONN means kTLS is there.
+	SOCKET handle = ::socket(AF_INET, SOCK_STREAM, 0);
+	if (handle < 0) return false;
+	static const char ulp[] = "tls";
+	int rc = ::setsockopt(handle, IPPROTO_TCP, TCP_ULP, ulp, sizeof(ulp));
+	int err = errno;
+	::close(handle);
+	return rc == 0 || err == ENOTCONN;
+#else
+	return false;
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+KernelTls::~KernelTls() {
+#ifdef HAVE_OPENSSL
+	SSL_CTX_free(static_cast<SSL_CTX*> (_ctx));
+#endif
+}
+
+END_NKF_NET
@@ -0,0 +1,154 @@
+/*
+ * KernelTls.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef KERNELTLS_H_
+#define KERNELTLS_H_
+
+#include <string>
+#include "net.h"
+#include "Socket.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * The side of the TLS handshake.
+ */
+enum TlsRole {
+	TLS_CLIENT,		//!< Connects, and verifies the server certificate
+	TLS_SERVER		//!< Accepts, and presents a certificate
+};
+
+/**
+ * KernelTls runs a TLS 1.3 handshake on a connected TCP socket with
+ * OpenSSL, and then hands the session keys to the kernel (kTLS). From
+ * then on the socket is used as before: Socket::send, the vectored
+ * send and Socket::sendFile are encrypted, and receive decrypts, by the
+ * kernel, without going through a TLS library for every call.
+ *
+ * \code
+ * // server, with a self-signed certificate made with:
+ * //   openssl req -x509 -newkey rsa:2048 -nodes -days 365 \
+ * //     -subj /CN=localhost -keyout key.pem -out cert.pem
+ * KernelTls tls(TLS_SERVER);
+ * tls.setCertificate("cert.pem", "key.pem");
+ * Socket * conn = listener.accept();
+ * tls.handshake(*conn);
+ * conn->sendFile(fd, 0, size);
+ *
+ * // client
+ * KernelTls tls(TLS_CLIENT);
+ * tls.setTrustedCertificates("cert.pem");
+ * sock.connect(Address("localhost", 4433));
+ * tls.handshake(sock, "localhost");
+ * sock.send(buf, len);
+ * \endcode
+ *
+ * One KernelTls holds the configuration (certificates, verification) and
+ * can run the handshake for any number of sockets, though not at the
+ * same time from different threads.
+ *
+ * Limitations:
+ * - Only TLS 1.3 with AES-GCM (128 or 256) is offered, as those are the
+ *   ciphers the kernel supports.
+ * - No session tickets are sent, so there are no records left to be
+ *   read by OpenSSL after the handshake.
+ * - The kernel only passes on application data. A KeyUpdate or alert
+ *   from the peer makes receive fail with EIO, after which the
+ *   connection should be closed.
+ *
+ * Requires Linux with the tls module (modprobe tls), see supported(),
+ * and the library built with OpenSSL; else handshake throws a
+ * SocketException.
+ */
+class NKFNET_API KernelTls {
+public:
+	/**
+	 * Creates a new TLS configuration.
+	 *
+	 * \param	role	Whether to act as client or server.
+	 */
+	KernelTls(TlsRole role);
+
+	/**
+	 * Sets the certificate (chain) and private key to present. Required
+	 * for a server.
+	 *
+	 * \param	certFile	A PEM file with the certificate chain.
+	 * \param	keyFile		A PEM file with the private key.
+	 */
+	void	setCertificate(const std::string & certFile, const std::string & keyFile);
+
+	/**
+	 * Sets the certificates to trust, instead of the system defaults. For
+	 * a self-signed certificate, this is the certificate itself.
+	 *
+	 * \param	caFile		A PEM file with one or more certificates.
+	 */
+	void	setTrustedCertificates(const std::string & caFile);
+
+	/**
+	 * Sets whether to verify the peer certificate. A client verifies the
+	 * server by default, a server does not ask for client certificates
+	 * by default.
+	 *
+	 * \param	verify		true to verify, false not to.
+	 */
+	void	setVerifyPeer(bool verify);
+
+	/**
+	 * Sets whether a client checks that the server certificate is for the
+	 * server name passed to handshake(). On by default, and then a client
+	 * which verifies the server must pass a server name. Turning it off
+	 * accepts any certificate signed by a trusted CA, for any host, and
+	 * should only be done when the trusted certificates are those of the
+	 * intended servers alone, e.g. a single self-signed certificate.
+	 *
+	 * \param	verify		true to check the name, false not to.
+	 */
+	void	setVerifyHostName(bool verify);
+
+	/**
+	 * Runs the handshake on a connected, blocking socket, and installs the
+	 * keys in the kernel.
+	 *
+	 * \param	sock		The socket.
+	 * \param	serverName	For a client, the name to verify the server
+	 * 						certificate against, and send as SNI. Required
+	 * 						when verifying the server, unless
+	 * 						setVerifyHostName(false) was called.
+	 */
+	void	handshake(Socket & sock, const std::string & serverName = "");
+
+	/**
+	 * Returns whether the kernel supports TLS offload, i.e. whether the
+	 * tls module is available, and the library was built with OpenSSL.
+	 *
+	 * \return	true if supported.
+	 */
+	static bool	supported();
+
+	virtual ~KernelTls();
+
+private:
+	KernelTls(const KernelTls &);
+
+	KernelTls & operator=(const KernelTls &);
+
+	void *		_ctx;
+
+	TlsRole		_role;
+
+	bool		_verifyPeer;
+
+	bool		_verifyHostName;
+};
+
+END_NKF_NET
+
+#endif /* KERNELTLS_H_ */
@@ -0,0 +1,141 @@
+/*
+ * MpscQueue.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef MPSCQUEUE_H_
+#define MPSCQUEUE_H_
+
+#include <atomic>
+#include "net.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * MpscQueue is an unbounded lock-free queue for many producers and a
+ * single consumer (D. Vyukov's intrusive MPSC queue). Pushing never
+ * blocks and costs one atomic exchange; popping costs no atomic
+ * read-modify-write at all.
+ *
+ * A push which is still in progress may hide the elements pushed after
+ * it from the consumer for a short moment, so the consumer must not rely
+ * on pop() returning an element directly after another thread pushed it,
+ * only that it will eventually. The consumer must be woken by some other
+ * means, e.g. a condition or an event.
+ *
+ * Only push() may be called concurrently, pop() and empty() must only be
+ * called by a single consumer thread at a time.
+ */
+template <typename T>
+class MpscQueue {
+public:
+	/**
+	 * Creates an empty queue.
+	 */
+	MpscQueue() : _head(&_stub), _tail(&_stub) {
+		_stub.next.store(NULL, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Appends a value to the queue. May be called by any thread.
+	 *
+	 * \param	value	The value to append.
+	 */
+	void push(const T & value) {
+		Node * node = new Node();
+		node->value = value;
+		node->next.store(NULL, std::memory_order_relaxed);
+		Node * prev = _head.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	/**
+	 * Removes the value at the front of the queue. Consumer only.
+	 *
+	 * \param	value	Receives the value.
+	 *
+	 * \return			true if a value was removed, false if the queue
+	 * 					is (momentarily) empty.
+	 */
+	bool pop(T & value) {
+		Node * tail = _tail;
+		Node * next = tail->next.load(std::memory_order_acquire);
+		if (tail == &_stub) {
+			if (next == NULL) return false;
+			_tail = next;
+			tail = next;
+			next = next->next.load(std::memory_order_acquire);
+		}
+		if (next != NULL) {
+			_tail = next;
+			value = tail->value;
+			delete tail;
+			return true;
+		}
+		if (tail != _head.load(std::memory_order_acquire)) {
+			return false;	// a push is in progress
+		}
+		// tail is the last node, put the stub behind it so it can be removed
+		push(&_stub);
+		next = tail->next.load(std::memory_order_acquire);
+		if (next != NULL) {
+			_tail = next;
+			value = tail->value;
+			delete tail;
+			return true;
+		}
+		return false;
+	}
+
+	/**
+	 * Returns whether or not the queue is empty. Consumer only.
+	 *
+	 * \return	true if nothing can be popped.
+	 */
+	bool empty() {
+		Node * tail = _tail;
+		Node * next = tail->next.load(std::memory_order_acquire);
+		if (tail == &_stub) return next == NULL && _head.load(std::memory_order_acquire) == &_stub;
+		return false;
+	}
+
+	/**
+	 * Destroys the queue, and any elements left in it.
+	 */
+	~MpscQueue() {
+		T value;
+		while (pop(value)) { }
+	}
+
+private:
+	struct Node {
+		std::atomic<Node*>	next;
+		T					value;
+	};
+
+	void push(Node * node) {
+		node->next.store(NULL, std::memory_order_relaxed);
+		Node * prev = _head.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	MpscQueue(const MpscQueue &);
+
+	MpscQueue & operator=(const MpscQueue &);
+
+	std::atomic<Node*>	_head;
+
+	char				_pad[64 - sizeof(std::atomic<Node*>)];
+
+	Node *				_tail;
+
+	Node				_stub;
+};
+
+END_NKF_NET
+
+#endif /* MPSCQUEUE_H_ */
@@ -0,0 +1,265 @@
+/*
+ * OutputBuffer.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "OutputBuffer.h"
+#include "SocketException.h"
+#include <cstring>
+
+START_NKF_NET
+
+/*
+ * Copied data lives in blocks of at least OUTPUT_BLOCK bytes, a write
+ * fills up the last block before a new one is allocated. '_offset' is the
+ * number of bytes of the first slice which have already been sent.
+ */
+
+static const size_t	OUTPUT_BLOCK = 16 * 1024;
+
+static const size_t	OUTPUT_IOV = 64;		// slices per vectored send
+
+// --------------------------------------------------------------------------
+// OutputBuffer
+// --------------------------------------------------------------------------
+
+OutputBuffer::OutputBuffer(Socket & sock, size_t highWatermark, size_t lowWatermark) :
+	_sock(sock),
+	_offset(0),
+	_queued(0),
+	_written(0),
+	_high(highWatermark),
+	_low(lowWatermark),
+	_throttled(false),
+	_listener(NULL) {
+}
+
+// --------------------------------------------------------------------------
+
+void OutputBuffer::write(const void * buf, size_t len) {
+	const char * data = static_cast<const char*> (buf);
+	if (_slices.empty()) {
+		// nothing queued, try to send right away
+		iovec vec;
+		vec.iov_base = const_cast<char*> (data);
+		vec.iov_len = len;
+		size_t sent;
+		try {
+			sent = send(&vec, 1);
+		} catch (SocketException &) {
+			// the data stays queued, as when flush() fails
+			copy(data, len);
+			checkWatermarks();
+			throw;
+		}
+		_written += sent;
+		data += sent;
+		len -= sent;
+	}
+	if (len > 0) {
+		copy(data, len);
+		checkWatermarks();
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void OutputBuffer::writeRef(const void * buf, size_t len, const Release & release) {
+	const char * data = static_cast<const char*> (buf);
+	if (_slices.empty()) {
+		iovec vec;
+		vec.iov_base = const_cast<char*> (data);
+		vec.iov_len = len;
+		size_t sent;
+		try {
+			sent = send(&vec, 1);
+		} catch (SocketException &) {
+			// the data stays queued, and is released by flush() or clear()
+			reference(data, len, release);
+			throw;
+		}
+		_written += sent;
+		data += sent;
+		len -= sent;
+	}
+	if (len == 0) {
+		if (release) release();
+		return;
+	}
+	reference(data, len, release);
+}
+
+// --------------------------------------------------------------------------
+
+void OutputBuffer::reference(const char * data, size_t len, const Release & release) {
+	Slice slice;
+	slice.data = data;
+	slice.length = len;
+	slice.block = NULL;
+	slice.capacity = 0;
+	slice.release = release;
+	_slices.push_back(slice);
+	_queued += len;
+	checkWatermarks();
+}
+
+// --------------------------------------------------------------------------
+
+void OutputBuffer::copy(const char * data, size_t len) {
+	if (!_slices.empty()) {
+		Slice & last = _slices.back();
+		if (last.block != NULL && last.length < last.capacity) {
+			size_t part = last.capacity - last.length;
+			if (part > len) part = len;
+			memcpy(last.block + last.length, data, part);
+			last.length += part;
+			_queued += part;
+			data += part;
+			len -= part;
+		}
+	}
+	if (len == 0) return;
+
+	Slice slice;
+	slice.capacity = len > OUTPUT_BLOCK ? len : OUTPUT_BLOCK;
+	slice.block = new char[slice.capacity];
+	memcpy(slice.block, data, len);
+	slice.data = slice.block;
+	slice.length = len;
+	_slices.push_back(slice);
+	_queued += len;
+}
+
+// --------------------------------------------------------------------------
+
+bool OutputBuffer::flush() {
+	iovec vec[OUTPUT_IOV];
+
+	while (!_slices.empty()) {
+		size_t count = 0;
+		size_t bytes = 0;
+		std::deque<Slice>::iterator it = _slices.begin();
+		for (; it != _slices.end() && count < OUTPUT_IOV; ++it, ++count) {
+			size_t skip = count == 0 ? _offset : 0;
+			vec[count].iov_base = const_cast<char*> (it->data + skip);
+			vec[count].iov_len = it->length - skip;
+			bytes += it->length - skip;
+		}
+
+		size_t sent = send(vec, count);
+		_written += sent;
+		_queued -= sent;
+
+		size_t done = sent;
+		while (done > 0) {
+			size_t left = _slices.front().length - _offset;
+			if (done < left) {
+				_offset += done;
+				break;
+			}
+			done -= left;
+			_offset = 0;
+			Slice slice = _slices.front();
+			_slices.pop_front();
+			drop(slice);
+		}
+
+		if (sent < bytes) break;	// socket buffer full
+	}
+
+	checkWatermarks();
+	return _slices.empty();
+}
+
+// --------------------------------------------------------------------------
+
+size_t OutputBuffer::send(const iovec * vec, size_t count) {
+	try {
+		return _sock.send(vec, count);
+	} catch (SocketException & se) {
+		if (se.code() == EAGAIN || se.code() == EWOULDBLOCK)
+			return 0;
+		throw;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void OutputBuffer::drop(Slice & slice) {
+	delete [] slice.block;
+	if (slice.release) slice.release();
+}
+
+// --------------------------------------------------------------------------
+
+void OutputBuffer::checkWatermarks() {
+	if (!_throttled && _queued > _high) {
+		_throttled = true;
+		if (_listener != NULL) _listener->highWatermark(*this);
+	} else if (_throttled && _queued <= _low) {
+		_throttled = false;
+		if (_listener != NULL) _listener->lowWatermark(*this);
+	}
+}
+
+// --------------------------------------------------------------------------
+
+bool OutputBuffer::pending() {
+	return !_slices.empty();
+}
+
+// --------------------------------------------------------------------------
+
+size_t OutputBuffer::queued() {
+	return _queued;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long OutputBuffer::written() {
+	return _written;
+}
+
+// --------------------------------------------------------------------------
+
+bool OutputBuffer::throttled() {
+	return _throttled;
+}
+
+// --------------------------------------------------------------------------
+
+void OutputBuffer::setWatermarks(size_t high, size_t low) {
+	_high = high;
+	_low = low;
+	checkWatermarks();
+}
+
+// --------------------------------------------------------------------------
+
+void OutputBuffer::setListener(OutputListener * listener) {
+	_listener = listener;
+}
+
+// --------------------------------------------------------------------------
+
+void OutputBuffer::clear() {
+	std::deque<Slice> slices;
+	slices.swap(_slices);
+	_offset = 0;
+	_queued = 0;
+	for (size_t i = 0; i < slices.size(); ++i) {
+		drop(slices[i]);
+	}
+	checkWatermarks();
+}
+
+// --------------------------------------------------------------------------
+
+OutputBuffer::~OutputBuffer() {
+	_listener = NULL;
+	clear();
+}
+
+END_NKF_NET
@@ -0,0 +1,221 @@
+/*
+ * OutputBuffer.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef OUTPUTBUFFER_H_
+#define OUTPUTBUFFER_H_
+
+#include <deque>
+#include <functional>
+#include "net.h"
+#include "Socket.h"
+
+/** \file */
+
+START_NKF_NET
+
+class OutputBuffer;
+
+/**
+ * Implemented by producers which want to be told when to hold back, see
+ * OutputBuffer::setListener.
+ */
+class NKFNET_API OutputListener {
+public:
+	/**
+	 * Called when the queued bytes rise above the high watermark.
+	 *
+	 * \param	out		The buffer.
+	 */
+	virtual void	highWatermark(OutputBuffer & out) = 0;
+
+	/**
+	 * Called when the queued bytes drop to the low watermark or below,
+	 * after having been above the high watermark.
+	 *
+	 * \param	out		The buffer.
+	 */
+	virtual void	lowWatermark(OutputBuffer & out) = 0;
+
+	virtual ~OutputListener() {}
+};
+
+/**
+ * OutputBuffer is the output stage of a non-blocking TCP connection. It
+ * writes as much as the socket accepts right away, and queues the rest,
+ * to be written with vectored sends when the socket becomes writable.
+ *
+ * Data is either copied, in which case small writes are combined in
+ * blocks, or referenced: the caller keeps the data valid until the
+ * release function is called, so large or shared buffers are not copied.
+ *
+ * \code
+ * OutputBuffer out(conn);
+ * out.write(&header, sizeof(header));			// copied
+ * out.writeRef(frame, frameLen, [frame] { pool.put(frame); });
+ * // in the select loop:
+ * if (out.pending()) write.set(conn);
+ * SocketSet::select(&read, &write, NULL, timeout);
+ * if (write.isSet(conn)) out.flush();
+ * \endcode
+ *
+ * A listener is told when more than the high watermark of bytes is
+ * queued, and again when the queue drains to the low watermark, so
+ * producers can stop and resume. Nothing is ever dropped.
+ *
+ * The socket should be non-blocking. If sending fails with anything
+ * but EAGAIN, the SocketException is passed on and the data stays
+ * queued, also data just passed to write() or writeRef(); clear() or
+ * the destructor drops it. Posix only, not thread safe.
+ */
+class NKFNET_API OutputBuffer {
+public:
+	/**
+	 * A function called when referenced data is no longer needed.
+	 */
+	typedef std::function<void()> Release;
+
+	/**
+	 * Creates a new, empty output buffer.
+	 *
+	 * \param	sock			The (non-blocking) socket to write to.
+	 * \param	highWatermark	Queued bytes above which the listener is told
+	 * 							to hold back.
+	 * \param	lowWatermark	Queued bytes at which the listener is told to
+	 * 							continue.
+	 */
+	OutputBuffer(Socket & sock, size_t highWatermark = 1024 * 1024,
+			size_t lowWatermark = 256 * 1024);
+
+	/**
+	 * Writes a copy of the data.
+	 *
+	 * \param	buf		The data.
+	 * \param	len		The length of the data in bytes.
+	 */
+	void	write(const void * buf, size_t len);
+
+	/**
+	 * Writes data by reference. The data must stay valid and unchanged
+	 * until release is called, which may be right away.
+	 *
+	 * \param	buf		The data.
+	 * \param	len		The length of the data in bytes.
+	 * \param	release	Called once, when the data has been sent, or
+	 * 					dropped by clear() or the destructor, also if
+	 * 					this call threw. May be empty.
+	 */
+	void	writeRef(const void * buf, size_t len, const Release & release = Release());
+
+	/**
+	 * Writes as much of the queued data as the socket accepts. Call when
+	 * the socket is writable.
+	 *
+	 * \return	true if all data was written.
+	 */
+	bool	flush();
+
+	/**
+	 * Returns whether data is queued, i.e. whether to wait for the socket
+	 * to become writable.
+	 *
+	 * \return	true if data is queued.
+	 */
+	bool	pending();
+
+	/**
+	 * Returns the number of bytes queued.
+	 *
+	 * \return	The number of bytes queued.
+	 */
+	size_t	queued();
+
+	/**
+	 * Returns the total number of bytes written to the socket.
+	 *
+	 * \return	The number of bytes written.
+	 */
+	unsigned long long written();
+
+	/**
+	 * Returns whether the queue is above the high watermark, and has not
+	 * yet drained to the low watermark.
+	 *
+	 * \return	true if producers should hold back.
+	 */
+	bool	throttled();
+
+	/**
+	 * Changes the watermarks.
+	 *
+	 * \param	high	Queued bytes above which to hold back.
+	 * \param	low		Queued bytes at which to continue.
+	 */
+	void	setWatermarks(size_t high, size_t low);
+
+	/**
+	 * Sets the listener for watermark events.
+	 *
+	 * \param	listener	The listener, or NULL for none.
+	 */
+	void	setListener(OutputListener * listener);
+
+	/**
+	 * Drops all queued data, calling the release functions of referenced
+	 * data.
+	 */
+	void	clear();
+
+	/**
+	 * Drops all queued data, see clear().
+	 */
+	virtual ~OutputBuffer();
+
+private:
+	struct Slice {
+		const char *	data;
+		size_t			length;
+		char *			block;		// owned copy, or NULL if referenced
+		size_t			capacity;
+		Release			release;
+	};
+
+	size_t	send(const iovec * vec, size_t count);
+
+	void	copy(const char * data, size_t len);
+
+	void	reference(const char * data, size_t len, const Release & release);
+
+	void	drop(Slice & slice);
+
+	void	checkWatermarks();
+
+	OutputBuffer(const OutputBuffer &);
+
+	OutputBuffer & operator=(const OutputBuffer &);
+
+	Socket &			_sock;
+
+	std::deque<Slice>	_slices;
+
+	size_t				_offset;
+
+	size_t				_queued;
+
+	unsigned long long	_written;
+
+	size_t				_high;
+
+	size_t				_low;
+
+	bool				_throttled;
+
+	OutputListener *	_listener;
+};
+
+END_NKF_NET
+
+#endif /* OUTPUTBUFFER_H_ */
@@ -0,0 +1,165 @@
+/*
+ * PacedSender.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "PacedSender.h"
+#include <chrono>
+#include <thread>
+#include <time.h>
+
+START_NKF_NET
+
+/*
+ * The token bucket is kept as a single point in time, '_nextTime': the
+ * moment the bucket is full again if nothing more is sent. A datagram may
+ * go once that moment is less than a burst's worth of time away, after
+ * which the datagram's own transmission time is added.
+ */
+
+static const unsigned long long NANOS = 1000000000ULL;
+
+// With launch times, how far ahead of its launch a datagram is handed to
+// the kernel. Keeps the qdisc queue short, fq drops beyond its flow limit.
+static const unsigned long long PACING_LEAD = 2000000ULL;	// 2 ms
+
+// --------------------------------------------------------------------------
+// PacedSender
+// --------------------------------------------------------------------------
+
+PacedSender::PacedSender(Socket & sock, unsigned long long bytesPerSecond, size_t burst,
+		bool launchTimes) :
+	_sock(sock),
+	_mode(PACING_USER),
+	_kernelRate(false),
+	_rate(0),
+	_burst(burst),
+	_nextTime(0),
+	_delay(0),
+	_delayed(0) {
+	// setting SO_TXTIME succeeds whatever the qdisc, so only the caller
+	// knows whether launch times will be honoured
+	if (launchTimes && _sock.setLaunchTimes(true))
+		_mode = PACING_LAUNCH_TIME;
+	setRate(bytesPerSecond);
+}
+
+// --------------------------------------------------------------------------
+
+size_t PacedSender::send(const void * buf, size_t len, const Address & addr) {
+	unsigned long long rate = _rate.load();
+	if (rate == 0)
+		return _sock.send(buf, len, addr);
+
+	unsigned long long current = now();
+	unsigned long long tolerance = _burst.load() * NANOS / rate;
+
+	if (_nextTime < current) _nextTime = current;
+	unsigned long long launch = current;
+	if (_nextTime > current + tolerance) launch = _nextTime - tolerance;
+	_nextTime += len * NANOS / rate;
+
+	if (launch > current) {
+		_delay += launch - current;
+		++_delayed;
+	}
+
+	if (_mode == PACING_LAUNCH_TIME) {
+		if (launch > current + PACING_LEAD)
+			sleepUntil(launch - PACING_LEAD);
+		return _sock.sendAt(buf, len, addr, launch);
+	}
+
+	if (launch > current)
+		sleepUntil(launch);
+	return _sock.send(buf, len, addr);
+}
+
+// --------------------------------------------------------------------------
+
+void PacedSender::setRate(unsigned long long bytesPerSecond) {
+	_rate.store(bytesPerSecond);
+	_kernelRate.store(_sock.setPacingRate(bytesPerSecond));
+}
+
+// --------------------------------------------------------------------------
+
+void PacedSender::setBurst(size_t bytes) {
+	_burst.store(bytes);
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long PacedSender::rate() {
+	return _rate.load();
+}
+
+// --------------------------------------------------------------------------
+
+size_t PacedSender::burst() {
+	return _burst.load();
+}
+
+// --------------------------------------------------------------------------
+
+PacingMode PacedSender::mode() {
+	return _mode;
+}
+
+// --------------------------------------------------------------------------
+
+bool PacedSender::kernelRate() {
+	return _kernelRate.load();
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long PacedSender::delay() {
+	return _delay.load();
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long PacedSender::delayed() {
+	return _delayed.load();
+}
+
+// --------------------------------------------------------------------------
+
+void PacedSender::resetCounters() {
+	_delay.store(0);
+	_delayed.store(0);
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long PacedSender::now() {
+#ifdef WIN32_API
+	return std::chrono::duration_cast<std::chrono::nanoseconds> (
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+	// must be CLOCK_MONOTONIC, the clock of the launch times
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NANOS + ts.tv_nsec;
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+void PacedSender::sleepUntil(unsigned long long time) {
+#ifdef WIN32_API
+	unsigned long long current = now();
+	if (time > current)
+		std::this_thread::sleep_for(std::chrono::nanoseconds(time - current));
+#else
+	timespec ts;
+	ts.tv_sec = time / NANOS;
+	ts.tv_nsec = time % NANOS;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+#endif
+}
+
+END_NKF_NET
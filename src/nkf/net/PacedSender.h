@@ -0,0 +1,177 @@
+/*
+ * PacedSender.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef PACEDSENDER_H_
+#define PACEDSENDER_H_
+
+#include <atomic>
+#include "net.h"
+#include "Socket.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * How a PacedSender delays datagrams.
+ */
+enum PacingMode {
+	PACING_USER /* < The sending thread sleeps until the launch time */,
+	PACING_LAUNCH_TIME /* < The kernel holds datagrams until their launch time (SO_TXTIME) */
+};
+
+/**
+ * PacedSender spreads UDP datagrams over time at a configured rate, so
+ * bursts do not overrun the receiving host or network card.
+ *
+ * Datagrams are paced with a token bucket: up to burst bytes may be sent
+ * back to back, after that datagrams are spaced to match the rate. By
+ * default the sending thread sleeps until each launch time itself. When
+ * the caller knows a queueing discipline which honours launch times is
+ * configured, and the kernel supports it, each datagram instead gets a
+ * launch time (SO_TXTIME) and the queueing discipline releases it on time,
+ * while the sending thread only sleeps when it runs more than a few
+ * milliseconds ahead. The rate is also passed to the kernel as the maximum
+ * pacing rate of the socket.
+ *
+ * \code
+ * Socket s(UDP);
+ * PacedSender pacer(s, 1000000000ULL, 256 * 1024);	// 8 Gb/s
+ * for (size_t i = 0; i < fragments; ++i) {
+ *   pacer.send(frag[i].data, frag[i].len, storage[i % nodes]);
+ * }
+ * cout << "Added " << pacer.delay() / 1000 << " us of delay" << endl;
+ * \endcode
+ *
+ * Launch times require the fq (or etf) queueing discipline on the
+ * outgoing interface, e.g. 'tc qdisc replace dev eth0 root fq'. The kernel
+ * accepts SO_TXTIME whatever the queueing discipline, but without fq or etf
+ * launch times are ignored and datagrams go out in bursts, which is why
+ * they are only used when asked for.
+ *
+ * send() must be called from one thread at a time. The rate and burst
+ * may be changed from any thread.
+ */
+class NKFNET_API PacedSender {
+public:
+	/**
+	 * Creates a new paced sender.
+	 *
+	 * \param	sock			The UDP socket to send on.
+	 * \param	bytesPerSecond	The rate, or 0 for no pacing.
+	 * \param	burst			The number of bytes which may be sent back to
+	 * 							back.
+	 * \param	launchTimes		true if fq or etf is configured on the
+	 * 							outgoing interface, to let the kernel hold
+	 * 							datagrams until their launch time where
+	 * 							supported, see mode().
+	 */
+	PacedSender(Socket & sock, unsigned long long bytesPerSecond, size_t burst = 64 * 1024,
+			bool launchTimes = false);
+
+	/**
+	 * Sends a datagram, delayed as needed to keep to the rate.
+	 *
+	 * \param	buf		The buffer to send.
+	 * \param	len		The length of the buffer in bytes.
+	 * \param	addr	The address to send the data to.
+	 *
+	 * \return			The number of bytes send.
+	 */
+	size_t	send(const void * buf, size_t len, const Address & addr);
+
+	/**
+	 * Changes the rate.
+	 *
+	 * \param	bytesPerSecond	The rate, or 0 for no pacing.
+	 */
+	void	setRate(unsigned long long bytesPerSecond);
+
+	/**
+	 * Changes the burst size.
+	 *
+	 * \param	bytes	The number of bytes which may be sent back to back.
+	 */
+	void	setBurst(size_t bytes);
+
+	/**
+	 * Returns the rate.
+	 *
+	 * \return	The rate in bytes per second, 0 if not pacing.
+	 */
+	unsigned long long rate();
+
+	/**
+	 * Returns the burst size.
+	 *
+	 * \return	The burst size in bytes.
+	 */
+	size_t	burst();
+
+	/**
+	 * Returns how datagrams are delayed.
+	 *
+	 * \return	The pacing mode.
+	 */
+	PacingMode mode();
+
+	/**
+	 * Returns whether the kernel accepted the rate as the maximum pacing
+	 * rate of the socket (SO_MAX_PACING_RATE).
+	 *
+	 * \return	true if the kernel also limits the rate.
+	 */
+	bool	kernelRate();
+
+	/**
+	 * Returns the total delay added to datagrams by pacing.
+	 *
+	 * \return	The delay in nanoseconds.
+	 */
+	unsigned long long delay();
+
+	/**
+	 * Returns the number of datagrams which were delayed.
+	 *
+	 * \return	The number of datagrams.
+	 */
+	unsigned long delayed();
+
+	/**
+	 * Sets the delay counters back to 0.
+	 */
+	void	resetCounters();
+
+private:
+	static unsigned long long now();
+
+	static void	sleepUntil(unsigned long long time);
+
+	PacedSender(const PacedSender &);
+
+	PacedSender & operator=(const PacedSender &);
+
+	Socket &						_sock;
+
+	PacingMode						_mode;
+
+	std::atomic<bool>				_kernelRate;
+
+	std::atomic<unsigned long long>	_rate;
+
+	std::atomic<size_t>				_burst;
+
+	unsigned long long				_nextTime;
+
+	std::atomic<unsigned long long>	_delay;
+
+	std::atomic<unsigned long>		_delayed;
+};
+
+END_NKF_NET
+
+#endif /* PACEDSENDER_H_ */
@@ -0,0 +1,441 @@
+/*
+ * PerfCounters.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "PerfCounters.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+START_NKF_NET
+
+/*
+ * Every thread has a PerfThread, made when it first enters a region, with
+ * its own perf event group and its own sums per region. A group is read
+ * in one system call; values the group does not have are read from the
+ * thread CPU clock and getrusage. The sums of a thread are guarded by its
+ * own lock, so report() can read them while the thread runs, and are
+ * moved to 'retired' when the thread ends.
+ *
+ * Regions are looked up by the address of their name; report() merges
+ * regions with the same name.
+ */
+
+enum Value { WALL, CPU, CYCLES, INSTRUCTIONS, CACHE_MISSES, CONTEXT_SWITCHES, PAGE_FAULTS };
+
+enum Mode { MODE_NONE, MODE_HARDWARE, MODE_HARDWARE_USER, MODE_SOFTWARE, MODE_SOFTWARE_USER, MODE_CLOCK };
+
+static const char *		MODE_NAMES[] = {
+	"none", "hardware", "hardware, user only", "software", "software, user only", "clock"
+};
+
+static const size_t		MAX_EVENTS = 6;
+
+static std::atomic<int>	currentMode(MODE_NONE);
+
+std::atomic<bool>		PerfCounters::_enabled(false);
+
+// --------------------------------------------------------------------------
+
+static void accumulate(PerfStats & to, const PerfStats & from) {
+	to.calls += from.calls;
+	to.bytes += from.bytes;
+	to.nanoseconds += from.nanoseconds;
+	to.cpuNanoseconds += from.cpuNanoseconds;
+	to.cycles += from.cycles;
+	to.instructions += from.instructions;
+	to.cacheMisses += from.cacheMisses;
+	to.contextSwitches += from.contextSwitches;
+	to.pageFaults += from.pageFaults;
+}
+
+// --------------------------------------------------------------------------
+
+static void merge(std::vector<PerfStats> & into, const std::string & name, const PerfStats & stats) {
+	for (size_t i = 0; i < into.size(); ++i) {
+		if (into[i].name == name) {
+			accumulate(into[i], stats);
+			return;
+		}
+	}
+	into.push_back(stats);
+	into.back().name = name;
+}
+
+// --------------------------------------------------------------------------
+
+static PerfStats emptyStats() {
+	PerfStats stats;
+	stats.calls = 0;
+	stats.bytes = 0;
+	stats.nanoseconds = 0;
+	stats.cpuNanoseconds = 0;
+	stats.cycles = 0;
+	stats.instructions = 0;
+	stats.cacheMisses = 0;
+	stats.contextSwitches = 0;
+	stats.pageFaults = 0;
+	return stats;
+}
+
+// --------------------------------------------------------------------------
+
+#ifdef __linux__
+
+static int openEvent(uint32_t type, uint64_t config, bool kernel, int group) {
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.read_format = PERF_FORMAT_GROUP;
+	attr.exclude_kernel = kernel ? 0 : 1;
+	attr.exclude_hv = 1;
+	return static_cast<int> (::syscall(__NR_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC));
+}
+
+#endif
+
+// --------------------------------------------------------------------------
+// PerfThread
+// --------------------------------------------------------------------------
+
+struct PerfRegionSums {
+	const char *	name;
+	PerfStats		stats;
+};
+
+class PerfThread {
+public:
+	PerfThread() : _leader(-1), _last(0) {
+		for (int i = 0; i < PerfRegion::VALUES; ++i) {
+			_slot[i] = -1;
+		}
+		_mode = MODE_CLOCK;
+		if (open(true, true)) _mode = MODE_HARDWARE;
+		else if (open(true, false)) _mode = MODE_HARDWARE_USER;
+		else if (open(false, true)) _mode = MODE_SOFTWARE;
+		else if (open(false, false)) _mode = MODE_SOFTWARE_USER;
+		currentMode.store(_mode);
+	}
+
+	void read(unsigned long long * values) {
+		for (int i = 0; i < PerfRegion::VALUES; ++i) {
+			values[i] = 0;
+		}
+		values[WALL] = std::chrono::duration_cast<std::chrono::nanoseconds> (
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+#ifdef __linux__
+		if (_leader >= 0) {
+			uint64_t group[1 + MAX_EVENTS];
+			if (::read(_leader, group, sizeof(group)) > 0) {
+				for (int i = 0; i < PerfRegion::VALUES; ++i) {
+					if (_slot[i] >= 0) values[i] = group[1 + _slot[i]];
+				}
+			}
+		}
+		if (_slot[CPU] < 0) {
+			timespec ts;
+			if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+				values[CPU] = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+		}
+		if (_slot[CONTEXT_SWITCHES] < 0 || _slot[PAGE_FAULTS] < 0) {
+			rusage usage;
+			if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+				if (_slot[CONTEXT_SWITCHES] < 0)
+					values[CONTEXT_SWITCHES] = usage.ru_nvcsw + usage.ru_nivcsw;
+				if (_slot[PAGE_FAULTS] < 0)
+					values[PAGE_FAULTS] = usage.ru_minflt + usage.ru_majflt;
+			}
+		}
+#endif
+	}
+
+	PerfStats & region(const char * name) {
+		if (_last < _regions.size() && _regions[_last].name == name)
+			return _regions[_last].stats;
+		for (_last = 0; _last < _regions.size(); ++_last) {
+			if (_regions[_last].name == name) return _regions[_last].stats;
+		}
+		PerfRegionSums sums;
+		sums.name = name;
+		sums.stats = emptyStats();
+		_regions.push_back(sums);
+		return _regions[_last].stats;
+	}
+
+	void report(std::vector<PerfStats> & into) {
+		std::lock_guard<std::mutex> lock(_lock);
+		for (size_t i = 0; i < _regions.size(); ++i) {
+			merge(into, _regions[i].name, _regions[i].stats);
+		}
+	}
+
+	void reset() {
+		std::lock_guard<std::mutex> lock(_lock);
+		_regions.clear();
+		_last = 0;
+	}
+
+	std::mutex & lock() {
+		return _lock;
+	}
+
+	~PerfThread() {
+#ifdef __linux__
+		for (size_t i = 0; i < _fds.size(); ++i) {
+			::close(_fds[i]);
+		}
+#endif
+	}
+
+private:
+	bool open(bool hardware, bool kernel) {
+#ifdef __linux__
+		struct Event {
+			uint32_t	type;
+			uint64_t	config;
+			Value		value;
+		};
+		static const Event hardwareEvents[] = {
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, CYCLES },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, INSTRUCTIONS },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, CACHE_MISSES },
+			{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, CPU },
+			{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, CONTEXT_SWITCHES },
+			{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, PAGE_FAULTS }
+		};
+		static const Event softwareEvents[] = {
+			{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, CPU },
+			{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, CONTEXT_SWITCHES },
+			{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, PAGE_FAULTS }
+		};
+		const Event * events = hardware ? hardwareEvents : softwareEvents;
+		size_t count = hardware ? 6 : 3;
+
+		// the first event leads the group, the others are optional
+		for (size_t i = 0; i < count; ++i) {
+			// context switches happen in the kernel, so user only counts none
+			if (events[i].value == CONTEXT_SWITCHES && !kernel) continue;
+			int fd = openEvent(events[i].type, events[i].config, kernel, _leader);
+			if (fd < 0) {
+				if (i == 0) return false;
+				continue;
+			}
+			if (i == 0) _leader = fd;
+			_slot[events[i].value] = static_cast<int> (_fds.size());
+			_fds.push_back(fd);
+		}
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	int							_mode;
+
+	int							_leader;
+
+	std::vector<int>			_fds;
+
+	int							_slot[PerfRegion::VALUES];	// index in the group
+
+	std::mutex					_lock;
+
+	std::vector<PerfRegionSums>	_regions;
+
+	size_t						_last;
+};
+
+// --------------------------------------------------------------------------
+
+static std::mutex & registryLock() {
+	static std::mutex lock;
+	return lock;
+}
+
+// --------------------------------------------------------------------------
+
+static std::vector<PerfThread *> & threads() {
+	static std::vector<PerfThread *> list;
+	return list;
+}
+
+// --------------------------------------------------------------------------
+
+static std::vector<PerfStats> & retired() {
+	static std::vector<PerfStats> stats;
+	return stats;
+}
+
+// --------------------------------------------------------------------------
+
+struct PerfThreadHolder {
+	PerfThreadHolder() : thread(NULL) {
+	}
+
+	~PerfThreadHolder() {
+		if (thread == NULL) return;
+		std::lock_guard<std::mutex> lock(registryLock());
+		std::vector<PerfThread *> & list = threads();
+		list.erase(std::find(list.begin(), list.end(), thread));
+		thread->report(retired());
+		delete thread;
+	}
+
+	PerfThread *	thread;
+};
+
+static thread_local PerfThreadHolder current;
+
+// --------------------------------------------------------------------------
+
+static PerfThread * currentThread() {
+	if (current.thread == NULL) {
+		PerfThread * thread = new PerfThread();
+		std::lock_guard<std::mutex> lock(registryLock());
+		threads().push_back(thread);
+		current.thread = thread;
+	}
+	return current.thread;
+}
+
+// --------------------------------------------------------------------------
+
+static bool moreTime(const PerfStats & a, const PerfStats & b) {
+	return a.nanoseconds > b.nanoseconds;
+}
+
+// --------------------------------------------------------------------------
+// PerfCounters
+// --------------------------------------------------------------------------
+
+void PerfCounters::enable(bool enable) {
+	_enabled.store(enable);
+}
+
+// --------------------------------------------------------------------------
+
+const char * PerfCounters::mode() {
+	return MODE_NAMES[currentMode.load()];
+}
+
+// --------------------------------------------------------------------------
+
+std::vector<PerfStats> PerfCounters::report() {
+	std::lock_guard<std::mutex> lock(registryLock());
+	std::vector<PerfStats> stats = retired();
+	std::vector<PerfThread *> & list = threads();
+	for (size_t i = 0; i < list.size(); ++i) {
+		list[i]->report(stats);
+	}
+	std::stable_sort(stats.begin(), stats.end(), moreTime);
+	return stats;
+}
+
+// --------------------------------------------------------------------------
+
+std::vector<PerfStats> PerfCounters::threadReport() {
+	std::vector<PerfStats> stats;
+	if (current.thread != NULL) current.thread->report(stats);
+	std::stable_sort(stats.begin(), stats.end(), moreTime);
+	return stats;
+}
+
+// --------------------------------------------------------------------------
+
+void PerfCounters::print(std::ostream & out) {
+	std::vector<PerfStats> stats = report();
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+
+	out << "counters: " << mode() << std::endl;
+	out << std::left << std::setw(24) << "region" << std::right
+			<< std::setw(10) << "calls"
+			<< std::setw(12) << "ns/call"
+			<< std::setw(12) << "cpu ns/call"
+			<< std::setw(12) << "cycles/call"
+			<< std::setw(12) << "instr/call"
+			<< std::setw(6) << "IPC"
+			<< std::setw(12) << "misses/call"
+			<< std::setw(10) << "cs/call"
+			<< std::setw(12) << "faults/call"
+			<< std::setw(12) << "instr/byte" << std::endl;
+	out << std::fixed;
+	for (size_t i = 0; i < stats.size(); ++i) {
+		const PerfStats & s = stats[i];
+		double calls = s.calls > 0 ? static_cast<double> (s.calls) : 1;
+		out << std::left << std::setw(24) << s.name << std::right
+				<< std::setw(10) << s.calls << std::setprecision(0)
+				<< std::setw(12) << s.nanoseconds / calls
+				<< std::setw(12) << s.cpuNanoseconds / calls
+				<< std::setw(12) << s.cycles / calls
+				<< std::setw(12) << s.instructions / calls << std::setprecision(2)
+				<< std::setw(6) << (s.cycles > 0 ? static_cast<double> (s.instructions) / s.cycles : 0)
+				<< std::setw(12) << s.cacheMisses / calls
+				<< std::setw(10) << s.contextSwitches / calls
+				<< std::setw(12) << s.pageFaults / calls
+				<< std::setw(12) << (s.bytes > 0 ? static_cast<double> (s.instructions) / s.bytes : 0)
+				<< std::endl;
+	}
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+// --------------------------------------------------------------------------
+
+void PerfCounters::reset() {
+	std::lock_guard<std::mutex> lock(registryLock());
+	retired().clear();
+	std::vector<PerfThread *> & list = threads();
+	for (size_t i = 0; i < list.size(); ++i) {
+		list[i]->reset();
+	}
+}
+
+// --------------------------------------------------------------------------
+// PerfRegion
+// --------------------------------------------------------------------------
+
+void PerfRegion::begin(const char * name) {
+	PerfThread * thread = currentThread();
+	_name = name;
+	_thread = thread;
+	thread->read(_start);
+}
+
+// --------------------------------------------------------------------------
+
+void PerfRegion::end() {
+	PerfThread * thread = static_cast<PerfThread*> (_thread);
+	unsigned long long now[VALUES];
+	thread->read(now);
+
+	std::lock_guard<std::mutex> lock(thread->lock());
+	PerfStats & s = thread->region(_name);
+	++s.calls;
+	s.bytes += _bytes;
+	s.nanoseconds += now[WALL] - _start[WALL];
+	s.cpuNanoseconds += now[CPU] - _start[CPU];
+	s.cycles += now[CYCLES] - _start[CYCLES];
+	s.instructions += now[INSTRUCTIONS] - _start[INSTRUCTIONS];
+	s.cacheMisses += now[CACHE_MISSES] - _start[CACHE_MISSES];
+	s.contextSwitches += now[CONTEXT_SWITCHES] - _start[CONTEXT_SWITCHES];
+	s.pageFaults += now[PAGE_FAULTS] - _start[PAGE_FAULTS];
+}
+
+END_NKF_NET
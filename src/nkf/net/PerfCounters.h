@@ -0,0 +1,213 @@
+/*
+ * PerfCounters.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef PERFCOUNTERS_H_
+#define PERFCOUNTERS_H_
+
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "net.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * The counters of a region, summed over all times it ran, see
+ * PerfCounters::report. Counters which are not available are 0.
+ */
+struct NKFNET_API PerfStats {
+	/** The name of the region. */
+	std::string			name;
+	/** The number of times the region ran. */
+	unsigned long long	calls;
+	/** The number of bytes handled, as given to PerfRegion::bytes. */
+	unsigned long long	bytes;
+	/** The elapsed time in nanoseconds. */
+	unsigned long long	nanoseconds;
+	/** The CPU time of the thread in nanoseconds. */
+	unsigned long long	cpuNanoseconds;
+	/** The number of CPU cycles, hardware counters only. */
+	unsigned long long	cycles;
+	/** The number of instructions, hardware counters only. */
+	unsigned long long	instructions;
+	/** The number of last level cache misses, hardware counters only. */
+	unsigned long long	cacheMisses;
+	/** The number of context switches, voluntary or not. */
+	unsigned long long	contextSwitches;
+	/** The number of page faults. */
+	unsigned long long	pageFaults;
+};
+
+/**
+ * PerfCounters measures what regions of code cost, in cycles,
+ * instructions, cache misses and context switches, using the performance
+ * counters of the processor through perf_event_open. It is off by
+ * default; when off, a region costs a test of a flag.
+ *
+ * Regions are marked with a PerfRegion, or the NKF_PERF_REGION macro.
+ * Socket::send, Socket::receive and SocketSet::select are marked in the
+ * library. Every thread opens its own counters when it first enters a
+ * region, and sums the counters of each region itself; report() adds up
+ * all threads, including those which have ended.
+ *
+ * \code
+ * PerfCounters::enable(true);
+ * for (...) {
+ *     NKF_PERF_REGION("decode");
+ *     decode(buf, len);
+ * }
+ * PerfCounters::print(std::cout);
+ * \endcode
+ *
+ * Which counters are used depends on what the system allows, see mode():
+ * the hardware counters, counting kernel time too if permitted (the
+ * kernel.perf_event_paranoid sysctl at 1 or lower), else the software
+ * counters of the kernel (virtual machines often have no hardware
+ * counters), else clocks and getrusage. Reading the counters takes a
+ * system call at the start and the end of a region, which is included in
+ * what is measured; nested regions are counted in both.
+ */
+class NKFNET_API PerfCounters {
+public:
+	/**
+	 * Turns measuring on or off, for all threads.
+	 *
+	 * \param	enable		true to measure.
+	 */
+	static void enable(bool enable);
+
+	/**
+	 * Checks whether measuring is on.
+	 *
+	 * \return	true when measuring.
+	 */
+	static bool enabled() {
+		return _enabled.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Returns the counters in use by the threads measured so far:
+	 * "hardware", "hardware, user only", "software", "software, user only"
+	 * or "clock", or "none" before any region has run.
+	 *
+	 * \return	The name of the mode.
+	 */
+	static const char * mode();
+
+	/**
+	 * Returns the counters of all regions, summed over all threads, with
+	 * the most time first.
+	 *
+	 * \return	The counters per region.
+	 */
+	static std::vector<PerfStats> report();
+
+	/**
+	 * Returns the counters of all regions, for the calling thread only.
+	 *
+	 * \return	The counters per region.
+	 */
+	static std::vector<PerfStats> threadReport();
+
+	/**
+	 * Prints report() as a table, with the counters per call, instructions
+	 * per cycle, and instructions per byte.
+	 *
+	 * \param	out		The stream to print to.
+	 */
+	static void print(std::ostream & out);
+
+	/**
+	 * Clears the counters of all regions.
+	 */
+	static void reset();
+
+private:
+	PerfCounters();
+
+	static std::atomic<bool>	_enabled;
+};
+
+/**
+ * PerfRegion measures the scope it lives in, when PerfCounters is
+ * enabled.
+ *
+ * \code
+ * size_t Reader::read(void * buf, size_t len) {
+ *     PerfRegion perf("Reader::read");
+ *     ...
+ *     return perf.bytes(got);
+ * }
+ * \endcode
+ */
+class NKFNET_API PerfRegion {
+public:
+	/**
+	 * Starts measuring.
+	 *
+	 * \param	name	The name of the region, which must stay valid, e.g.
+	 * 					a string literal.
+	 */
+	explicit PerfRegion(const char * name) : _thread(NULL), _bytes(0) {
+		if (PerfCounters::enabled()) begin(name);
+	}
+
+	/**
+	 * Adds to the number of bytes handled in the region.
+	 *
+	 * \param	count	The number of bytes.
+	 *
+	 * \return			count
+	 */
+	size_t	bytes(size_t count) {
+		_bytes += count;
+		return count;
+	}
+
+	/**
+	 * Stops measuring, and adds to the counters of the region.
+	 */
+	~PerfRegion() {
+		if (_thread != NULL) end();
+	}
+
+	/** The number of values read at the start and end of a region. */
+	static const int VALUES = 7;
+
+private:
+	void	begin(const char * name);
+
+	void	end();
+
+	PerfRegion(const PerfRegion &);
+
+	PerfRegion & operator=(const PerfRegion &);
+
+	void *				_thread;
+
+	const char *		_name;
+
+	size_t				_bytes;
+
+	unsigned long long	_start[VALUES];
+};
+
+#define NKF_PERF_CONCAT2(a, b)	a ## b
+#define NKF_PERF_CONCAT(a, b)	NKF_PERF_CONCAT2(a, b)
+
+/**
+ * Measures the rest of the enclosing scope as a region, see PerfRegion.
+ */
+#define NKF_PERF_REGION(name)	\
+	nkf::net::PerfRegion NKF_PERF_CONCAT(nkfPerfRegion, __LINE__)(name)
+
+END_NKF_NET
+
+#endif /* PERFCOUNTERS_H_ */
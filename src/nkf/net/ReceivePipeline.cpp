@@ -0,0 +1,376 @@
+/*
+ * ReceivePipeline.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "ReceivePipeline.h"
+#include "SocketSet.h"
+
+START_NKF_NET
+
+/*
+ * Buffer life cycle: the network thread always owns one spare buffer to
+ * receive in. A received buffer is pushed into the ring of its worker, and
+ * a new spare is taken from the free ring of any worker. Workers return
+ * handled buffers to their own free ring. There are enough buffers to fill
+ * every ring, have every worker busy, and still have some left, so a free
+ * buffer is always available somewhere.
+ */
+
+// --------------------------------------------------------------------------
+// PipelineMessage
+// --------------------------------------------------------------------------
+
+PipelineMessage::PipelineMessage(size_t capacity) :
+	socket(NULL),
+	source(Address::ANY),
+	length(0),
+	data(new char[capacity]) {
+}
+
+// --------------------------------------------------------------------------
+
+PipelineMessage::~PipelineMessage() {
+	delete [] data;
+}
+
+// --------------------------------------------------------------------------
+// ReceivePipeline
+// --------------------------------------------------------------------------
+
+ReceivePipeline::Worker::Worker(size_t ringSize, size_t buffers) :
+	ring(ringSize),
+	free(buffers),
+	sleeping(false),
+	handled(0) {
+}
+
+// --------------------------------------------------------------------------
+
+ReceivePipeline::ReceivePipeline(PipelineHandler & handler, size_t workers, size_t ringSize,
+		size_t maxMessage) :
+	_handler(handler),
+	_spare(NULL),
+	_maxMessage(maxMessage),
+	_next(0),
+	_policy(DROP_NEWEST),
+	_distribution(BY_SOURCE),
+	_running(false),
+	_workersRunning(false),
+	_received(0),
+	_dropped(0),
+	_errors(0),
+	_failure(NULL) {
+
+	if (workers == 0)
+		throw SocketException("A pipeline needs at least one worker", EINVAL);
+
+	size_t perWorker = SpscRing<PipelineMessage*>(ringSize).capacity() + 2;
+	size_t total = workers * perWorker + 1;
+
+	for (size_t i = 0; i < workers; ++i) {
+		Worker * w = new Worker(ringSize, total);
+		_workers.push_back(w);
+		for (size_t j = 0; j < perWorker; ++j) {
+			PipelineMessage * msg = new PipelineMessage(maxMessage);
+			_buffers.push_back(msg);
+			w->free.push(msg);
+		}
+	}
+	_spare = new PipelineMessage(maxMessage);
+	_buffers.push_back(_spare);
+}
+
+// --------------------------------------------------------------------------
+
+void ReceivePipeline::add(Socket & sock) {
+	// fail here rather than in the network thread
+	SocketSet check;
+	check.set(sock);
+
+	Source source;
+	source.socket = &sock;
+	source.stream = sock.getIntOption(SO_TYPE) == SOCK_STREAM;
+	source.closed = false;
+	_sources.push_back(source);
+}
+
+// --------------------------------------------------------------------------
+
+void ReceivePipeline::setOverflowPolicy(OverflowPolicy policy) {
+	_policy.store(policy);
+}
+
+// --------------------------------------------------------------------------
+
+void ReceivePipeline::setDistribution(Distribution distribution) {
+	_distribution = distribution;
+}
+
+// --------------------------------------------------------------------------
+
+void ReceivePipeline::start() {
+	if (_running.load()) return;
+	_running.store(true);
+	_workersRunning.store(true);
+	for (size_t i = 0; i < _workers.size(); ++i) {
+		_workers[i]->thread = std::thread(&ReceivePipeline::runWorker, this, i);
+	}
+	_network = std::thread(&ReceivePipeline::runNetwork, this);
+}
+
+// --------------------------------------------------------------------------
+
+void ReceivePipeline::stop() {
+	if (!_network.joinable()) return;
+	_running.store(false);
+	_wakeup.wake();
+	_network.join();
+
+	_workersRunning.store(false);
+	for (size_t i = 0; i < _workers.size(); ++i) {
+		wake(*_workers[i]);
+		_workers[i]->thread.join();
+	}
+
+	if (_failure != NULL) {
+		SocketException failure(*_failure);
+		delete _failure;
+		_failure = NULL;
+		throw failure;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void ReceivePipeline::runNetwork() {
+	try {
+		receiveAll();
+	} catch (SocketException & se) {
+		// an exception must not leave the thread, stop() reports it
+		++_errors;
+		_failure = new SocketException(se);
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void ReceivePipeline::receiveAll() {
+	SocketSet master, work;
+	master.set(_wakeup.handle());
+	for (size_t i = 0; i < _sources.size(); ++i) {
+		master.set(*_sources[i].socket);
+	}
+
+	while (_running.load()) {
+		work = master;
+		try {
+			if (SocketSet::select(&work, NULL, NULL, FOREVER) <= 0) continue;
+		} catch (SocketException & se) {
+			if (se.code() == EINTR) continue;	// a signal was handled
+			throw;
+		}
+		if (work.isSet(_wakeup.handle())) _wakeup.clear();
+
+		bool closed = false;
+		for (size_t i = 0; i < _sources.size(); ++i) {
+			Source & source = _sources[i];
+			if (source.closed || !work.isSet(*source.socket)) continue;
+			if (receive(source)) {
+				dispatch();
+			}
+			closed |= source.closed;
+		}
+
+		if (closed) {
+			master.zero();
+			master.set(_wakeup.handle());
+			for (size_t i = 0; i < _sources.size(); ++i) {
+				if (!_sources[i].closed) master.set(*_sources[i].socket);
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+
+bool ReceivePipeline::receive(Source & source) {
+	PipelineMessage & msg = *_spare;
+	try {
+		if (source.stream) {
+			msg.length = source.socket->receive(msg.data, _maxMessage);
+			if (msg.length == 0) {
+				source.closed = true;	// end of stream
+				return false;
+			}
+			msg.source = source.socket->remoteAddress();
+		} else {
+			msg.length = source.socket->receive(msg.data, _maxMessage, &msg.source);
+		}
+	} catch (const SocketException &) {
+		++_errors;
+		return false;
+	}
+	msg.socket = source.socket;
+	++_received;
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+void ReceivePipeline::dispatch() {
+	Worker & w = *_workers[select(*_spare)];
+
+	if (!w.ring.push(_spare)) {
+		switch (_policy.load()) {
+		case DROP_NEWEST:
+			++_dropped;
+			return;		// keep the spare, overwrite it next time
+		case DROP_OLDEST: {
+			PipelineMessage * oldest;
+			if (w.ring.stealOldest(oldest)) {
+				++_dropped;
+				w.ring.push(_spare);
+				_spare = oldest;
+				wake(w);
+				return;
+			}
+			// the worker emptied the ring meanwhile
+			w.ring.push(_spare);
+			break;
+		}
+		case BLOCK:
+		default:
+			while (!w.ring.push(_spare)) {
+				wake(w);
+				if (!_running.load()) {
+					++_dropped;
+					return;
+				}
+				std::this_thread::yield();
+			}
+			break;
+		}
+	}
+	wake(w);
+
+	// find a new spare, preferably where the buffer went
+	PipelineMessage * spare = NULL;
+	while (!w.free.pop(spare)) {
+		bool found = false;
+		for (size_t i = 0; i < _workers.size() && !found; ++i) {
+			found = _workers[i]->free.pop(spare);
+		}
+		if (found) break;
+		std::this_thread::yield();
+	}
+	_spare = spare;
+}
+
+// --------------------------------------------------------------------------
+
+size_t ReceivePipeline::select(PipelineMessage & msg) {
+	size_t count = _workers.size();
+	switch (_distribution) {
+	case BY_SOCKET:
+		return static_cast<size_t> (msg.socket->handle()) % count;
+	case ROUND_ROBIN:
+		return _next++ % count;
+	case BY_SOURCE:
+	default:
+		if (msg.source.isUnix()) {
+			std::string path = msg.source.path();
+			size_t hash = 0;
+			for (size_t i = 0; i < path.length(); ++i) hash = hash * 31 + path[i];
+			return hash % count;
+		}
+		return ((msg.source.ip4addr() * 2654435761UL) ^ msg.source.port()) % count;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void ReceivePipeline::wake(Worker & worker) {
+	// pairs with the fence in runWorker(), so either we see it sleeping or
+	// it sees the message
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (worker.sleeping.load()) {
+		std::lock_guard<std::mutex> guard(worker.lock);
+		worker.wake.notify_one();
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void ReceivePipeline::runWorker(size_t index) {
+	Worker & w = *_workers[index];
+	PipelineMessage * msg;
+
+	while (true) {
+		if (w.ring.pop(msg)) {
+			_handler.handle(index, *msg);
+			w.free.push(msg);
+			++w.handled;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(w.lock);
+		w.sleeping.store(true);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		while (w.ring.size() == 0 && _workersRunning.load()) {
+			w.wake.wait(lock);
+		}
+		w.sleeping.store(false);
+		if (w.ring.size() == 0 && !_workersRunning.load()) break;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long ReceivePipeline::received() {
+	return _received.load();
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long ReceivePipeline::dropped() {
+	return _dropped.load();
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long ReceivePipeline::errors() {
+	return _errors.load();
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long ReceivePipeline::handled(size_t worker) {
+	return _workers.at(worker)->handled.load();
+}
+
+// --------------------------------------------------------------------------
+
+size_t ReceivePipeline::queued(size_t worker) {
+	return _workers.at(worker)->ring.size();
+}
+
+// --------------------------------------------------------------------------
+
+ReceivePipeline::~ReceivePipeline() {
+	try {
+		stop();
+	} catch (SocketException &) {
+		// nobody left to tell
+	}
+	for (size_t i = 0; i < _workers.size(); ++i) {
+		delete _workers[i];
+	}
+	for (size_t i = 0; i < _buffers.size(); ++i) {
+		delete _buffers[i];
+	}
+}
+
+END_NKF_NET
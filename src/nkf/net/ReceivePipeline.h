@@ -0,0 +1,278 @@
+/*
+ * ReceivePipeline.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef RECEIVEPIPELINE_H_
+#define RECEIVEPIPELINE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "net.h"
+#include "Socket.h"
+#include "SocketException.h"
+#include "SpscRing.h"
+#include "Wakeup.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * What a ReceivePipeline does with a message for a worker whose ring is
+ * full.
+ */
+enum OverflowPolicy {
+	DROP_NEWEST /* < Drop the message just received */,
+	DROP_OLDEST /* < Drop the oldest message waiting for the worker */,
+	BLOCK /* < Stop receiving until the worker catches up */
+};
+
+/**
+ * How a ReceivePipeline chooses the worker for a message. Messages with the
+ * same key are handled by the same worker, in the order received.
+ */
+enum Distribution {
+	BY_SOURCE /* < By source address */,
+	BY_SOCKET /* < By socket received on */,
+	ROUND_ROBIN /* < Evenly, without ordering guarantees */
+};
+
+/**
+ * A message received by a ReceivePipeline.
+ */
+struct NKFNET_API PipelineMessage {
+	/** The socket the message was received on. */
+	Socket *	socket;
+	/** The source address, for stream sockets the remote address. */
+	Address		source;
+	/** The number of bytes received. */
+	size_t		length;
+	/** The data received, owned by the pipeline. */
+	char *		data;
+
+	PipelineMessage(size_t capacity);
+
+	~PipelineMessage();
+
+private:
+	PipelineMessage(const PipelineMessage &);
+
+	PipelineMessage & operator=(const PipelineMessage &);
+};
+
+/**
+ * Implemented by the application to handle messages in the worker threads
+ * of a ReceivePipeline.
+ */
+class NKFNET_API PipelineHandler {
+public:
+	/**
+	 * Handles a message. Called from the worker threads, so must be thread
+	 * safe. The message is only valid during the call.
+	 *
+	 * \param	worker	The index of the worker thread.
+	 * \param	msg		The message.
+	 */
+	virtual void handle(size_t worker, PipelineMessage & msg) = 0;
+
+	virtual ~PipelineHandler() {}
+};
+
+/**
+ * ReceivePipeline receives on one or more sockets in a network thread, and
+ * hands the messages to a number of worker threads, without any locks on
+ * the data path.
+ *
+ * Every worker has its own single producer / single consumer ring. Message
+ * buffers are preallocated and recycled: the network thread receives
+ * directly into a buffer, which passes through the ring to the worker and
+ * back, so data is never copied. If a worker falls behind, its ring fills
+ * up and the overflow policy decides what happens.
+ *
+ * \code
+ * class Analysis : public PipelineHandler {
+ *   void handle(size_t worker, PipelineMessage & msg) { ... }
+ * };
+ * Analysis analysis;
+ * ReceivePipeline pipe(analysis, 8);
+ * pipe.add(udpSock);
+ * pipe.setOverflowPolicy(DROP_OLDEST);
+ * pipe.start();
+ * // ...
+ * pipe.stop();
+ * \endcode
+ *
+ * Sockets added must not be used by others while the pipeline runs, and
+ * must stay valid until stop() has returned. Sockets are waited on using
+ * SocketSet, so the same restrictions apply. The network thread sleeps
+ * until a socket is readable, stop() wakes it with a Wakeup, so the
+ * pipeline is Posix only.
+ */
+class NKFNET_API ReceivePipeline {
+public:
+	/**
+	 * Creates a new pipeline.
+	 *
+	 * \param	handler		The handler of the messages.
+	 * \param	workers		The number of worker threads.
+	 * \param	ringSize	The number of messages queued per worker.
+	 * \param	maxMessage	The maximum message size in bytes.
+	 */
+	ReceivePipeline(PipelineHandler & handler, size_t workers, size_t ringSize = 1024,
+			size_t maxMessage = 65536);
+
+	/**
+	 * Adds a socket to receive on. Must be called before start(). Throws
+	 * a SocketException (EINVAL) for a handle SocketSet cannot wait on.
+	 *
+	 * \param	sock	The socket.
+	 */
+	void	add(Socket & sock);
+
+	/**
+	 * Sets the overflow policy, the default is DROP_NEWEST. May be changed
+	 * at any time.
+	 *
+	 * \param	policy	The policy.
+	 */
+	void	setOverflowPolicy(OverflowPolicy policy);
+
+	/**
+	 * Sets how messages are distributed over workers, the default is
+	 * BY_SOURCE. Must be called before start().
+	 *
+	 * \param	distribution	The distribution.
+	 */
+	void	setDistribution(Distribution distribution);
+
+	/**
+	 * Starts the network and worker threads.
+	 */
+	void	start();
+
+	/**
+	 * Stops receiving, lets the workers handle all queued messages, and
+	 * stops all threads. Calling stop() multiple times has no effect.
+	 *
+	 * If the network thread stopped receiving by itself, because waiting
+	 * for the sockets failed, its SocketException is thrown here, after
+	 * all threads are stopped. The failure is counted in errors() too.
+	 */
+	void	stop();
+
+	/**
+	 * Returns the number of messages received.
+	 */
+	unsigned long received();
+
+	/**
+	 * Returns the number of messages dropped because of overflow.
+	 */
+	unsigned long dropped();
+
+	/**
+	 * Returns the number of receive errors, including a failure which
+	 * stopped the network thread.
+	 */
+	unsigned long errors();
+
+	/**
+	 * Returns the number of messages handled by a worker.
+	 *
+	 * \param	worker	The index of the worker.
+	 */
+	unsigned long handled(size_t worker);
+
+	/**
+	 * Returns the number of messages queued for a worker.
+	 *
+	 * \param	worker	The index of the worker.
+	 */
+	size_t	queued(size_t worker);
+
+	/**
+	 * Stops the pipeline, and frees all buffers.
+	 */
+	virtual ~ReceivePipeline();
+
+private:
+	struct Source {
+		Socket *	socket;
+		bool		stream;
+		bool		closed;
+	};
+
+	struct Worker {
+		SpscRing<PipelineMessage*>	ring;
+		SpscRing<PipelineMessage*>	free;
+		std::atomic<bool>			sleeping;
+		std::atomic<unsigned long>	handled;
+		std::mutex					lock;
+		std::condition_variable		wake;
+		std::thread					thread;
+
+		Worker(size_t ringSize, size_t buffers);
+	};
+
+	void	runNetwork();
+
+	void	receiveAll();
+
+	void	runWorker(size_t index);
+
+	bool	receive(Source & source);
+
+	void	dispatch();
+
+	size_t	select(PipelineMessage & msg);
+
+	void	wake(Worker & worker);
+
+	ReceivePipeline(const ReceivePipeline &);
+
+	ReceivePipeline & operator=(const ReceivePipeline &);
+
+	PipelineHandler &				_handler;
+
+	std::vector<Worker*>			_workers;
+
+	std::vector<Source>				_sources;
+
+	std::vector<PipelineMessage*>	_buffers;
+
+	PipelineMessage *				_spare;
+
+	size_t							_maxMessage;
+
+	size_t							_next;
+
+	std::atomic<int>				_policy;
+
+	Distribution					_distribution;
+
+	std::atomic<bool>				_running;
+
+	std::atomic<bool>				_workersRunning;
+
+	std::atomic<unsigned long>		_received;
+
+	std::atomic<unsigned long>		_dropped;
+
+	std::atomic<unsigned long>		_errors;
+
+	SocketException *				_failure;		// stopped the network thread
+
+	Wakeup							_wakeup;
+
+	std::thread						_network;
+};
+
+END_NKF_NET
+
+#endif /* RECEIVEPIPELINE_H_ */
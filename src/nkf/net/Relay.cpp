@@ -0,0 +1,307 @@
+/*
+ * Relay.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "Relay.h"
+#include "SocketException.h"
+#include "SocketSet.h"
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+START_NKF_NET
+
+/*
+ * A Buffer holds the length prefix and the message, so it is one slice in
+ * every OutputBuffer. The relay holds one reference while delivering, and
+ * every subscriber it is written to one more, until its OutputBuffer has
+ * sent it. Buffers are kept for reuse, at most as many as were ever in
+ * use at the same time, which the high watermark bounds.
+ */
+
+static const size_t	RELAY_BATCH = 64;		// messages received per poll
+
+static const size_t	PREFIX_SIZE = 4;
+
+// --------------------------------------------------------------------------
+// Relay
+// --------------------------------------------------------------------------
+
+Relay::Relay(Socket & source, size_t maxMessage) :
+	_source(source),
+	_listener(NULL),
+	_maxMessage(maxMessage),
+	_policy(RELAY_DISCONNECT),
+	_high(4 * 1024 * 1024),
+	_low(1024 * 1024),
+	_stopped(false),
+	_closed(false),
+	_seqPacket(source.getIntOption(SO_TYPE) == SOCK_SEQPACKET),
+	_messages(0),
+	_skipped(0),
+	_disconnected(0) {
+	if (source.getIntOption(SO_TYPE) == SOCK_STREAM)
+		throw SocketException("Relay source must be a datagram socket", EINVAL);
+	_source.setBlocking(false);
+}
+
+// --------------------------------------------------------------------------
+
+void Relay::setListenSocket(Socket & listener) {
+	_listener = &listener;
+}
+
+// --------------------------------------------------------------------------
+
+void Relay::addSubscriber(Socket * conn) {
+	Subscriber sub;
+	sub.sock = conn;
+	sub.out = NULL;
+	sub.sampling = false;
+	try {
+		conn->setBlocking(false);
+		sub.out = new OutputBuffer(*conn);
+		_subscribers.push_back(sub);
+	} catch (...) {
+		delete sub.out;
+		delete conn;
+		throw;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void Relay::publish(const void * buf, size_t len) {
+	if (len > _maxMessage)
+		throw SocketException("Message too large to relay", EMSGSIZE);
+	Buffer * msg = allocate();
+	memcpy(msg->data + PREFIX_SIZE, buf, len);
+	msg->length = PREFIX_SIZE + len;
+	deliver(msg);
+	release(msg);
+}
+
+// --------------------------------------------------------------------------
+
+Relay::Buffer* Relay::allocate() {
+	Buffer * buf;
+	if (!_free.empty()) {
+		buf = _free.back();
+		_free.pop_back();
+	} else {
+		buf = static_cast<Buffer*> (malloc(offsetof(Buffer, data) + PREFIX_SIZE + _maxMessage));
+		if (buf == NULL)
+			throw SocketException("Out of memory", ENOMEM);
+	}
+	buf->refs = 1;
+	buf->length = 0;
+	return buf;
+}
+
+// --------------------------------------------------------------------------
+
+void Relay::release(Buffer * buf) {
+	if (--buf->refs == 0) _free.push_back(buf);
+}
+
+// --------------------------------------------------------------------------
+
+void Relay::deliver(Buffer * buf) {
+	uint32_t prefix = htonl(static_cast<uint32_t> (buf->length - PREFIX_SIZE));
+	memcpy(buf->data, &prefix, PREFIX_SIZE);
+	++_messages;
+
+	size_t i = 0;
+	while (i < _subscribers.size()) {
+		Subscriber & sub = _subscribers[i];
+		size_t queued = sub.out->queued();
+		if (sub.sampling && queued <= _low) {
+			sub.sampling = false;
+		}
+		if (!sub.sampling && queued > _high) {
+			if (_policy == RELAY_DISCONNECT) {
+				++_disconnected;
+				remove(i);
+				continue;
+			}
+			sub.sampling = true;
+		}
+		if (sub.sampling) {
+			++_skipped;
+			++i;
+			continue;
+		}
+
+		++buf->refs;
+		try {
+			sub.out->writeRef(buf->data, buf->length, [this, buf] { release(buf); });
+		} catch (SocketException &) {
+			// still queued, released when remove() deletes the OutputBuffer
+			remove(i);
+			continue;
+		}
+		++i;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+bool Relay::receive() {
+	for (size_t n = 0; n < RELAY_BATCH; ++n) {
+		Buffer * buf = allocate();
+		size_t len;
+		try {
+			len = _source.receive(buf->data + PREFIX_SIZE, _maxMessage);
+		} catch (SocketException & se) {
+			release(buf);
+			if (se.code() == EAGAIN || se.code() == EWOULDBLOCK)
+				return true;
+			throw;
+		}
+		if (len == 0 && _seqPacket) {
+			release(buf);
+			return false;
+		}
+		buf->length = PREFIX_SIZE + len;
+		deliver(buf);
+		release(buf);
+	}
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+void Relay::accept() {
+	Socket * conn;
+	try {
+		conn = _listener->accept();
+	} catch (SocketException & se) {
+		// the connection may have been reset before it was accepted
+		if (se.code() == EAGAIN || se.code() == EWOULDBLOCK || se.code() == ECONNABORTED)
+			return;
+		throw;
+	}
+	addSubscriber(conn);
+}
+
+// --------------------------------------------------------------------------
+
+void Relay::remove(size_t index) {
+	Subscriber sub = _subscribers[index];
+	_subscribers.erase(_subscribers.begin() + index);
+	delete sub.out;		// releases the queued buffers
+	delete sub.sock;
+}
+
+// --------------------------------------------------------------------------
+
+bool Relay::poll(const timeval & timeout) {
+	if (_stopped.load() || _closed) return false;
+
+	SocketSet read(_source);
+	read.set(_wakeup.handle());
+	if (_listener != NULL) read.set(*_listener);
+	SocketSet write;
+	bool writing = false;
+	for (size_t i = 0; i < _subscribers.size(); ++i) {
+		// subscribers do not send, readable means closed
+		read.set(*_subscribers[i].sock);
+		if (_subscribers[i].out->pending()) {
+			write.set(*_subscribers[i].sock);
+			writing = true;
+		}
+	}
+
+	SocketSet::select(&read, writing ? &write : NULL, NULL, timeout);
+	if (read.isSet(_wakeup.handle())) _wakeup.clear();
+
+	// send first, so queues have room for what is received next
+	size_t i = 0;
+	while (i < _subscribers.size()) {
+		Subscriber & sub = _subscribers[i];
+		try {
+			if (read.isSet(*sub.sock)) {
+				char scratch[256];
+				if (sub.sock->receive(scratch, sizeof(scratch)) == 0) {
+					remove(i);
+					continue;
+				}
+			}
+			if (writing && write.isSet(*sub.sock)) sub.out->flush();
+		} catch (SocketException & se) {
+			if (se.code() != EAGAIN && se.code() != EWOULDBLOCK) {
+				remove(i);
+				continue;
+			}
+		}
+		++i;
+	}
+
+	if (_listener != NULL && read.isSet(*_listener)) accept();
+	if (read.isSet(_source) && !receive()) _closed = true;
+
+	return !_stopped.load() && !_closed;
+}
+
+// --------------------------------------------------------------------------
+
+void Relay::run() {
+	while (poll(FOREVER)) {
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void Relay::stop() {
+	_stopped.store(true);
+	_wakeup.wake();
+}
+
+// --------------------------------------------------------------------------
+
+void Relay::setPolicy(RelayPolicy policy, size_t high, size_t low) {
+	_policy = policy;
+	_high = high;
+	_low = low;
+}
+
+// --------------------------------------------------------------------------
+
+size_t Relay::subscribers() {
+	return _subscribers.size();
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long Relay::messages() {
+	return _messages;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long Relay::skipped() {
+	return _skipped;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long Relay::disconnected() {
+	return _disconnected;
+}
+
+// --------------------------------------------------------------------------
+
+Relay::~Relay() {
+	while (!_subscribers.empty()) {
+		remove(_subscribers.size() - 1);
+	}
+	for (size_t i = 0; i < _free.size(); ++i) {
+		free(_free[i]);
+	}
+}
+
+END_NKF_NET
@@ -0,0 +1,232 @@
+/*
+ * Relay.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef RELAY_H_
+#define RELAY_H_
+
+#include <atomic>
+#include <vector>
+#include "net.h"
+#include "Socket.h"
+#include "OutputBuffer.h"
+#include "Wakeup.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * What a Relay does with a subscriber which does not keep up.
+ */
+enum RelayPolicy {
+	RELAY_DISCONNECT,	//!< Close the connection
+	RELAY_SAMPLE		//!< Skip messages until its queue has drained
+};
+
+/**
+ * Relay receives messages on one socket and publishes each of them to
+ * any number of subscriber connections, e.g. to feed one detector stream
+ * to filters, monitors and an event display.
+ *
+ * Every message is received (or copied, with publish()) once, into a
+ * reference counted buffer which all subscribers share. Each subscriber
+ * has its own OutputBuffer, which writes the queued messages with
+ * vectored, non-blocking sends, and releases a buffer when the last
+ * subscriber has sent it.
+ *
+ * A subscriber which has more than the high watermark of bytes queued is
+ * not allowed to hold up the others or use up memory: it is disconnected,
+ * or, when sampling, gets no new messages until its queue drained to the
+ * low watermark. Messages are always sent whole.
+ *
+ * Subscribers receive every message preceded by its length, as a 32 bit
+ * integer in network byte order, so skipped messages do not break the
+ * stream.
+ *
+ * \code
+ * Socket source(UDP);
+ * source.bind(Address(5000));
+ * Socket listener(TCP);
+ * listener.bind(Address(5001));
+ * listener.listen();
+ *
+ * Relay relay(source);
+ * relay.setListenSocket(listener);		// subscribers just connect
+ * relay.setPolicy(RELAY_SAMPLE, 8 * 1024 * 1024, 1024 * 1024);
+ * relay.run();							// until relay.stop()
+ * \endcode
+ *
+ * The source must be a datagram or sequenced packet socket, where every
+ * datagram is a message; a stream socket has no message boundaries and
+ * is refused. It is made non-blocking. The relay runs in one thread, only
+ * stop() may be called from another. Posix only.
+ */
+class NKFNET_API Relay {
+public:
+	/**
+	 * Creates a new relay, without subscribers.
+	 *
+	 * \param	source		The socket to receive messages on, not a stream
+	 * 						socket (EINVAL).
+	 * \param	maxMessage	The maximum size of a message in bytes.
+	 */
+	Relay(Socket & source, size_t maxMessage = 65536);
+
+	/**
+	 * Sets a listening TCP socket, on which subscribers are accepted.
+	 *
+	 * \param	listener	The listening socket.
+	 */
+	void	setListenSocket(Socket & listener);
+
+	/**
+	 * Adds a subscriber connection. The relay becomes the owner of the
+	 * socket, and makes it non-blocking.
+	 *
+	 * \param	conn	The connected TCP socket.
+	 */
+	void	addSubscriber(Socket * conn);
+
+	/**
+	 * Publishes a message to all subscribers, as if it were received on
+	 * the source.
+	 *
+	 * \param	buf		The message.
+	 * \param	len		The length of the message in bytes, at most
+	 * 					maxMessage.
+	 */
+	void	publish(const void * buf, size_t len);
+
+	/**
+	 * Waits for the sockets, once, and receives, accepts and sends what
+	 * is possible.
+	 *
+	 * \param	timeout		The maximum time to wait.
+	 *
+	 * \return	false if the source was closed, or the relay stopped.
+	 */
+	bool	poll(const timeval & timeout);
+
+	/**
+	 * Calls poll() until the relay is stopped, or the source is closed.
+	 */
+	void	run();
+
+	/**
+	 * Makes run() return. May be called from any thread.
+	 */
+	void	stop();
+
+	/**
+	 * Sets what to do with slow subscribers. Default is to disconnect
+	 * them when more than 4 MiB is queued.
+	 *
+	 * \param	policy	The policy.
+	 * \param	high	The bytes queued for a subscriber above which it is
+	 * 					too slow.
+	 * \param	low		The bytes queued at which a sampled subscriber
+	 * 					gets messages again.
+	 */
+	void	setPolicy(RelayPolicy policy, size_t high, size_t low);
+
+	/**
+	 * Returns the number of subscribers.
+	 *
+	 * \return	The number of subscribers.
+	 */
+	size_t	subscribers();
+
+	/**
+	 * Returns the number of messages published.
+	 *
+	 * \return	The number of messages.
+	 */
+	unsigned long long messages();
+
+	/**
+	 * Returns the number of messages not sent to a subscriber, summed
+	 * over all subscribers.
+	 *
+	 * \return	The number of messages.
+	 */
+	unsigned long long skipped();
+
+	/**
+	 * Returns the number of subscribers disconnected for being too slow.
+	 *
+	 * \return	The number of subscribers.
+	 */
+	unsigned long disconnected();
+
+	/**
+	 * Closes all subscriber connections.
+	 */
+	virtual ~Relay();
+
+private:
+	struct Buffer {
+		size_t		refs;
+		size_t		length;
+		char		data[1];	// length prefix and message
+	};
+
+	struct Subscriber {
+		Socket *		sock;
+		OutputBuffer *	out;
+		bool			sampling;
+	};
+
+	Buffer*	allocate();
+
+	void	release(Buffer * buf);
+
+	void	deliver(Buffer * buf);
+
+	bool	receive();
+
+	void	accept();
+
+	void	remove(size_t index);
+
+	Relay(const Relay &);
+
+	Relay & operator=(const Relay &);
+
+	Socket &					_source;
+
+	Socket *					_listener;
+
+	size_t						_maxMessage;
+
+	std::vector<Subscriber>		_subscribers;
+
+	std::vector<Buffer*>		_free;
+
+	RelayPolicy					_policy;
+
+	size_t						_high;
+
+	size_t						_low;
+
+	Wakeup						_wakeup;
+
+	std::atomic<bool>			_stopped;
+
+	bool						_closed;
+
+	bool						_seqPacket;		// empty receive is the end
+
+	unsigned long long			_messages;
+
+	unsigned long long			_skipped;
+
+	unsigned long				_disconnected;
+};
+
+END_NKF_NET
+
+#endif /* RELAY_H_ */
@@ -0,0 +1,647 @@
+/*
+ * ReliableChannel.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "ReliableChannel.h"
+#include "SocketException.h"
+#include "SocketSet.h"
+#include <chrono>
+#include <cstring>
+
+START_NKF_NET
+
+/*
+ * Every datagram starts with an 8 byte header, in network byte order:
+ *
+ *   0  type
+ *   1  unused
+ *   2  number of ranges, NACK only
+ *   4  sequence number
+ *
+ * DATA carries a message. NACK lists the missing messages as ranges of
+ * 8 bytes (first sequence number, count). SKIP gives the oldest message
+ * the sender still has, all before it are lost. PROBE gives the sequence
+ * number of the next message. ACK gives the oldest message the receiver
+ * has not delivered; it answers a probe, comes with every batch of NACKs
+ * and after every quarter window delivered.
+ *
+ * The receiver holds a window from its oldest undelivered message, and
+ * the sender keeps at most a window past the last ACK, so everything the
+ * receiver may ask for is still in the sender's ring. Messages beyond the
+ * window, e.g. when the windows differ, are dropped and asked for once
+ * the window moves past them.
+ *
+ * Both ends index their rings with the low bits of the sequence number;
+ * sequence numbers are compared by their signed difference, so they may
+ * wrap around.
+ */
+
+static const size_t		HEADER_SIZE = 8;
+
+static const size_t		RANGE_SIZE = 8;
+
+static const size_t		BATCH = 32;			// datagrams received per call
+
+static const unsigned long long SERVE_EVERY = 32;		// sends between polls
+
+enum PacketType { DATA = 1, NACK, SKIP, PROBE, ACK };
+
+static const timeval	NOW = { 0, 0 };
+
+// --------------------------------------------------------------------------
+
+static inline void put32(char * p, uint32_t v) {
+	p[0] = static_cast<char> (v >> 24);
+	p[1] = static_cast<char> (v >> 16);
+	p[2] = static_cast<char> (v >> 8);
+	p[3] = static_cast<char> (v);
+}
+
+static inline uint32_t get32(const char * p) {
+	const unsigned char * u = reinterpret_cast<const unsigned char*> (p);
+	return (static_cast<uint32_t> (u[0]) << 24) | (u[1] << 16) | (u[2] << 8) | u[3];
+}
+
+static inline void putHeader(char * p, int type, size_t count, uint32_t seq) {
+	p[0] = static_cast<char> (type);
+	p[1] = 0;
+	p[2] = static_cast<char> (count >> 8);
+	p[3] = static_cast<char> (count);
+	put32(p + 4, seq);
+}
+
+static inline int32_t seqDiff(uint32_t a, uint32_t b) {
+	return static_cast<int32_t> (a - b);
+}
+
+// the splitmix64 finalizer
+static inline uint64_t mix(uint64_t h) {
+	h ^= h >> 30;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 27;
+	h *= 0x94d049bb133111ebULL;
+	h ^= h >> 31;
+	return h;
+}
+
+// --------------------------------------------------------------------------
+
+static size_t powerOfTwo(size_t n) {
+	size_t p = 1;
+	while (p < n) p <<= 1;
+	return p;
+}
+
+// --------------------------------------------------------------------------
+// ReliableChannel
+// --------------------------------------------------------------------------
+
+ReliableChannel::ReliableChannel(Socket & sock, DeliveryOrder order, size_t window, size_t mtu) :
+	_sock(sock),
+	_order(order),
+	_window(powerOfTwo(window)),
+	_mask(static_cast<uint32_t> (_window - 1)),
+	_mtu(mtu),
+	_retry(5000),
+	_history(_window),
+	_sendNext(0),
+	_sendCount(0),
+	_acked(0),
+	_lastSend(0),
+	_lastProbe(0),
+	_slots(_window),
+	_base(0),
+	_next(0),
+	_seen(0),
+	_ackSent(0),
+	_missing(0),
+	_in(BATCH * mtu),
+	_batch(BATCH),
+	_control(mtu),
+	_lossThreshold(0),
+	_lossSeed(1),
+	_sent(0),
+	_retransmitted(0),
+	_delivered(0),
+	_duplicates(0),
+	_nacksSent(0),
+	_nacksReceived(0),
+	_lost(0),
+	_overruns(0),
+	_injected(0) {
+	if (mtu < HEADER_SIZE + RANGE_SIZE || mtu > 65507)
+		throw SocketException("Invalid MTU for a reliable channel", EINVAL);
+	if (window == 0 || window > 65536)
+		throw SocketException("Invalid window for a reliable channel", EINVAL);
+
+	memset(_controlSeq, 0, sizeof(_controlSeq));
+	memset(_controlAttempts, 0, sizeof(_controlAttempts));
+	for (size_t i = 0; i < _window; ++i) {
+		_history[i].data.resize(mtu);
+		_slots[i].data.resize(mtu - HEADER_SIZE);
+	}
+	for (size_t i = 0; i < BATCH; ++i) {
+		_batch[i].data = &_in[i * mtu];
+		_batch[i].size = mtu;
+		_batch[i].length = 0;
+		_batch[i].addr = NULL;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void ReliableChannel::send(const void * buf, size_t len) {
+	if (len > _mtu - HEADER_SIZE)
+		throw SocketException("Message too large for the channel", EMSGSIZE);
+	waitForAck();
+
+	SendSlot & slot = _history[_sendNext & _mask];
+	putHeader(&slot.data[0], DATA, 0, _sendNext);
+	memcpy(&slot.data[HEADER_SIZE], buf, len);
+	slot.length = HEADER_SIZE + len;
+	slot.attempts = 0;
+	++_sendNext;
+	++_sendCount;
+	++_sent;
+
+	Datagram dgram = { &slot.data[0], slot.length, NULL };
+	transmit(&dgram, 1);
+	_lastSend = now();
+
+	// NACKs must be served before the ring wraps around
+	if (_sendCount % SERVE_EVERY == 0) poll(NOW);
+}
+
+// --------------------------------------------------------------------------
+
+size_t ReliableChannel::receive(void * buf, size_t len) {
+	while (!poll(FOREVER)) {
+	}
+
+	uint32_t seq;
+	if (_order == DELIVER_ORDERED) {
+		seq = _base;
+	} else {
+		seq = _ready.front();
+		_ready.pop_front();
+	}
+	ReceiveSlot & slot = _slots[seq & _mask];
+	size_t bytes = slot.length < len ? slot.length : len;
+	memcpy(buf, &slot.data[0], bytes);
+	slot.state = DONE;
+	++_delivered;
+	advance();
+	extend(now());
+	if (static_cast<uint32_t> (_base - _ackSent) >= _window / 4) sendAck();
+	return bytes;
+}
+
+// --------------------------------------------------------------------------
+
+bool ReliableChannel::poll(const timeval & timeout) {
+	bool forever = timeout.tv_usec >= 1000000;
+	unsigned long long limit = forever ? 0 :
+			now() + timeout.tv_sec * 1000000ULL + timeout.tv_usec;
+
+	for (;;) {
+		unsigned long long time = now();
+		unsigned long long next = timers(time);
+		if (ready()) return true;
+
+		unsigned long long until = next;
+		if (!forever && (until == 0 || limit < until)) until = limit;
+		timeval wait = FOREVER;
+		if (until != 0) {
+			unsigned long long delay = until > time ? until - time : 0;
+			wait.tv_sec = static_cast<long> (delay / 1000000);
+			wait.tv_usec = static_cast<long> (delay % 1000000);
+		}
+
+		SocketSet read(_sock);
+		if (SocketSet::select(&read, NULL, NULL, wait) > 0) drain();
+		if (!forever && now() >= limit) {
+			timers(now());
+			return ready();
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+
+bool ReliableChannel::flushed() {
+	return _acked == _sendNext;
+}
+
+// --------------------------------------------------------------------------
+
+void ReliableChannel::setRetryInterval(unsigned int ms) {
+	_retry = ms * 1000ULL;
+}
+
+// --------------------------------------------------------------------------
+
+void ReliableChannel::setLoss(double rate, unsigned int seed) {
+	if (rate <= 0) _lossThreshold = 0;
+	else if (rate >= 1) _lossThreshold = 0xffffffff;
+	else _lossThreshold = static_cast<uint32_t> (rate * 4294967296.0);
+	_lossSeed = seed;
+}
+
+// --------------------------------------------------------------------------
+
+void ReliableChannel::waitForAck() {
+	// the ring must keep everything the receiver may still ask for
+	while (static_cast<uint32_t> (_sendNext - _acked) >= _window) {
+		unsigned long long time = now();
+		unsigned long long next = timers(time);		// probes while waiting
+		unsigned long long delay = next > time ? next - time : 0;
+		timeval wait = mktv(static_cast<unsigned long> (delay / 1000000),
+				static_cast<unsigned long> (delay % 1000000));
+		SocketSet read(_sock);
+		if (SocketSet::select(&read, NULL, NULL, wait) > 0) drain();
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void ReliableChannel::transmit(Datagram * dgrams, size_t count) {
+	if (_lossThreshold != 0) {
+		size_t kept = 0;
+		for (size_t i = 0; i < count; ++i) {
+			if (drop(dgrams[i])) {
+				++_injected;
+				continue;
+			}
+			dgrams[kept++] = dgrams[i];
+		}
+		count = kept;
+	}
+
+	size_t sent = 0;
+	try {
+		while (sent < count) {
+			sent += _sock.sendBatch(dgrams + sent, count - sent);
+		}
+	} catch (SocketException & se) {
+		// the peer is not there yet, it will ask again
+		if (se.code() != ECONNREFUSED) throw;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+bool ReliableChannel::drop(const Datagram & dgram) {
+	// The decision depends on the datagram only, not on what was sent
+	// before it: a NACK or probe sent on a timer must not change which
+	// messages are lost. Retransmissions count their attempts, control
+	// datagrams count repeats of the same sequence number.
+	const char * p = static_cast<const char*> (dgram.data);
+	int type = p[0];
+	uint32_t seq = get32(p + 4);
+	uint32_t attempt;
+	if (type == DATA) {
+		attempt = _history[seq & _mask].attempts++;
+	} else {
+		// a NACK is known by the first message it asks for
+		if (type == NACK && dgram.length >= HEADER_SIZE + RANGE_SIZE)
+			seq = get32(p + HEADER_SIZE);
+		type &= 7;
+		if (_controlSeq[type] != seq) {
+			_controlSeq[type] = seq;
+			_controlAttempts[type] = 0;
+		}
+		attempt = _controlAttempts[type]++;
+	}
+
+	uint64_t h = mix((static_cast<uint64_t> (_lossSeed) << 32) | seq);
+	h = mix(h ^ ((static_cast<uint64_t> (type) << 32) | attempt));
+	return static_cast<uint32_t> (h >> 32) < _lossThreshold;
+}
+
+// --------------------------------------------------------------------------
+
+void ReliableChannel::sendControl(int type, uint32_t seq, const char * body, size_t len) {
+	putHeader(&_control[0], type, len / RANGE_SIZE, seq);
+	if (len > 0 && body != &_control[HEADER_SIZE])
+		memcpy(&_control[HEADER_SIZE], body, len);
+	Datagram dgram = { &_control[0], HEADER_SIZE + len, NULL };
+	transmit(&dgram, 1);
+}
+
+// --------------------------------------------------------------------------
+
+void ReliableChannel::drain() {
+	size_t count;
+	try {
+		count = _sock.receiveBatch(&_batch[0], _batch.size());
+	} catch (SocketException & se) {
+		if (se.code() == ECONNREFUSED) return;
+		throw;
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		const char * dgram = static_cast<const char*> (_batch[i].data);
+		size_t len = _batch[i].length;
+		if (len < HEADER_SIZE) continue;
+		uint32_t seq = get32(dgram + 4);
+		switch (dgram[0]) {
+		case DATA:
+			handleData(seq, dgram + HEADER_SIZE, len - HEADER_SIZE);
+			break;
+		case NACK:
+			handleNack(dgram + HEADER_SIZE, len - HEADER_SIZE);
+			break;
+		case SKIP:
+			handleSkip(seq);
+			break;
+		case PROBE:
+			handleProbe(seq);
+			break;
+		case ACK:
+			handleAck(seq);
+			break;
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void ReliableChannel::handleData(uint32_t seq, const char * data, size_t len) {
+	int32_t ahead = seqDiff(seq, _base);
+	if (ahead < 0) {
+		++_duplicates;
+		return;
+	}
+	if (seqDiff(seq + 1, _seen) > 0) _seen = seq + 1;
+	if (static_cast<size_t> (ahead) >= _window) {
+		// ask for it once the window moves
+		++_overruns;
+		extend(now());
+		return;
+	}
+
+	ReceiveSlot & slot = _slots[seq & _mask];
+	if (seqDiff(seq, _next) >= 0) {
+		markMissing(seq, now());
+		_next = seq + 1;
+	} else if (slot.state == EMPTY) {
+		--_missing;
+	} else {
+		++_duplicates;
+		return;
+	}
+
+	memcpy(&slot.data[0], data, len);
+	slot.length = len;
+	slot.state = READY;
+	if (_order == DELIVER_UNORDERED) _ready.push_back(seq);
+}
+
+// --------------------------------------------------------------------------
+
+void ReliableChannel::handleNack(const char * body, size_t len) {
+	++_nacksReceived;
+	uint32_t oldest = _sendNext - static_cast<uint32_t> (_sendCount < _window ? _sendCount : _window);
+	bool gone = false;
+
+	_resend.clear();
+	for (size_t r = 0; r + RANGE_SIZE <= len; r += RANGE_SIZE) {
+		uint32_t first = get32(body + r);
+		uint32_t count = get32(body + r + 4);
+		if (count > _window) count = static_cast<uint32_t> (_window);
+		for (uint32_t seq = first; seq != first + count; ++seq) {
+			if (seqDiff(seq, _sendNext) >= 0) break;
+			if (seqDiff(seq, oldest) < 0) {
+				gone = true;
+				continue;
+			}
+			SendSlot & slot = _history[seq & _mask];
+			Datagram dgram = { &slot.data[0], slot.length, NULL };
+			_resend.push_back(dgram);
+		}
+	}
+
+	_retransmitted += _resend.size();
+	if (!_resend.empty()) transmit(&_resend[0], _resend.size());
+	if (gone) sendControl(SKIP, oldest, NULL, 0);
+}
+
+// --------------------------------------------------------------------------
+
+void ReliableChannel::handleProbe(uint32_t next) {
+	if (seqDiff(next, _seen) > 0) _seen = next;
+	extend(now());
+	sendAck();
+}
+
+// --------------------------------------------------------------------------
+
+void ReliableChannel::handleSkip(uint32_t first) {
+	// the window moves as lost messages are passed, until first or a
+	// message which waits to be delivered
+	while (seqDiff(first, _base) > 0) {
+		uint32_t end = _base + static_cast<uint32_t> (_window);
+		bool last = seqDiff(first, end) <= 0;
+		if (last) end = first;
+		for (uint32_t seq = _base; seq != end; ++seq) {
+			ReceiveSlot & slot = _slots[seq & _mask];
+			if (seqDiff(seq, _next) >= 0) {
+				_next = seq + 1;
+			} else if (slot.state == EMPTY) {
+				--_missing;
+			} else {
+				continue;
+			}
+			slot.state = DONE;
+			++_lost;
+		}
+		uint32_t base = _base;
+		advance();
+		if (last || _base == base) break;
+	}
+	if (seqDiff(_next, _seen) > 0) _seen = _next;
+	extend(now());
+}
+
+// --------------------------------------------------------------------------
+
+void ReliableChannel::handleAck(uint32_t seq) {
+	if (seqDiff(seq, _acked) > 0 && seqDiff(seq, _sendNext) <= 0)
+		_acked = seq;
+}
+
+// --------------------------------------------------------------------------
+
+void ReliableChannel::sendAck() {
+	sendControl(ACK, _base, NULL, 0);
+	_ackSent = _base;
+}
+
+// --------------------------------------------------------------------------
+
+void ReliableChannel::markMissing(uint32_t end, unsigned long long now) {
+	for (uint32_t seq = _next; seq != end; ++seq) {
+		_slots[seq & _mask].nackAt = now;
+		++_missing;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void ReliableChannel::extend(unsigned long long now) {
+	// messages known to exist are asked for as far as the window allows
+	uint32_t end = _base + static_cast<uint32_t> (_window);
+	uint32_t until = seqDiff(_seen, end) > 0 ? end : _seen;
+	if (seqDiff(until, _next) > 0) {
+		markMissing(until, now);
+		_next = until;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void ReliableChannel::advance() {
+	while (_slots[_base & _mask].state == DONE) {
+		_slots[_base & _mask].state = EMPTY;
+		++_base;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+bool ReliableChannel::ready() {
+	if (_order == DELIVER_UNORDERED) return !_ready.empty();
+	return _slots[_base & _mask].state == READY;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long ReliableChannel::timers(unsigned long long now) {
+	unsigned long long next = 0;
+
+	if (_missing > 0) {
+		unsigned long long nacks = _nacksSent;
+		// collect the missing messages which are due in ranges
+		char * body = &_control[HEADER_SIZE];
+		size_t maxRanges = (_mtu - HEADER_SIZE) / RANGE_SIZE;
+		size_t ranges = 0;
+		uint32_t first = 0;
+		uint32_t count = 0;
+		for (uint32_t seq = _base; seq != _next; ++seq) {
+			ReceiveSlot & slot = _slots[seq & _mask];
+			if (slot.state != EMPTY) continue;
+			if (slot.nackAt <= now) {
+				slot.nackAt = now + _retry;
+				if (count > 0 && first + count == seq) {
+					++count;
+					continue;
+				}
+				if (count > 0) {
+					put32(body + ranges * RANGE_SIZE, first);
+					put32(body + ranges * RANGE_SIZE + 4, count);
+					if (++ranges == maxRanges) {
+						sendControl(NACK, 0, body, ranges * RANGE_SIZE);
+						++_nacksSent;
+						ranges = 0;
+					}
+				}
+				first = seq;
+				count = 1;
+			}
+			if (next == 0 || slot.nackAt < next) next = slot.nackAt;
+		}
+		if (count > 0) {
+			put32(body + ranges * RANGE_SIZE, first);
+			put32(body + ranges * RANGE_SIZE + 4, count);
+			++ranges;
+		}
+		if (ranges > 0) {
+			sendControl(NACK, 0, body, ranges * RANGE_SIZE);
+			++_nacksSent;
+		}
+		if (_nacksSent != nacks) sendAck();
+	}
+
+	if (_acked != _sendNext) {
+		unsigned long long last = _lastSend > _lastProbe ? _lastSend : _lastProbe;
+		if (now >= last + _retry) {
+			sendControl(PROBE, _sendNext, NULL, 0);
+			_lastProbe = now;
+			last = now;
+		}
+		if (next == 0 || last + _retry < next) next = last + _retry;
+	}
+
+	return next;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long ReliableChannel::now() {
+	return std::chrono::duration_cast<std::chrono::microseconds> (
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long ReliableChannel::sent() {
+	return _sent;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long ReliableChannel::retransmitted() {
+	return _retransmitted;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long ReliableChannel::delivered() {
+	return _delivered;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long ReliableChannel::duplicates() {
+	return _duplicates;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long ReliableChannel::nacksSent() {
+	return _nacksSent;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long ReliableChannel::nacksReceived() {
+	return _nacksReceived;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long ReliableChannel::lost() {
+	return _lost;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long ReliableChannel::overruns() {
+	return _overruns;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long ReliableChannel::injected() {
+	return _injected;
+}
+
+// --------------------------------------------------------------------------
+
+ReliableChannel::~ReliableChannel() {
+}
+
+END_NKF_NET
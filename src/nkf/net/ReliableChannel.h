@@ -0,0 +1,367 @@
+/*
+ * ReliableChannel.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef RELIABLECHANNEL_H_
+#define RELIABLECHANNEL_H_
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include "net.h"
+#include "Socket.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * The order in which a ReliableChannel delivers messages.
+ */
+enum DeliveryOrder {
+	/** In the order they were sent, a lost message holds back later ones. */
+	DELIVER_ORDERED,
+	/** As they arrive, retransmitted messages come late. */
+	DELIVER_UNORDERED
+};
+
+/**
+ * ReliableChannel delivers messages over a connected UDP socket, and
+ * recovers lost ones with negative acknowledgements (NACKs), for links
+ * where loss is rare and TCP's head-of-line blocking and congestion
+ * response cost too much.
+ *
+ * Every message is sent as one datagram with a sequence number. The
+ * receiver detects gaps in the sequence numbers and asks for the missing
+ * messages in batched NACKs, which are repeated until the message arrives.
+ * The sender keeps the last messages in a ring to retransmit. When the
+ * sender goes idle it probes the receiver with its next sequence number,
+ * so the loss of the last messages is noticed too.
+ *
+ * The receiver acknowledges the messages the application has received,
+ * regularly and in answer to probes. send() waits while a window of
+ * messages is unacknowledged, so a receiver which falls behind slows the
+ * sender down rather than losing messages; a message is only lost when
+ * it is asked for after the sender dropped it from its ring, which this
+ * prevents as long as both ends use the same window. There is no
+ * congestion control.
+ *
+ * \code
+ * // sender
+ * Socket sock(UDP);
+ * sock.connect(Address("daq02", 5000));
+ * ReliableChannel chan(sock);
+ * for (...) {
+ *     chan.send(event, eventLen);
+ * }
+ * while (!chan.flushed()) {
+ *     chan.poll(timeout);		// serve NACKs until all is received
+ * }
+ *
+ * // receiver
+ * ReliableChannel chan(sock, DELIVER_UNORDERED);
+ * size_t len = chan.receive(buf, sizeof(buf));
+ * \endcode
+ *
+ * Both ends of a channel use a ReliableChannel, the socket must be
+ * connected to the peer. The channel serves control messages from send(),
+ * receive() and poll() only, so a sender must keep calling one of them
+ * until the receiver has everything. Not thread safe.
+ */
+class NKFNET_API ReliableChannel {
+public:
+	/**
+	 * Creates a new channel.
+	 *
+	 * \param	sock		The connected UDP socket.
+	 * \param	order		The order in which messages are delivered.
+	 * \param	window		The number of messages kept for retransmission,
+	 * 						and the number of messages the receiver can hold
+	 * 						while waiting for a missing one, rounded up to a
+	 * 						power of two. The sender may send a window at
+	 * 						once, so the receive buffer of the socket should
+	 * 						hold as many datagrams, see BufferTuner, else
+	 * 						the kernel drops them and they are retransmitted.
+	 * \param	mtu			The largest datagram sent, 8 bytes of which are
+	 * 						used by the header.
+	 */
+	ReliableChannel(Socket & sock, DeliveryOrder order = DELIVER_ORDERED,
+			size_t window = 1024, size_t mtu = 1472);
+
+	/**
+	 * Sends a message. Waits, serving NACKs and probes, while the receiving
+	 * application has not yet received a window of messages sent before,
+	 * so the receiver must keep calling receive().
+	 *
+	 * \param	buf		The message.
+	 * \param	len		The length of the message, at most the MTU less 8
+	 * 					bytes.
+	 */
+	void	send(const void * buf, size_t len);
+
+	/**
+	 * Receives the next message, waits until one is available. A message
+	 * longer than the buffer is truncated.
+	 *
+	 * \param	buf		The buffer to receive in.
+	 * \param	len		The size of the buffer in bytes.
+	 *
+	 * \return			The number of bytes received, never exceeds len.
+	 */
+	size_t	receive(void * buf, size_t len);
+
+	/**
+	 * Handles incoming datagrams, NACKs and probes for at most the
+	 * timeout.
+	 *
+	 * \param	timeout		The time to wait, FOREVER waits for a message.
+	 *
+	 * \return	true when a message can be received without waiting.
+	 */
+	bool	poll(const timeval & timeout);
+
+	/**
+	 * Checks whether the receiver acknowledged all messages sent, which
+	 * it does once the application received them.
+	 *
+	 * \return	true when nothing is left to retransmit.
+	 */
+	bool	flushed();
+
+	/**
+	 * Sets the time to wait before a NACK is repeated and between probes.
+	 * The default of 5 milliseconds suits a LAN. It should exceed the round
+	 * trip time, including the time datagrams wait in the receive buffer,
+	 * else messages are retransmitted more than once.
+	 *
+	 * \param	ms		The interval in milliseconds.
+	 */
+	void	setRetryInterval(unsigned int ms);
+
+	/**
+	 * Drops outgoing datagrams on purpose, for testing. Whether a datagram
+	 * is dropped follows from a hash of the seed, its type, its sequence
+	 * number and the number of times it was sent before, so a given seed
+	 * drops the same messages every run, however the timers interleave
+	 * control datagrams with them. Control datagrams are dropped as well.
+	 *
+	 * \param	rate	The fraction of datagrams to drop, 0 disables.
+	 * \param	seed	The seed of the generator.
+	 */
+	void	setLoss(double rate, unsigned int seed = 1);
+
+	/**
+	 * Returns the number of messages sent, retransmissions excluded.
+	 *
+	 * \return	The number of messages.
+	 */
+	unsigned long long sent();
+
+	/**
+	 * Returns the number of messages retransmitted.
+	 *
+	 * \return	The number of messages.
+	 */
+	unsigned long long retransmitted();
+
+	/**
+	 * Returns the number of messages delivered by receive().
+	 *
+	 * \return	The number of messages.
+	 */
+	unsigned long long delivered();
+
+	/**
+	 * Returns the number of messages received more than once.
+	 *
+	 * \return	The number of messages.
+	 */
+	unsigned long long duplicates();
+
+	/**
+	 * Returns the number of NACK datagrams sent.
+	 *
+	 * \return	The number of datagrams.
+	 */
+	unsigned long long nacksSent();
+
+	/**
+	 * Returns the number of NACK datagrams received.
+	 *
+	 * \return	The number of datagrams.
+	 */
+	unsigned long long nacksReceived();
+
+	/**
+	 * Returns the number of messages skipped because the sender no longer
+	 * had them.
+	 *
+	 * \return	The number of messages.
+	 */
+	unsigned long long lost();
+
+	/**
+	 * Returns the number of messages dropped because they were too far
+	 * ahead of the oldest message the receiver waits for. They are asked
+	 * for again once the window moves.
+	 *
+	 * \return	The number of messages.
+	 */
+	unsigned long long overruns();
+
+	/**
+	 * Returns the number of datagrams dropped by setLoss().
+	 *
+	 * \return	The number of datagrams.
+	 */
+	unsigned long long injected();
+
+	virtual ~ReliableChannel();
+
+private:
+	enum SlotState { EMPTY, READY, DONE };
+
+	struct ReceiveSlot {
+		ReceiveSlot() : state(EMPTY), length(0), nackAt(0) {
+		}
+
+		SlotState				state;
+		size_t					length;
+		unsigned long long		nackAt;
+		std::vector<char>		data;
+	};
+
+	struct SendSlot {
+		SendSlot() : length(0), attempts(0) {
+		}
+
+		size_t					length;
+		uint32_t				attempts;	// times transmitted
+		std::vector<char>		data;	// header included
+	};
+
+	void	waitForAck();
+
+	void	transmit(Datagram * dgrams, size_t count);
+
+	bool	drop(const Datagram & dgram);
+
+	void	sendControl(int type, uint32_t seq, const char * body, size_t len);
+
+	void	drain();
+
+	void	handleData(uint32_t seq, const char * data, size_t len);
+
+	void	handleNack(const char * body, size_t len);
+
+	void	handleProbe(uint32_t next);
+
+	void	handleSkip(uint32_t first);
+
+	void	handleAck(uint32_t seq);
+
+	void	sendAck();
+
+	void	markMissing(uint32_t end, unsigned long long now);
+
+	void	extend(unsigned long long now);
+
+	void	advance();
+
+	bool	ready();
+
+	unsigned long long timers(unsigned long long now);
+
+	static unsigned long long now();
+
+	ReliableChannel(const ReliableChannel &);
+
+	ReliableChannel & operator=(const ReliableChannel &);
+
+	Socket &					_sock;
+
+	DeliveryOrder				_order;
+
+	size_t						_window;
+
+	uint32_t					_mask;
+
+	size_t						_mtu;
+
+	unsigned long long			_retry;			// microseconds
+
+	// sender
+
+	std::vector<SendSlot>		_history;
+
+	uint32_t					_sendNext;
+
+	unsigned long long			_sendCount;
+
+	uint32_t					_acked;			// receiver has all before
+
+	unsigned long long			_lastSend;
+
+	unsigned long long			_lastProbe;
+
+	std::vector<Datagram>		_resend;
+
+	// receiver
+
+	std::vector<ReceiveSlot>	_slots;
+
+	uint32_t					_base;			// oldest not delivered
+
+	uint32_t					_next;			// after the highest in the window
+
+	uint32_t					_seen;			// after the highest known to exist
+
+	uint32_t					_ackSent;		// _base in the last ACK
+
+	size_t						_missing;
+
+	std::deque<uint32_t>		_ready;			// unordered delivery
+
+	std::vector<char>			_in;
+
+	std::vector<DatagramBuffer>	_batch;
+
+	std::vector<char>			_control;
+
+	// loss injection
+
+	uint32_t					_lossThreshold;
+
+	uint32_t					_lossSeed;
+
+	uint32_t					_controlSeq[8];		// last sent per type
+
+	uint32_t					_controlAttempts[8];
+
+	// counters
+
+	unsigned long long			_sent;
+
+	unsigned long long			_retransmitted;
+
+	unsigned long long			_delivered;
+
+	unsigned long long			_duplicates;
+
+	unsigned long long			_nacksSent;
+
+	unsigned long long			_nacksReceived;
+
+	unsigned long long			_lost;
+
+	unsigned long long			_overruns;
+
+	unsigned long long			_injected;
+};
+
+END_NKF_NET
+
+#endif /* RELIABLECHANNEL_H_ */
@@ -0,0 +1,214 @@
+/*
+ * SendQueue.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "SendQueue.h"
+#include "SocketException.h"
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+START_NKF_NET
+
+/*
+ * Senders only take the lock when they have to wait, or when the writer
+ * is idle and must be woken. The writer only takes the lock when it goes
+ * idle, or when senders are waiting for it. '_waiters' counts the threads
+ * waiting on '_wakeSenders', so the writer knows when to notify.
+ */
+
+static const size_t	SENDQUEUE_BATCH = 64;	// messages per vectored send
+
+// --------------------------------------------------------------------------
+// SendQueue
+// --------------------------------------------------------------------------
+
+SendQueue::SendQueue(Socket & sock, size_t highWatermark, size_t lowWatermark) :
+	_sock(sock),
+	_queued(0),
+	_high(highWatermark),
+	_low(lowWatermark),
+	_throttled(false),
+	_writerIdle(false),
+	_closing(false),
+	_error(0),
+	_waiters(0) {
+	_writer = std::thread(&SendQueue::run, this);
+}
+
+// --------------------------------------------------------------------------
+
+void SendQueue::send(const void * buf, size_t len) {
+	if (_throttled.load()) {
+		std::unique_lock<std::mutex> lock(_lock);
+		++_waiters;
+		while (_throttled.load() && _error.load() == 0 && !_closing.load()) {
+			_wakeSenders.wait(lock);
+		}
+		--_waiters;
+	}
+	enqueue(buf, len);
+}
+
+// --------------------------------------------------------------------------
+
+bool SendQueue::trySend(const void * buf, size_t len) {
+	if (_throttled.load()) return false;
+	enqueue(buf, len);
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+void SendQueue::enqueue(const void * buf, size_t len) {
+	raiseError();
+	if (_closing.load())
+		throw SocketException("Send queue closed", EPIPE);
+
+	Message * msg = static_cast<Message*> (malloc(offsetof(Message, data) + len));
+	if (msg == NULL)
+		throw SocketException("Out of memory", ENOMEM);
+	msg->len = len;
+	memcpy(msg->data, buf, len);
+
+	if (_queued.fetch_add(len) + len > _high.load()) {
+		_throttled.store(true);
+	}
+	_queue.push(msg);
+
+	if (_writerIdle.load()) {
+		std::lock_guard<std::mutex> guard(_lock);
+		_wakeWriter.notify_one();
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void SendQueue::setWatermarks(size_t high, size_t low) {
+	_high.store(high);
+	_low.store(low);
+}
+
+// --------------------------------------------------------------------------
+
+size_t SendQueue::queued() {
+	return _queued.load();
+}
+
+// --------------------------------------------------------------------------
+
+void SendQueue::flush() {
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		++_waiters;
+		while (_queued.load() > 0 && _error.load() == 0) {
+			_wakeSenders.wait(lock);
+		}
+		--_waiters;
+	}
+	raiseError();
+}
+
+// --------------------------------------------------------------------------
+
+void SendQueue::close() {
+	if (!_writer.joinable()) return;
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		_closing.store(true);
+		_wakeWriter.notify_one();
+		_wakeSenders.notify_all();
+	}
+	_writer.join();
+	raiseError();
+}
+
+// --------------------------------------------------------------------------
+
+void SendQueue::raiseError() {
+	int code = _error.load();
+	if (code != 0)
+		throw SocketException(strerror(code), code);
+}
+
+// --------------------------------------------------------------------------
+
+void SendQueue::run() {
+	Message * batch[SENDQUEUE_BATCH];
+	iovec iov[SENDQUEUE_BATCH];
+
+	while (true) {
+		size_t count = 0;
+		size_t bytes = 0;
+		Message * msg;
+		while (count < SENDQUEUE_BATCH && _queue.pop(msg)) {
+			batch[count] = msg;
+			iov[count].iov_base = msg->data;
+			iov[count].iov_len = msg->len;
+			bytes += msg->len;
+			++count;
+		}
+
+		if (count == 0) {
+			if (!_queue.empty()) {
+				std::this_thread::yield();	// a push is in progress
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(_lock);
+			_writerIdle.store(true);
+			while (_queue.empty() && !_closing.load()) {
+				_wakeWriter.wait(lock);
+			}
+			_writerIdle.store(false);
+			if (_queue.empty()) break;		// closing, and all sent
+			continue;
+		}
+
+		if (_error.load() == 0) {
+			try {
+				size_t index = 0;
+				while (index < count) {
+					size_t sent = _sock.send(iov + index, count - index);
+					while (index < count && sent >= iov[index].iov_len) {
+						sent -= iov[index].iov_len;
+						++index;
+					}
+					if (index < count) {
+						iov[index].iov_base = static_cast<char*> (iov[index].iov_base) + sent;
+						iov[index].iov_len -= sent;
+					}
+				}
+			} catch (SocketException & se) {
+				_error.store(se.code() != 0 ? se.code() : EIO);
+			}
+		}
+
+		for (size_t i = 0; i < count; ++i) {
+			free(batch[i]);
+		}
+
+		size_t queued = _queued.fetch_sub(bytes) - bytes;
+		if (_throttled.load() && queued <= _low.load()) {
+			_throttled.store(false);
+		}
+		if (_waiters.load() > 0) {
+			std::lock_guard<std::mutex> guard(_lock);
+			_wakeSenders.notify_all();
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+
+SendQueue::~SendQueue() {
+	try {
+		close();
+	} catch (const SocketException &) {
+		// nothing to report to
+	}
+}
+
+END_NKF_NET
@@ -0,0 +1,160 @@
+/*
+ * SendQueue.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef SENDQUEUE_H_
+#define SENDQUEUE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "net.h"
+#include "Socket.h"
+#include "MpscQueue.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * SendQueue lets many threads send on one Socket without serializing on
+ * a lock. Messages are copied into a lock-free queue, and a dedicated
+ * writer thread drains the queue, combining all pending messages into as
+ * few vectored sends as possible.
+ *
+ * To bound the memory used, a sender is held back when more than the high
+ * watermark of bytes is queued, until the writer brings it back below the
+ * low watermark.
+ *
+ * \code
+ * Socket s(TCP);
+ * s.connect(Address("storage", 5000));
+ * SendQueue q(s);
+ * // from any number of threads:
+ * q.send(&reply, sizeof(reply));
+ * // when done:
+ * q.close();	// waits for all messages to be sent
+ * \endcode
+ *
+ * If sending fails, the writer stops and the error is raised by the next
+ * call of send(), flush() or close(). The socket must stay valid, and
+ * must not be used for sending by others, until close() has returned.
+ *
+ * Posix only.
+ */
+class NKFNET_API SendQueue {
+public:
+	/**
+	 * Creates a new send queue, and starts its writer thread.
+	 *
+	 * \param	sock			The (blocking) socket to send on.
+	 * \param	highWatermark	Queued bytes above which senders are held back.
+	 * \param	lowWatermark	Queued bytes below which senders may continue.
+	 */
+	SendQueue(Socket & sock, size_t highWatermark = 4 * 1024 * 1024,
+			size_t lowWatermark = 1024 * 1024);
+
+	/**
+	 * Queues a message for sending. The data is copied. Blocks while the
+	 * queue is above its high watermark.
+	 *
+	 * \param	buf		The buffer to send.
+	 * \param	len		The length of the buffer in bytes.
+	 */
+	void	send(const void * buf, size_t len);
+
+	/**
+	 * Queues a message for sending, unless the queue is above its high
+	 * watermark.
+	 *
+	 * \param	buf		The buffer to send.
+	 * \param	len		The length of the buffer in bytes.
+	 *
+	 * \return			true if the message was queued, false if held back.
+	 */
+	bool	trySend(const void * buf, size_t len);
+
+	/**
+	 * Changes the watermarks.
+	 *
+	 * \param	high	Queued bytes above which senders are held back.
+	 * \param	low		Queued bytes below which senders may continue.
+	 */
+	void	setWatermarks(size_t high, size_t low);
+
+	/**
+	 * Returns the number of bytes queued and not yet sent.
+	 *
+	 * \return	The number of bytes queued.
+	 */
+	size_t	queued();
+
+	/**
+	 * Waits until all messages queued so far have been sent.
+	 */
+	void	flush();
+
+	/**
+	 * Waits until all messages have been sent, and stops the writer. After
+	 * this no more messages can be sent. Calling close() multiple times has
+	 * no effect.
+	 */
+	void	close();
+
+	/**
+	 * Closes the queue, see close(). Errors are ignored.
+	 */
+	virtual ~SendQueue();
+
+private:
+	struct Message {
+		size_t	len;
+		char	data[1];
+	};
+
+	void	enqueue(const void * buf, size_t len);
+
+	void	run();
+
+	void	raiseError();
+
+	SendQueue(const SendQueue &);
+
+	SendQueue & operator=(const SendQueue &);
+
+	Socket &				_sock;
+
+	MpscQueue<Message*>		_queue;
+
+	std::atomic<size_t>		_queued;
+
+	std::atomic<size_t>		_high;
+
+	std::atomic<size_t>		_low;
+
+	std::atomic<bool>		_throttled;
+
+	std::atomic<bool>		_writerIdle;
+
+	std::atomic<bool>		_closing;
+
+	std::atomic<int>		_error;
+
+	std::atomic<int>		_waiters;
+
+	std::mutex				_lock;
+
+	std::condition_variable	_wakeWriter;
+
+	std::condition_variable	_wakeSenders;
+
+	std::thread				_writer;
+};
+
+END_NKF_NET
+
+#endif /* SENDQUEUE_H_ */
@@ -0,0 +1,400 @@
+/*
+ * ShmChannel.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "ShmChannel.h"
+#include "SocketException.h"
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <poll.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+
+START_NKF_NET
+
+/*
+ * Layout of the shared memory: a header followed by the ring buffer.
+ *
+ * Senders reserve space by advancing 'head', copy their message, and then
+ * publish it by advancing 'commit'. Messages are published in order, so a
+ * sender waits (shortly) for earlier senders still copying. The receiver
+ * reads up to 'commit' and advances 'tail'. Each position lives in its
+ * own cache line.
+ *
+ * Every message has an 8 byte record header and is padded to 8 bytes. A
+ * message never wraps: if it does not fit at the end of the ring, a pad
+ * record fills up the remainder and the message starts at the beginning.
+ */
+
+static const uint32_t	SHM_MAGIC		= 0x4e4b4653;	// "NKFS"
+static const uint32_t	SHM_VERSION		= 1;
+static const uint32_t	SHM_PAD			= 1;
+static const size_t		SHM_LINE		= 64;
+
+struct ShmChannel::Header {
+	uint32_t				magic;
+	uint32_t				version;
+	uint64_t				capacity;
+	char					pad0[SHM_LINE - 16];
+	std::atomic<uint64_t>	head;
+	char					pad1[SHM_LINE - 8];
+	std::atomic<uint64_t>	commit;
+	char					pad2[SHM_LINE - 8];
+	std::atomic<uint64_t>	tail;
+	char					pad3[SHM_LINE - 8];
+	std::atomic<uint32_t>	receiverWaiting;
+	std::atomic<uint32_t>	sendersWaiting;
+	char					pad4[SHM_LINE - 8];
+};
+
+struct Record {
+	uint32_t	len;
+	uint32_t	flags;
+};
+
+static inline size_t recordSize(size_t len) {
+	return (sizeof(Record) + len + 7) & ~static_cast<size_t> (7);
+}
+
+static void signal(SOCKET event) {
+	uint64_t one = 1;
+	if (::write(event, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		SocketException::raiseLastError();
+}
+
+static void drain(SOCKET event) {
+	uint64_t value;
+	if (::read(event, &value, sizeof(value)) < 0 && errno != EAGAIN)
+		SocketException::raiseLastError();
+}
+
+// --------------------------------------------------------------------------
+// ShmChannel
+// --------------------------------------------------------------------------
+
+ShmChannel::ShmChannel(size_t capacity) :
+	_memory(INVALID_SOCKET),
+	_dataEvent(INVALID_SOCKET),
+	_spaceEvent(INVALID_SOCKET),
+	_header(NULL),
+	_ring(NULL),
+	_mask(0),
+	_mapSize(0),
+	_peeked(0),
+	_blocking(true) {
+
+	size_t cap = 4096;
+	while (cap < capacity) cap <<= 1;
+
+	_memory = ::memfd_create("nkf-shmchannel", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (_memory == INVALID_SOCKET) SocketException::raiseLastError();
+
+	// sealed, so the peer can not shrink the segment under our mapping
+	if (::ftruncate(_memory, sizeof(Header) + cap) != 0
+			|| ::fcntl(_memory, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+		int code = errno;
+		::close(_memory);
+		throw SocketException(strerror(code), code);
+	}
+
+	_dataEvent = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	_spaceEvent = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (_dataEvent == INVALID_SOCKET || _spaceEvent == INVALID_SOCKET) {
+		int code = errno;
+		::close(_memory);
+		if (_dataEvent != INVALID_SOCKET) ::close(_dataEvent);
+		throw SocketException(strerror(code), code);
+	}
+
+	void * mem = ::mmap(NULL, sizeof(Header) + cap, PROT_READ | PROT_WRITE, MAP_SHARED, _memory, 0);
+	if (mem == MAP_FAILED) {
+		int code = errno;
+		::close(_memory);
+		::close(_dataEvent);
+		::close(_spaceEvent);
+		throw SocketException(strerror(code), code);
+	}
+
+	_header = new (mem) Header();
+	_header->capacity = cap;
+	_header->head = 0;
+	_header->commit = 0;
+	_header->tail = 0;
+	_header->receiverWaiting = 0;
+	_header->sendersWaiting = 0;
+	_header->version = SHM_VERSION;
+	_header->magic = SHM_MAGIC;
+
+	_mapSize = sizeof(Header) + cap;
+	_ring = static_cast<char*> (mem) + sizeof(Header);
+	_mask = cap - 1;
+}
+
+// --------------------------------------------------------------------------
+
+ShmChannel::ShmChannel(SOCKET memory, SOCKET dataEvent, SOCKET spaceEvent) :
+	_memory(memory),
+	_dataEvent(dataEvent),
+	_spaceEvent(spaceEvent),
+	_header(NULL),
+	_ring(NULL),
+	_mask(0),
+	_mapSize(0),
+	_peeked(0),
+	_blocking(true) {
+	map();
+}
+
+// --------------------------------------------------------------------------
+
+void ShmChannel::map() {
+	struct {
+		uint32_t	magic;
+		uint32_t	version;
+		uint64_t	capacity;
+	} prefix;
+	if (::pread(_memory, &prefix, sizeof(prefix), 0) != static_cast<ssize_t> (sizeof(prefix))
+			|| prefix.magic != SHM_MAGIC || prefix.version != SHM_VERSION) {
+		throw SocketException("Not a shared memory channel", EINVAL);
+	}
+
+	// the capacity comes from the peer, it must fit the segment
+	struct stat st;
+	if (::fstat(_memory, &st) != 0) SocketException::raiseLastError();
+	uint64_t size = st.st_size;
+	if (prefix.capacity < 4096 || (prefix.capacity & (prefix.capacity - 1)) != 0
+			|| size < sizeof(Header) || prefix.capacity > size - sizeof(Header)) {
+		throw SocketException("Invalid shared memory channel capacity", EINVAL);
+	}
+	int seals = ::fcntl(_memory, F_GET_SEALS);
+	if (seals < 0 || (seals & F_SEAL_SHRINK) == 0)
+		throw SocketException("Shared memory channel not sealed", EINVAL);
+
+	_mapSize = sizeof(Header) + prefix.capacity;
+	void * mem = ::mmap(NULL, _mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, _memory, 0);
+	if (mem == MAP_FAILED) SocketException::raiseLastError();
+
+	_header = static_cast<Header*> (mem);
+	_ring = static_cast<char*> (mem) + sizeof(Header);
+	_mask = prefix.capacity - 1;
+}
+
+// --------------------------------------------------------------------------
+
+void ShmChannel::shareOver(Socket & sock) {
+	SOCKET handles[3] = { _memory, _dataEvent, _spaceEvent };
+	char tag = 'S';
+	sock.sendHandles(&tag, 1, handles, 3);
+}
+
+// --------------------------------------------------------------------------
+
+ShmChannel* ShmChannel::attach(Socket & sock) {
+	SOCKET handles[3];
+	size_t count = 3;
+	char tag = 0;
+	sock.receiveHandles(&tag, 1, handles, &count);
+	if (tag != 'S' || count != 3) {
+		for (size_t i = 0; i < count; ++i) ::close(handles[i]);
+		throw SocketException("No shared memory channel received", EPROTO);
+	}
+
+	try {
+		return new ShmChannel(handles[0], handles[1], handles[2]);
+	} catch (const SocketException &) {
+		for (size_t i = 0; i < count; ++i) ::close(handles[i]);
+		throw;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+size_t ShmChannel::send(const void * buf, size_t len) {
+	size_t cap = _mask + 1;
+	size_t need = recordSize(len);
+	if (need > cap / 2)
+		throw SocketException("Message too long for shared memory channel", EMSGSIZE);
+
+	// reserve
+	uint64_t head, pad;
+	while (true) {
+		head = _header->head.load(std::memory_order_relaxed);
+		size_t offset = head & _mask;
+		pad = cap - offset < need ? cap - offset : 0;
+		uint64_t tail = _header->tail.load(std::memory_order_acquire);
+		if (head + pad + need - tail > cap) {
+			if (!_blocking) return 0;
+			waitForSpace();
+			continue;
+		}
+		if (_header->head.compare_exchange_weak(head, head + pad + need,
+				std::memory_order_relaxed))
+			break;
+	}
+
+	// write
+	if (pad > 0) {
+		Record * rec = reinterpret_cast<Record*> (_ring + (head & _mask));
+		rec->len = 0;
+		rec->flags = SHM_PAD;
+	}
+	Record * rec = reinterpret_cast<Record*> (_ring + ((head + pad) & _mask));
+	rec->len = len;
+	rec->flags = 0;
+	memcpy(rec + 1, buf, len);
+
+	// publish in order
+	while (_header->commit.load(std::memory_order_acquire) != head) {
+		sched_yield();
+	}
+	_header->commit.store(head + pad + need, std::memory_order_release);
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (_header->receiverWaiting.load(std::memory_order_relaxed)) {
+		signal(_dataEvent);
+	}
+	return len;
+}
+
+// --------------------------------------------------------------------------
+
+size_t ShmChannel::receive(void * buf, size_t len) {
+	size_t msgLen;
+	const void * msg = peek(&msgLen);
+	if (msg == NULL) return 0;
+	if (msgLen < len) len = msgLen;
+	memcpy(buf, msg, len);
+	release();
+	return len;
+}
+
+// --------------------------------------------------------------------------
+
+const void * ShmChannel::peek(size_t * len) {
+	while (true) {
+		uint64_t tail = _header->tail.load(std::memory_order_relaxed);
+		uint64_t commit = _header->commit.load(std::memory_order_acquire);
+
+		if (tail != commit) {
+			size_t offset = tail & _mask;
+			if (offset + sizeof(Record) > _mask + 1)
+				throw SocketException("Corrupt shared memory channel", EPROTO);
+			Record * rec = reinterpret_cast<Record*> (_ring + offset);
+			if (rec->flags & SHM_PAD) {
+				_header->tail.store(tail + _mask + 1 - offset, std::memory_order_release);
+				continue;
+			}
+			uint32_t length = rec->len;	// read once, the peer may change it
+			if (recordSize(length) > _mask + 1 - offset)
+				throw SocketException("Corrupt shared memory channel", EPROTO);
+			if (_header->receiverWaiting.load(std::memory_order_relaxed)) {
+				_header->receiverWaiting.store(0, std::memory_order_relaxed);
+				drain(_dataEvent);
+			}
+			_peeked = recordSize(length);
+			(*len) = length;
+			return rec + 1;
+		}
+
+		if (!waitForData(_blocking)) return NULL;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void ShmChannel::release() {
+	if (_peeked == 0) return;
+
+	_header->tail.fetch_add(_peeked, std::memory_order_release);
+	_peeked = 0;
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (_header->sendersWaiting.load(std::memory_order_relaxed)) {
+		signal(_spaceEvent);
+	}
+}
+
+// --------------------------------------------------------------------------
+
+bool ShmChannel::waitForData(bool blocking) {
+	_header->receiverWaiting.store(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// Clear stale wakeups first, then check again: a sender may have
+	// published before seeing the flag.
+	drain(_dataEvent);
+	if (_header->commit.load(std::memory_order_acquire)
+			!= _header->tail.load(std::memory_order_relaxed)) {
+		return true;
+	}
+	if (!blocking) return false;
+
+	pollfd pfd;
+	pfd.fd = _dataEvent;
+	pfd.events = POLLIN;
+	if (::poll(&pfd, 1, -1) < 0 && errno != EINTR)
+		SocketException::raiseLastError();
+	drain(_dataEvent);
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+void ShmChannel::waitForSpace() {
+	_header->sendersWaiting.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// Several senders may share the event, so do not wait forever for a
+	// wakeup another sender may have consumed.
+	pollfd pfd;
+	pfd.fd = _spaceEvent;
+	pfd.events = POLLIN;
+	int r = ::poll(&pfd, 1, 1);
+	if (r > 0) drain(_spaceEvent);
+
+	_header->sendersWaiting.fetch_sub(1, std::memory_order_relaxed);
+	if (r < 0 && errno != EINTR)
+		SocketException::raiseLastError();
+}
+
+// --------------------------------------------------------------------------
+
+void ShmChannel::setBlocking(bool blocking) {
+	_blocking = blocking;
+}
+
+// --------------------------------------------------------------------------
+
+SOCKET ShmChannel::handle() {
+	return _dataEvent;
+}
+
+// --------------------------------------------------------------------------
+
+size_t ShmChannel::capacity() {
+	return _mask + 1;
+}
+
+// --------------------------------------------------------------------------
+
+size_t ShmChannel::queued() {
+	return _header->commit.load(std::memory_order_relaxed)
+			- _header->tail.load(std::memory_order_relaxed);
+}
+
+// --------------------------------------------------------------------------
+
+ShmChannel::~ShmChannel() {
+	if (_header != NULL) ::munmap(_header, _mapSize);
+	::close(_memory);
+	::close(_dataEvent);
+	::close(_spaceEvent);
+}
+
+END_NKF_NET
@@ -0,0 +1,203 @@
+/*
+ * ShmChannel.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef SHMCHANNEL_H_
+#define SHMCHANNEL_H_
+
+#include "net.h"
+#include "Socket.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * ShmChannel is a message channel between processes on the same host,
+ * through a ring buffer in shared memory. Messages are copied once by the
+ * sender, and can be read in place by the receiver using peek() and
+ * release(), so no data passes through the kernel at all.
+ *
+ * The channel supports any number of senders and a single receiver. Like
+ * a UNIX_SEQPACKET socket, message boundaries are preserved. Senders and
+ * the receiver are woken through eventfd handles, and the receive handle
+ * can be added to a SocketSet to multiplex the channel with real sockets.
+ *
+ * The process creating the channel passes it on to other processes over a
+ * Unix domain socket:
+ *
+ * \code
+ * // readout process
+ * ShmChannel chan(16 * 1024 * 1024);
+ * chan.shareOver(*unixSock);
+ * chan.send(&hit, sizeof(hit));
+ *
+ * // online filter process
+ * ShmChannel * chan = ShmChannel::attach(*unixSock);
+ * size_t len;
+ * const void * msg;
+ * while ((msg = chan->peek(&len)) != NULL) {
+ *   process(msg, len);		// no copy
+ *   chan->release();
+ * }
+ * \endcode
+ *
+ * Linux only.
+ */
+class NKFNET_API ShmChannel {
+public:
+	/**
+	 * Creates a new channel in anonymous shared memory.
+	 *
+	 * \param	capacity	The size of the ring buffer in bytes, rounded up
+	 * 						to a power of two. The largest message is half
+	 * 						the capacity, minus 8 bytes.
+	 */
+	ShmChannel(size_t capacity);
+
+	/**
+	 * Attaches to a channel created by another process, using the handles
+	 * of the channel, e.g. as inherited after fork.
+	 *
+	 * \param	memory		The handle of the shared memory.
+	 * \param	dataEvent	The handle of the data event.
+	 * \param	spaceEvent	The handle of the space event.
+	 */
+	ShmChannel(SOCKET memory, SOCKET dataEvent, SOCKET spaceEvent);
+
+	/**
+	 * Passes the channel on to the peer of a connected Unix domain socket,
+	 * which should call attach().
+	 *
+	 * \param	sock	The Unix domain socket.
+	 */
+	void	shareOver(Socket & sock);
+
+	/**
+	 * Attaches to a channel shared by the peer of a connected Unix domain
+	 * socket using shareOver(). The shared memory must be sealed against
+	 * shrinking, and its capacity must fit it, else EINVAL is thrown.
+	 *
+	 * \param	sock	The Unix domain socket.
+	 *
+	 * \return			The channel, owned by the caller.
+	 */
+	static ShmChannel* attach(Socket & sock);
+
+	/**
+	 * Sends a message. Blocks while the ring buffer is full, unless the
+	 * channel is non-blocking.
+	 *
+	 * \param	buf		The buffer to send.
+	 * \param	len		The length of the buffer in bytes.
+	 *
+	 * \return			The number of bytes send, or 0 if the channel is
+	 * 					non-blocking and full.
+	 */
+	size_t	send(const void * buf, size_t len);
+
+	/**
+	 * Receives a message into the given buffer. A message larger than the
+	 * buffer is truncated. Blocks while no message is available, unless
+	 * the channel is non-blocking.
+	 *
+	 * \param	buf		The buffer to receive in.
+	 * \param	len		The length of the buffer in bytes.
+	 *
+	 * \return			The number of bytes received, or 0 if the channel is
+	 * 					non-blocking and empty.
+	 */
+	size_t	receive(void * buf, size_t len);
+
+	/**
+	 * Returns the next message in place, without copying. The message stays
+	 * valid until release() is called. Calling peek() again without release
+	 * returns the same message. Blocks while no message is available,
+	 * unless the channel is non-blocking.
+	 *
+	 * \param	len		Receives the length of the message.
+	 *
+	 * \return			The message, or NULL if the channel is non-blocking
+	 * 					and empty.
+	 */
+	const void * peek(size_t * len);
+
+	/**
+	 * Releases the message returned by peek(), making room for new messages.
+	 */
+	void	release();
+
+	/**
+	 * Sets blocking operation on or off.
+	 *
+	 * \param	blocking	If true, send and receive will block.
+	 */
+	void	setBlocking(bool blocking);
+
+	/**
+	 * Returns the handle which becomes readable when messages are available,
+	 * to be added to a SocketSet by the receiver. The receiver must have
+	 * found the channel empty (peek returned NULL, or receive returned 0)
+	 * before waiting on the handle.
+	 *
+	 * \return	The data event handle.
+	 */
+	SOCKET	handle();
+
+	/**
+	 * Returns the capacity of the ring buffer in bytes.
+	 *
+	 * \return	The capacity.
+	 */
+	size_t	capacity();
+
+	/**
+	 * Returns the number of bytes currently queued, including headers.
+	 *
+	 * \return	The number of bytes queued.
+	 */
+	size_t	queued();
+
+	/**
+	 * Detaches from the channel.
+	 */
+	virtual ~ShmChannel();
+
+private:
+	struct Header;
+
+	void	map();
+
+	bool	waitForData(bool blocking);
+
+	void	waitForSpace();
+
+	ShmChannel(const ShmChannel &);
+
+	ShmChannel & operator=(const ShmChannel &);
+
+	SOCKET		_memory;
+
+	SOCKET		_dataEvent;
+
+	SOCKET		_spaceEvent;
+
+	Header *	_header;
+
+	char *		_ring;
+
+	size_t		_mask;
+
+	size_t		_mapSize;
+
+	size_t		_peeked;
+
+	bool		_blocking;
+};
+
+END_NKF_NET
+
+#endif /* SHMCHANNEL_H_ */
@@ -0,0 +1,85 @@
+/*
+ * SignalHandle.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "SignalHandle.h"
+#include "SocketException.h"
+#include <cstring>
+#include <pthread.h>
+
+#ifdef __linux__
+#include <sys/signalfd.h>
+#endif
+
+START_NKF_NET
+
+// --------------------------------------------------------------------------
+// SignalHandle
+// --------------------------------------------------------------------------
+
+SignalHandle::SignalHandle() :
+	_fd(-1) {
+#ifdef __linux__
+	sigemptyset(&_mask);
+	_fd = ::signalfd(-1, &_mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (_fd < 0)
+		SocketException::raiseLastError();
+#else
+	throw SocketException("Signal handles not supported on this platform", 0);
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+void SignalHandle::add(int signal) {
+#ifdef __linux__
+	sigset_t mask = _mask;
+	if (sigaddset(&mask, signal) != 0)
+		SocketException::raiseLastError();
+
+	sigset_t block;
+	sigemptyset(&block);
+	sigaddset(&block, signal);
+	int rc = pthread_sigmask(SIG_BLOCK, &block, NULL);
+	if (rc != 0)
+		throw SocketException(strerror(rc), rc);
+
+	if (::signalfd(_fd, &mask, 0) < 0)
+		SocketException::raiseLastError();
+	_mask = mask;
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+int SignalHandle::read() {
+#ifdef __linux__
+	signalfd_siginfo info;
+	ssize_t bytes = ::read(_fd, &info, sizeof(info));
+	if (bytes < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return 0;
+		SocketException::raiseLastError();
+	}
+	return bytes == sizeof(info) ? info.ssi_signo : 0;
+#else
+	return 0;
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+SOCKET SignalHandle::handle() {
+	return _fd;
+}
+
+// --------------------------------------------------------------------------
+
+SignalHandle::~SignalHandle() {
+	if (_fd >= 0) ::close(_fd);
+}
+
+END_NKF_NET
@@ -0,0 +1,94 @@
+/*
+ * SignalHandle.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef SIGNALHANDLE_H_
+#define SIGNALHANDLE_H_
+
+#include "net.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * SignalHandle turns signals into a readable handle (signalfd), so an I/O
+ * thread can handle e.g. SIGTERM in its SocketSet loop, instead of having
+ * a signal handler interrupt blocking calls with EINTR.
+ *
+ * The signals are blocked for normal delivery. Signal masks are per
+ * thread and inherited, so create the SignalHandle in the main thread
+ * before starting any other threads, or the signal may still be
+ * delivered to a thread which does not block it.
+ *
+ * \code
+ * SignalHandle signals;
+ * signals.add(SIGINT);
+ * signals.add(SIGTERM);
+ * // start threads ...
+ * while (running) {
+ *   SocketSet read(sock);
+ *   read.set(signals.handle());
+ *   SocketSet::select(&read, NULL, NULL, FOREVER);
+ *   if (read.isSet(signals.handle())) {
+ *     int sig;
+ *     while ((sig = signals.read()) != 0) {
+ *       if (sig == SIGTERM || sig == SIGINT) running = false;
+ *     }
+ *   }
+ *   // ...
+ * }
+ * \endcode
+ *
+ * Linux only.
+ */
+class NKFNET_API SignalHandle {
+public:
+	/**
+	 * Creates a new signal handle, without any signals.
+	 */
+	SignalHandle();
+
+	/**
+	 * Adds a signal, and blocks its normal delivery in the calling thread.
+	 *
+	 * \param	signal	The signal number, e.g. SIGTERM.
+	 */
+	void	add(int signal);
+
+	/**
+	 * Reads the next pending signal, without blocking.
+	 *
+	 * \return	The signal number, or 0 if no signal is pending.
+	 */
+	int		read();
+
+	/**
+	 * Returns the handle which becomes readable when a signal is pending,
+	 * to be added to the read set of a SocketSet.
+	 *
+	 * \return	The handle.
+	 */
+	SOCKET	handle();
+
+	/**
+	 * Closes the handle. The signals stay blocked.
+	 */
+	virtual ~SignalHandle();
+
+private:
+	SignalHandle(const SignalHandle &);
+
+	SignalHandle & operator=(const SignalHandle &);
+
+	int			_fd;
+
+	sigset_t	_mask;
+};
+
+END_NKF_NET
+
+#endif /* SIGNALHANDLE_H_ */
@@ -10,45 +10,124 @@
 
 #include "Socket.h"
 #include "SocketException.h"
+#include "SocketSet.h"
+#include "Crc32c.h"
+#include "PerfCounters.h"
+#include "SocketTrace.h"
+#include <cstring>
+#include <utility>
+
+#ifdef __linux__
+#include <netinet/udp.h>
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT		103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO			104
+#endif
+#include <linux/net_tstamp.h>
+#include <sys/sendfile.h>
+#include <time.h>
+#endif
 
 START_NKF_NET
 
+// The trace argument of an address: the IPv4 address and port
+static unsigned long long traceAddress(const sockaddr * addr) {
+	if (addr->sa_family != AF_INET) return 0;
+	const sockaddr_in * in = reinterpret_cast<const sockaddr_in*> (addr);
+	return static_cast<unsigned long long> (ntohl(in->sin_addr.s_addr)) << 16 | ntohs(in->sin_port);
+}
+
 // --------------------------------------------------------------------------
 // Socket
 // --------------------------------------------------------------------------
 
 Socket::Socket(SocketType st) :
 	_handle(INVALID_SOCKET),
+	_trackDrops(false),
+	_drops(0),
+	_launchTimes(false),
+	_segmentSupport(-1),
+	_checksums(false),
+	_checksumErrors(0),
 	_local(Address::ANY),
 	_remote(Address::ANY) {
 	INC_WS_REF
 
-	int af = AF_INET; // address family, currently only IP v4 is supported
-	int type;
-	int proto = 0;
+	int af, type, proto;
+	typeToNative(st, &af, &type, &proto);
+
+	TraceScope trace(TRACE_OPEN, INVALID_SOCKET, st);
+	_handle = trace.result(socket(af, type, proto));
+
+	if (_handle == INVALID_SOCKET) {
+		DEC_WS_REF
+		SocketException::raiseLastError();
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void Socket::typeToNative(SocketType st, int * af, int * type, int * proto) {
+	(*af) = AF_INET; // currently only IP v4 is supported
+	(*proto) = 0;
 
 	switch (st) {
 	case TCP:
-		type = SOCK_STREAM;
-		proto = IPPROTO_TCP;
+		(*type) = SOCK_STREAM;
+		(*proto) = IPPROTO_TCP;
 		break;
 	case UDP:
-		type = SOCK_DGRAM;
-		proto = IPPROTO_UDP;
+		(*type) = SOCK_DGRAM;
+		(*proto) = IPPROTO_UDP;
+		break;
+	case UNIX_STREAM:
+		(*af) = AF_UNIX;
+		(*type) = SOCK_STREAM;
+		break;
+	case UNIX_DGRAM:
+		(*af) = AF_UNIX;
+		(*type) = SOCK_DGRAM;
+		break;
+	case UNIX_SEQPACKET:
+		(*af) = AF_UNIX;
+		(*type) = SOCK_SEQPACKET;
 		break;
 	default:
 		throw SocketException("Unknown socket type", 0);
 	}
+}
+
+// --------------------------------------------------------------------------
 
-	_handle = socket(af, type, proto);
+void Socket::createPair(SocketType st, Socket ** first, Socket ** second) {
+#ifdef WIN32_API
+	throw SocketException("Socket pairs not supported on this platform", 0);
+#else
+	int af, type, proto;
+	typeToNative(st, &af, &type, &proto);
+	if (af != AF_UNIX)
+		throw SocketException("Socket pairs must be of a Unix domain type", EINVAL);
 
-	if (_handle == INVALID_SOCKET) {
-		SocketException::raiseLastError();
-	}
+	SOCKET handles[2];
+	RoR(::socketpair(af, type, proto, handles));
+
+	(*first) = new Socket(handles[0]);
+	(*second) = new Socket(handles[1]);
+#endif
 }
 
+// --------------------------------------------------------------------------
+
 Socket::Socket(SOCKET handle) :
 		_handle(handle),
+		_trackDrops(false),
+		_drops(0),
+		_launchTimes(false),
+		_segmentSupport(-1),
+		_checksums(false),
+		_checksumErrors(0),
 		_local(Address::ANY),
 		_remote(Address::ANY) {
 
@@ -74,6 +153,7 @@ void Socket::close() {
 	if (_handle == INVALID_SOCKET)
 		return;
 
+	TraceScope trace(TRACE_CLOSE, _handle, 0);
 #ifdef WIN32_API
 	closesocket(_handle);
 #else
@@ -98,12 +178,14 @@ void Socket::setOption(int level, int option, const void * value, size_t size) {
 		value = &llw;
 	}
 #endif
+	TraceScope trace(TRACE_SET_OPTION, _handle, static_cast<unsigned long long> (level) << 32 | option);
 	RoR(::setsockopt(_handle, level, option, static_cast<const char*>(value), size));
 }
 
 // -----------------------------------------------------------------------------
 
 void Socket::getOption(int level, int option, void * value, size_t * size) {
+	TraceScope trace(TRACE_GET_OPTION, _handle, static_cast<unsigned long long> (level) << 32 | option);
 	socklen_t isize = (*size);	// patch it up safely, will else fail on 64 bit systems
 	RoR(::getsockopt(_handle, level, option, static_cast<char*>(value), &isize));
 	(*size) = isize;
@@ -127,13 +209,94 @@ void Socket::getOption(int level, int option, void * value, size_t * size) {
 // --------------------------------------------------------------------------
 
 void Socket::connect(const Address & addr) {
+	TraceScope trace(TRACE_CONNECT, _handle, traceAddress(addr._addr));
 	RoR(::connect(_handle, addr._addr, addr._addrSize));
 	_remote = addr;
 }
 
 // --------------------------------------------------------------------------
 
+void Socket::connect(const Address & addr, timeval timeout) {
+#ifdef WIN32_API
+	setBlocking(false);
+	bool blocking = true;
+#else
+	int flags = ::fcntl(_handle, F_GETFL, 0);
+	bool blocking = (flags & O_NONBLOCK) == 0;
+	if (blocking) setBlocking(false);
+#endif
+
+	try {
+		if (!beginConnect(addr)) {
+			SocketSet write(*this);
+			SocketSet error(*this);
+			if (SocketSet::select(NULL, &write, &error, timeout) == 0) {
+				throw SocketException("Connection timed out", ETIMEDOUT);
+			}
+			int code = connectError();
+			if (code != 0) {
+				throw SocketException(strerror(code), code);
+			}
+		}
+	} catch (const SocketException &) {
+		if (blocking) setBlocking(true);
+		throw;
+	}
+	if (blocking) setBlocking(true);
+}
+
+// --------------------------------------------------------------------------
+
+bool Socket::beginConnect(const Address & addr) {
+	TraceScope trace(TRACE_CONNECT, _handle, traceAddress(addr._addr));
+	_remote = addr;
+	if (::connect(_handle, addr._addr, addr._addrSize) == 0)
+		return true;
+#ifdef WIN32_API
+	if (WSAGetLastError() != WSAEWOULDBLOCK)
+#else
+	if (errno != EINPROGRESS)
+#endif
+	{
+		_remote = Address::ANY;
+		SocketException::raiseLastError();
+	}
+	return false;
+}
+
+// --------------------------------------------------------------------------
+
+int Socket::connectError() {
+	int code = getIntOption(SO_ERROR);
+	if (code != 0) _remote = Address::ANY;
+	return code;
+}
+
+// --------------------------------------------------------------------------
+
+size_t Socket::connect(const Address & addr, const void * buf, size_t len) {
+#ifdef MSG_FASTOPEN
+	ssize_t bytes;
+	{
+		TraceScope trace(TRACE_CONNECT, _handle, traceAddress(addr._addr));
+		bytes = trace.result(::sendto(_handle, static_cast<const char*> (buf), len, MSG_FASTOPEN,
+				addr._addr, addr._addrSize));
+		if (bytes < 0 && errno != EOPNOTSUPP)
+			SocketException::raiseLastError();
+	}
+	if (bytes >= 0) {
+		_remote = addr;
+		return bytes;
+	}
+#endif
+	connect(addr);
+	return send(buf, len);
+}
+
+// --------------------------------------------------------------------------
+
 void Socket::bind(const Address & addr) {
+	TraceScope trace(TRACE_BIND, _handle, traceAddress(addr._addr));
 	RoR(::bind(_handle, addr._addr, addr._addrSize));
 	_local = addr;
 }
@@ -141,52 +304,557 @@ void Socket::bind(const Address & addr) {
 // --------------------------------------------------------------------------
 
 size_t Socket::send(const void * buf, size_t len) {
+	PerfRegion perf("Socket::send");
+	TraceScope trace(TRACE_SEND, _handle, len);
+	if (_checksums)
+		return trace.result(perf.bytes(sendChecked(buf, len, NULL)));
 	size_t bytes = ::send(_handle, static_cast<const char*> (buf), len, 0);
 	if (bytes == INVALID_SOCKET)
 		SocketException::raiseLastError();
-	return bytes;
+	return trace.result(perf.bytes(bytes));
 }
 
 // --------------------------------------------------------------------------
 
 size_t Socket::send(const void * buf, size_t len, const Address & addr) {
+	PerfRegion perf("Socket::send");
+	TraceScope trace(TRACE_SEND, _handle, len);
+	if (_checksums)
+		return trace.result(perf.bytes(sendChecked(buf, len, &addr)));
 	size_t bytes = ::sendto(_handle, static_cast<const char*> (buf), len, 0,
 			addr._addr, addr._addrSize);
 	if (bytes == INVALID_SOCKET)
 		SocketException::raiseLastError();
-	return bytes;
+	return trace.result(perf.bytes(bytes));
+}
+
+// --------------------------------------------------------------------------
+
+#ifndef WIN32_API
+size_t Socket::send(const iovec * vec, size_t count) {
+	TraceScope trace(TRACE_SEND_VECTOR, _handle, count);
+	msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = const_cast<iovec*> (vec);
+	msg.msg_iovlen = count;
+
+	ssize_t bytes = ::sendmsg(_handle, &msg, MSG_NOSIGNAL);
+	if (bytes < 0)
+		SocketException::raiseLastError();
+	return trace.result(bytes);
+}
+#endif
+
+// --------------------------------------------------------------------------
+
+/*
+ * With checksums, the CRC32C of the payload is sent as a trailer, from a
+ * separate buffer, and received in a separate buffer if the payload does
+ * not fill the caller's buffer. A truncated datagram can not be checked.
+ */
+
+static const size_t CRC_SIZE = 4;
+
+static inline void putTrailer(unsigned char * trailer, uint32_t crc) {
+	trailer[0] = static_cast<unsigned char> (crc);
+	trailer[1] = static_cast<unsigned char> (crc >> 8);
+	trailer[2] = static_cast<unsigned char> (crc >> 16);
+	trailer[3] = static_cast<unsigned char> (crc >> 24);
+}
+
+static bool checkTrailer(const void * buf, size_t len, const unsigned char * spill,
+		size_t bytes, size_t * payload) {
+	if (bytes < CRC_SIZE) return false;
+	const unsigned char * data = static_cast<const unsigned char*> (buf);
+	size_t n = bytes - CRC_SIZE;
+	uint32_t crc = 0;
+	for (size_t i = 0; i < CRC_SIZE; ++i) {
+		size_t pos = n + i;
+		crc |= static_cast<uint32_t> (pos < len ? data[pos] : spill[pos - len]) << (8 * i);
+	}
+	*payload = n;
+	return Crc32c::compute(data, n) == crc;
+}
+
+// --------------------------------------------------------------------------
+
+#ifndef WIN32_API
+size_t Socket::sendChecked(const void * buf, size_t len, const Address * addr) {
+	unsigned char trailer[CRC_SIZE];
+	putTrailer(trailer, Crc32c::compute(buf, len));
+
+	iovec iov[2];
+	iov[0].iov_base = const_cast<void*> (buf);
+	iov[0].iov_len = len;
+	iov[1].iov_base = trailer;
+	iov[1].iov_len = CRC_SIZE;
+
+	msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+	if (addr != NULL) {
+		msg.msg_name = addr->_addr;
+		msg.msg_namelen = addr->_addrSize;
+	}
+	ssize_t bytes = ::sendmsg(_handle, &msg, 0);
+	if (bytes < 0)
+		SocketException::raiseLastError();
+	return bytes > static_cast<ssize_t> (CRC_SIZE) ? bytes - CRC_SIZE : 0;
+}
+#else
+size_t Socket::sendChecked(const void * buf, size_t len, const Address * addr) {
+	throw SocketException("Checksums not supported on this platform", 0);
+}
+#endif
+
+// --------------------------------------------------------------------------
+
+size_t Socket::sendBatch(const Datagram * dgrams, size_t count) {
+	TraceScope trace(TRACE_SEND_BATCH, _handle, count);
+	size_t sent = 0;
+#ifdef __linux__
+	static const size_t BATCH = 64;		// datagrams per system call
+	mmsghdr msgs[BATCH];
+	iovec iov[2 * BATCH];
+	unsigned char trailers[BATCH][CRC_SIZE];
+
+	while (sent < count) {
+		size_t part = count - sent < BATCH ? count - sent : BATCH;
+		memset(msgs, 0, part * sizeof(mmsghdr));
+		for (size_t i = 0; i < part; ++i) {
+			const Datagram & dgram = dgrams[sent + i];
+			iov[2 * i].iov_base = const_cast<void*> (dgram.data);
+			iov[2 * i].iov_len = dgram.length;
+			msgs[i].msg_hdr.msg_iov = &iov[2 * i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			if (_checksums) {
+				putTrailer(trailers[i], Crc32c::compute(dgram.data, dgram.length));
+				iov[2 * i + 1].iov_base = trailers[i];
+				iov[2 * i + 1].iov_len = CRC_SIZE;
+				msgs[i].msg_hdr.msg_iovlen = 2;
+			}
+			if (dgram.addr != NULL) {
+				msgs[i].msg_hdr.msg_name = dgram.addr->_addr;
+				msgs[i].msg_hdr.msg_namelen = dgram.addr->_addrSize;
+			}
+		}
+
+		int done = ::sendmmsg(_handle, msgs, part, 0);
+		if (done < 0) {
+			// report what was sent, the error will come back on retry
+			if (sent > 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+				break;
+			SocketException::raiseLastError();
+		}
+		sent += done;
+	}
+#else
+	for (; sent < count; ++sent) {
+		const Datagram & dgram = dgrams[sent];
+		if (dgram.addr != NULL)
+			send(dgram.data, dgram.length, *dgram.addr);
+		else
+			send(dgram.data, dgram.length);
+	}
+#endif
+	return trace.result(sent);
+}
+
+// --------------------------------------------------------------------------
+
+size_t Socket::sendFile(int fd, unsigned long long offset, size_t count) {
+#if defined(WIN32_API)
+	throw SocketException("Sending files not supported on this platform", 0);
+#elif defined(__linux__)
+	TraceScope trace(TRACE_SEND_FILE, _handle, count);
+	off_t off = offset;
+	size_t sent = 0;
+	while (sent < count) {
+		ssize_t bytes = ::sendfile(_handle, fd, &off, count - sent);
+		if (bytes < 0) {
+			if (sent > 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+				break;
+			SocketException::raiseLastError();
+		}
+		if (bytes == 0) break;	// end of file
+		sent += bytes;
+	}
+	return trace.result(sent);
+#else
+	char buf[64 * 1024];
+	size_t sent = 0;
+	while (sent < count) {
+		size_t part = count - sent < sizeof(buf) ? count - sent : sizeof(buf);
+		ssize_t bytes = ::pread(fd, buf, part, offset + sent);
+		if (bytes < 0)
+			SocketException::raiseLastError();
+		if (bytes == 0) break;
+		size_t done = 0;
+		while (done < static_cast<size_t> (bytes)) {
+			done += send(buf + done, bytes - done);
+		}
+		sent += bytes;
+	}
+	return sent;
+#endif
+}
+
+bool Socket::segmentationSupported() {
+#ifdef UDP_SEGMENT
+	if (_segmentSupport < 0) {
+		int value;
+		socklen_t size = sizeof(value);
+		_segmentSupport = ::getsockopt(_handle, SOL_UDP, UDP_SEGMENT, &value, &size) == 0 ? 1 : 0;
+	}
+	return _segmentSupport == 1;
+#else
+	return false;
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+size_t Socket::sendSegmented(const void * buf, size_t len, size_t segmentSize, const Address & addr) {
+	if (segmentSize == 0)
+		throw SocketException("Segment size must be larger than 0", EINVAL);
+
+	TraceScope trace(TRACE_SEND_SEGMENTED, _handle, len);
+	const char * data = static_cast<const char*> (buf);
+	size_t sent = 0;
+
+#ifdef UDP_SEGMENT
+	if (segmentationSupported() && len > segmentSize) {
+		// The kernel accepts at most 64 segments and 64 KiB per call
+		size_t segments = 65507 / segmentSize;
+		if (segments > 64) segments = 64;
+		size_t chunk = segments * segmentSize;
+
+		char control[CMSG_SPACE(sizeof(uint16_t))];
+		iovec iov;
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = addr._addr;
+		msg.msg_namelen = addr._addrSize;
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+
+		while (chunk > 0 && sent < len) {
+			size_t part = len - sent < chunk ? len - sent : chunk;
+			iov.iov_base = const_cast<char*> (data + sent);
+			iov.iov_len = part;
+
+			memset(control, 0, sizeof(control));
+			msg.msg_control = control;
+			msg.msg_controllen = sizeof(control);
+			cmsghdr * cmsg = CMSG_FIRSTHDR(&msg);
+			cmsg->cmsg_level = SOL_UDP;
+			cmsg->cmsg_type = UDP_SEGMENT;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+			uint16_t gso = segmentSize;
+			memcpy(CMSG_DATA(cmsg), &gso, sizeof(gso));
+
+			ssize_t bytes = ::sendmsg(_handle, &msg, 0);
+			if (bytes < 0) {
+				// EIO is returned if the device can not offload checksums,
+				// fall back to sending each datagram separately.
+				if (errno != EIO || sent > 0)
+					SocketException::raiseLastError();
+				_segmentSupport = 0;
+				break;
+			}
+			sent += bytes;
+		}
+	}
+#endif
+
+	while (sent < len) {
+		size_t part = len - sent < segmentSize ? len - sent : segmentSize;
+		sent += send(data + sent, part, addr);
+	}
+	return trace.result(sent);
+}
+
+// --------------------------------------------------------------------------
+
+bool Socket::setPacingRate(unsigned long long bytesPerSecond) {
+#ifdef SO_MAX_PACING_RATE
+	uint64_t value = bytesPerSecond == 0 ? ~0ULL : bytesPerSecond;
+	if (::setsockopt(_handle, SOL_SOCKET, SO_MAX_PACING_RATE, &value, sizeof(value)) == 0)
+		return true;
+	// kernels before 4.20 only accept 32 bits
+	uint32_t value32 = value > 0xFFFFFFFEULL ? ~0U : static_cast<uint32_t> (value);
+	if (::setsockopt(_handle, SOL_SOCKET, SO_MAX_PACING_RATE, &value32, sizeof(value32)) == 0)
+		return true;
+	if (errno != ENOPROTOOPT && errno != EINVAL)
+		SocketException::raiseLastError();
+#endif
+	return false;
+}
+
+// --------------------------------------------------------------------------
+
+bool Socket::setLaunchTimes(bool enable) {
+	if (!enable) {
+		// the kernel can not turn SO_TXTIME off, just stop using it
+		_launchTimes = false;
+		return true;
+	}
+#ifdef SO_TXTIME
+	sock_txtime config;
+	memset(&config, 0, sizeof(config));
+	config.clockid = CLOCK_MONOTONIC;
+	if (::setsockopt(_handle, SOL_SOCKET, SO_TXTIME, &config, sizeof(config)) == 0) {
+		_launchTimes = true;
+		return true;
+	}
+	if (errno != ENOPROTOOPT && errno != EINVAL)
+		SocketException::raiseLastError();
+#endif
+	return false;
+}
+
+// --------------------------------------------------------------------------
+
+size_t Socket::sendAt(const void * buf, size_t len, const Address & addr, unsigned long long launchTime) {
+#ifdef SO_TXTIME
+	if (_launchTimes) {
+		TraceScope trace(TRACE_SEND_AT, _handle, len);
+		iovec iov;
+		iov.iov_base = const_cast<void*> (buf);
+		iov.iov_len = len;
+
+		char control[CMSG_SPACE(sizeof(uint64_t))];
+		memset(control, 0, sizeof(control));
+
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = addr._addr;
+		msg.msg_namelen = addr._addrSize;
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		cmsghdr * cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_TXTIME;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+		uint64_t when = launchTime;
+		memcpy(CMSG_DATA(cmsg), &when, sizeof(when));
+
+		ssize_t bytes = ::sendmsg(_handle, &msg, MSG_NOSIGNAL);
+		if (bytes < 0)
+			SocketException::raiseLastError();
+		return trace.result(bytes);
+	}
+#endif
+	return send(buf, len, addr);
 }
 
 // --------------------------------------------------------------------------
 
 size_t Socket::receive(void * buf, size_t len) {
+	PerfRegion perf("Socket::receive");
+	TraceScope trace(TRACE_RECEIVE, _handle, len);
+	if (_trackDrops || _checksums)
+		return trace.result(perf.bytes(receiveMessage(buf, len, NULL)));
 	size_t bytes = ::recv(_handle, static_cast<char*> (buf), len, 0);
 	if (bytes == INVALID_SOCKET)
 		SocketException::raiseLastError();
-	return bytes;
+	return trace.result(perf.bytes(bytes));
 }
 
 // --------------------------------------------------------------------------
 
 size_t Socket::receive(void * buf, size_t len, Address * addr) {
-	size_t bytes = ::recvfrom(_handle, static_cast<char*> (buf), len, 0, addr->_addr, NULL);
+	PerfRegion perf("Socket::receive");
+	TraceScope trace(TRACE_RECEIVE, _handle, len);
+	if (_trackDrops || _checksums)
+		return trace.result(perf.bytes(receiveMessage(buf, len, addr)));
+	socklen_t size = addr->_addrMaxSize;
+	size_t bytes = ::recvfrom(_handle, static_cast<char*> (buf), len, 0, addr->_addr, &size);
 	if (bytes == INVALID_SOCKET)
 		SocketException::raiseLastError();
+	addr->_addrSize = size;
+	return trace.result(perf.bytes(bytes));
+}
+
+// --------------------------------------------------------------------------
+
+bool Socket::setReceiveCoalescing(bool enable) {
+#ifdef UDP_GRO
+	int value = enable ? 1 : 0;
+	if (::setsockopt(_handle, SOL_UDP, UDP_GRO, &value, sizeof(value)) == 0)
+		return true;
+	if (errno != ENOPROTOOPT)
+		SocketException::raiseLastError();
+#endif
+	return !enable;
+}
+
+// --------------------------------------------------------------------------
+
+size_t Socket::receiveCoalesced(void * buf, size_t len, size_t * segmentSize, Address * addr) {
+#ifdef UDP_GRO
+	TraceScope trace(TRACE_RECEIVE_COALESCED, _handle, len);
+	iovec iov;
+	iov.iov_base = buf;
+	iov.iov_len = len;
+
+	char control[CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(uint32_t))];
+
+	msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	if (addr != NULL) {
+		msg.msg_name = addr->_addr;
+		msg.msg_namelen = addr->_addrMaxSize;
+	}
+
+	ssize_t bytes = ::recvmsg(_handle, &msg, 0);
+	if (bytes < 0)
+		SocketException::raiseLastError();
+	if (addr != NULL)
+		addr->_addrSize = msg.msg_namelen;
+
+	(*segmentSize) = bytes;
+	for (cmsghdr * cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+			int gso;
+			memcpy(&gso, CMSG_DATA(cmsg), sizeof(gso));
+			(*segmentSize) = gso;
+#ifdef SO_RXQ_OVFL
+		} else if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+			uint32_t drops;
+			memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+			_drops = drops;
+#endif
+		}
+	}
+	return trace.result(bytes);
+#else
+	size_t bytes = addr != NULL ? receive(buf, len, addr) : receive(buf, len);
+	(*segmentSize) = bytes;
 	return bytes;
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+size_t Socket::sendHandles(const void * buf, size_t len, const SOCKET * handles, size_t count) {
+#ifdef WIN32_API
+	throw SocketException("Passing handles not supported on this platform", 0);
+#else
+	if (len == 0)
+		throw SocketException("At least one byte must be sent with handles", EINVAL);
+
+	TraceScope trace(TRACE_SEND_HANDLES, _handle, len);
+	iovec iov;
+	iov.iov_base = const_cast<void*> (buf);
+	iov.iov_len = len;
+
+	size_t controlLen = CMSG_SPACE(count * sizeof(SOCKET));
+	char * control = new char[controlLen];
+	memset(control, 0, controlLen);
+
+	msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	if (count > 0) {
+		msg.msg_control = control;
+		msg.msg_controllen = controlLen;
+		cmsghdr * cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(count * sizeof(SOCKET));
+		memcpy(CMSG_DATA(cmsg), handles, count * sizeof(SOCKET));
+	}
+
+	ssize_t bytes = ::sendmsg(_handle, &msg, MSG_NOSIGNAL);
+	delete [] control;
+	if (bytes < 0)
+		SocketException::raiseLastError();
+	return trace.result(bytes);
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+size_t Socket::receiveHandles(void * buf, size_t len, SOCKET * handles, size_t * count) {
+#ifdef WIN32_API
+	throw SocketException("Passing handles not supported on this platform", 0);
+#else
+	TraceScope trace(TRACE_RECEIVE_HANDLES, _handle, len);
+	iovec iov;
+	iov.iov_base = buf;
+	iov.iov_len = len;
+
+	// room for the requested handles, plus some to detect extra ones
+	size_t max = (*count);
+	size_t controlLen = CMSG_SPACE((max + 16) * sizeof(SOCKET));
+	char * control = new char[controlLen];
+
+	msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = controlLen;
+
+	ssize_t bytes = ::recvmsg(_handle, &msg, MSG_CMSG_CLOEXEC);
+	if (bytes < 0) {
+		delete [] control;
+		SocketException::raiseLastError();
+	}
+
+	(*count) = 0;
+	for (cmsghdr * cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+		size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(SOCKET);
+		for (size_t i = 0; i < n; ++i) {
+			SOCKET h;
+			memcpy(&h, CMSG_DATA(cmsg) + i * sizeof(SOCKET), sizeof(h));
+			if ((*count) < max) {
+				handles[(*count)++] = h;
+			} else {
+				::close(h);
+			}
+		}
+	}
+	delete [] control;
+	return trace.result(bytes);
+#endif
 }
 
 // --------------------------------------------------------------------------
 
 void Socket::listen(int backlog)
 {
+	TraceScope trace(TRACE_LISTEN, _handle, backlog);
 	RoR(::listen(_handle, backlog));
 }
 
 // --------------------------------------------------------------------------
 
+void Socket::listen(int backlog, int fastOpenQueue)
+{
+#ifdef TCP_FASTOPEN
+	setOption(IPPROTO_TCP, TCP_FASTOPEN, &fastOpenQueue, sizeof(fastOpenQueue));
+#endif
+	listen(backlog);
+}
+
+// --------------------------------------------------------------------------
+
 Socket*	Socket::accept()
 {
-	SOCKET newHandle = ::accept(_handle, NULL, NULL);
+	TraceScope trace(TRACE_ACCEPT, _handle, 0);
+	SOCKET newHandle = trace.result(::accept(_handle, NULL, NULL));
 	if (newHandle ==  INVALID_SOCKET)
 		SocketException::raiseLastError();
 
@@ -198,10 +866,10 @@ Socket*	Socket::accept()
 Address Socket::localAddress()
 {
 	if (_local.isNull()) {
-		sockaddr_in addr;
+		sockaddr_un addr;	// large enough for any supported family
 		socklen_t size = sizeof(addr);
 		RoR(::getsockname(_handle, reinterpret_cast<sockaddr*>(&addr), &size));
-		_local = Address(ntohl(addr.sin_addr.s_addr), ntohs(addr.sin_port));
+		_local = Address(reinterpret_cast<sockaddr*>(&addr), size);
 	}
 	return _local;
 }
@@ -211,10 +879,10 @@ Address Socket::localAddress()
 Address Socket::remoteAddress()
 {
 	if (_remote.isNull()) {
-		sockaddr_in addr;
+		sockaddr_un addr;	// large enough for any supported family
 		socklen_t size = sizeof(addr);
 		RoR(::getpeername(_handle, reinterpret_cast<sockaddr*>(&addr), &size));
-		_remote = Address(ntohl(addr.sin_addr.s_addr), ntohs(addr.sin_port));
+		_remote = Address(reinterpret_cast<sockaddr*>(&addr), size);
 	}
 
 	return _remote;
@@ -225,14 +893,14 @@ Address Socket::remoteAddress()
 void Socket::setBlocking(bool blocking)
 {
 #ifdef WIN32_API
-	unsigned long mode = blocking ? 1 : 0;
+	unsigned long mode = blocking ? 0 : 1;
 	RoR(::ioctlsocket(_handle, FIONBIO, &mode));
 #else
-	// set or clear the blocking flag
+	// set or clear the non-blocking flag
 	int flags = fcntl(_handle,F_GETFL,0);
 
 	flags |= O_NONBLOCK;
-	if ( !blocking ) flags ^= O_NONBLOCK;
+	if ( blocking ) flags ^= O_NONBLOCK;
 
 	RoR(::fcntl(_handle, F_SETFL, flags));
 #endif
@@ -240,9 +908,415 @@ void Socket::setBlocking(bool blocking)
 
 // --------------------------------------------------------------------------
 
+void Socket::applyProfile(TcpProfile profile)
+{
+	int nodelay, lowat, idle, interval, count;
+
+	switch (profile) {
+	case LOW_LATENCY:
+		nodelay = 1;
+		lowat = 16 * 1024;
+		idle = 10;
+		interval = 2;
+		count = 3;
+		break;
+	case HIGH_THROUGHPUT:
+		nodelay = 0;
+		lowat = 0;			// system default
+		idle = 60;
+		interval = 10;
+		count = 5;
+		break;
+	default:
+		throw SocketException("Unknown TCP profile", 0);
+	}
+
+	setCork(false);
+	setOption(IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+#ifdef TCP_QUICKACK
+	setOption(IPPROTO_TCP, TCP_QUICKACK, &nodelay, sizeof(nodelay));
+#endif
+#ifdef TCP_NOTSENT_LOWAT
+	setOption(IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat, sizeof(lowat));
+#endif
+	setKeepAlive(true, idle, interval, count);
+}
+
+// --------------------------------------------------------------------------
+
+void Socket::setCork(bool cork)
+{
+#ifdef TCP_CORK
+	int value = cork ? 1 : 0;
+	setOption(IPPROTO_TCP, TCP_CORK, &value, sizeof(value));
+#else
+	if (cork)
+		throw SocketException("TCP_CORK not supported on this platform", 0);
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+void Socket::setKeepAlive(bool enable, int idle, int interval, int count)
+{
+	setOption(SO_KEEPALIVE, enable ? 1 : 0);
+	if (!enable)
+		return;
+#ifdef TCP_KEEPIDLE
+	setOption(IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+#endif
+#ifdef TCP_KEEPINTVL
+	setOption(IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+#endif
+#ifdef TCP_KEEPCNT
+	setOption(IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+int Socket::incomingCpu()
+{
+#ifdef SO_INCOMING_CPU
+	return getIntOption(SO_INCOMING_CPU);
+#else
+	return -1;
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+unsigned int Socket::incomingNapiId()
+{
+#ifdef SO_INCOMING_NAPI_ID
+	return getIntOption(SO_INCOMING_NAPI_ID);
+#else
+	return 0;
+#endif
+}
+
+// --------------------------------------------------------------------------
+
 SOCKET Socket::handle()
 {
 	return _handle;
 }
 
+// --------------------------------------------------------------------------
+
+void Socket::setDropTracking(bool enable)
+{
+#ifdef SO_RXQ_OVFL
+	setOption(SO_RXQ_OVFL, enable ? 1 : 0);
+	_trackDrops = enable;
+#else
+	if (enable)
+		throw SocketException("Drop tracking not supported on this platform", 0);
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long Socket::dropCount()
+{
+	return _drops;
+}
+
+// --------------------------------------------------------------------------
+
+size_t Socket::pendingInput()
+{
+#ifdef WIN32_API
+	unsigned long bytes = 0;
+	RoR(::ioctlsocket(_handle, FIONREAD, &bytes));
+#else
+	int bytes = 0;
+	RoR(::ioctl(_handle, FIONREAD, &bytes));
+#endif
+	return bytes;
+}
+
+// --------------------------------------------------------------------------
+
+size_t Socket::pendingOutput()
+{
+#ifdef SIOCOUTQ
+	int bytes = 0;
+	RoR(::ioctl(_handle, SIOCOUTQ, &bytes));
+	return bytes;
+#else
+	throw SocketException("Send queue size not supported on this platform", 0);
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+#ifdef __linux__
+/*
+ * The layout of struct tcp_info of recent kernels, the one of the C
+ * library stops at tcpi_total_retrans. Older kernels return a shorter
+ * structure, the missing fields stay 0.
+ */
+struct KernelTcpInfo {
+	uint8_t		state;
+	uint8_t		caState;
+	uint8_t		retransmits;
+	uint8_t		probes;
+	uint8_t		backoff;
+	uint8_t		options;
+	uint8_t		wscale;
+	uint8_t		flags;
+	uint32_t	rto;
+	uint32_t	ato;
+	uint32_t	sndMss;
+	uint32_t	rcvMss;
+	uint32_t	unacked;
+	uint32_t	sacked;
+	uint32_t	lost;
+	uint32_t	retrans;
+	uint32_t	fackets;
+	uint32_t	lastDataSent;
+	uint32_t	lastAckSent;
+	uint32_t	lastDataRecv;
+	uint32_t	lastAckRecv;
+	uint32_t	pmtu;
+	uint32_t	rcvSsthresh;
+	uint32_t	rtt;
+	uint32_t	rttvar;
+	uint32_t	sndSsthresh;
+	uint32_t	sndCwnd;
+	uint32_t	advmss;
+	uint32_t	reordering;
+	uint32_t	rcvRtt;
+	uint32_t	rcvSpace;
+	uint32_t	totalRetrans;
+	uint64_t	pacingRate;
+	uint64_t	maxPacingRate;
+	uint64_t	bytesAcked;
+	uint64_t	bytesReceived;
+	uint32_t	segsOut;
+	uint32_t	segsIn;
+	uint32_t	notsentBytes;
+	uint32_t	minRtt;
+	uint32_t	dataSegsIn;
+	uint32_t	dataSegsOut;
+	uint64_t	deliveryRate;
+	uint64_t	busyTime;
+	uint64_t	rwndLimited;
+	uint64_t	sndbufLimited;
+	uint32_t	delivered;
+	uint32_t	deliveredCe;
+	uint64_t	bytesSent;
+	uint64_t	bytesRetrans;
+	uint32_t	dsackDups;
+	uint32_t	reordSeen;
+	uint32_t	rcvOoopack;
+	uint32_t	sndWnd;
+};
+#endif
+
+TcpInfo Socket::tcpInfo()
+{
+#ifdef __linux__
+	KernelTcpInfo ki;
+	memset(&ki, 0, sizeof(ki));
+	socklen_t len = sizeof(ki);
+	RoR(::getsockopt(_handle, IPPROTO_TCP, TCP_INFO, &ki, &len));
+
+	TcpInfo info;
+	info.state = ki.state;
+	info.rtt = ki.rtt;
+	info.rttVar = ki.rttvar;
+	info.minRtt = ki.minRtt;
+	info.rto = ki.rto;
+	info.mss = ki.sndMss;
+	info.cwnd = ki.sndCwnd;
+	info.ssthresh = ki.sndSsthresh;
+	info.unacked = ki.unacked;
+	// as 'ss' and the kernel's tcp_packets_in_flight do
+	uint32_t out = ki.sacked + ki.lost;
+	info.inFlight = ki.unacked + ki.retrans > out ? ki.unacked + ki.retrans - out : 0;
+	info.bytesInFlight = static_cast<unsigned long long> (info.inFlight) * ki.sndMss;
+	info.lost = ki.lost;
+	info.retransmits = ki.retransmits;
+	info.totalRetrans = ki.totalRetrans;
+	info.zeroWindowProbes = ki.probes;
+	info.peerWindow = ki.sndWnd;
+	info.receiveSpace = ki.rcvSpace;
+	info.notSent = ki.notsentBytes;
+	info.bytesSent = ki.bytesSent;
+	info.bytesRetrans = ki.bytesRetrans;
+	info.bytesAcked = ki.bytesAcked;
+	info.bytesReceived = ki.bytesReceived;
+	info.deliveryRate = ki.deliveryRate;
+	info.pacingRate = ki.pacingRate;
+	info.busyTime = ki.busyTime;
+	info.rwndLimited = ki.rwndLimited;
+	info.sndbufLimited = ki.sndbufLimited;
+	return info;
+#else
+	throw SocketException("TCP info not supported on this platform", 0);
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+size_t Socket::receiveMessage(void * buf, size_t len, Address * addr)
+{
+#ifndef WIN32_API
+	for (;;) {
+		unsigned char trailer[CRC_SIZE];
+		iovec iov[2];
+		iov[0].iov_base = buf;
+		iov[0].iov_len = len;
+		iov[1].iov_base = trailer;
+		iov[1].iov_len = CRC_SIZE;
+
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = _checksums ? 2 : 1;
+#ifdef SO_RXQ_OVFL
+		char control[CMSG_SPACE(sizeof(uint32_t))];
+		if (_trackDrops) {
+			msg.msg_control = control;
+			msg.msg_controllen = sizeof(control);
+		}
+#endif
+		if (addr != NULL) {
+			msg.msg_name = addr->_addr;
+			msg.msg_namelen = addr->_addrMaxSize;
+		}
+
+		ssize_t bytes = ::recvmsg(_handle, &msg, 0);
+		if (bytes < 0)
+			SocketException::raiseLastError();
+		if (addr != NULL)
+			addr->_addrSize = msg.msg_namelen;
+
+#ifdef SO_RXQ_OVFL
+		for (cmsghdr * cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+				uint32_t drops;
+				memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+				_drops = drops;
+			}
+		}
+#endif
+		if (!_checksums)
+			return bytes;
+
+		size_t payload;
+		if ((msg.msg_flags & MSG_TRUNC) == 0 && checkTrailer(buf, len, trailer, bytes, &payload))
+			return payload;
+		++_checksumErrors;
+	}
+#else
+	return addr != NULL ? receive(buf, len, addr) : receive(buf, len);
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+size_t Socket::receiveBatch(DatagramBuffer * bufs, size_t count) {
+	if (count == 0)
+		throw SocketException("At least one buffer is needed", EINVAL);
+#ifdef __linux__
+	TraceScope trace(TRACE_RECEIVE_BATCH, _handle, count);
+	static const size_t BATCH = 64;		// datagrams per system call
+	mmsghdr msgs[BATCH];
+	iovec iov[2 * BATCH];
+	unsigned char trailers[BATCH][CRC_SIZE];
+	char control[BATCH][CMSG_SPACE(sizeof(uint32_t))];
+
+	size_t part = count < BATCH ? count : BATCH;
+	for (;;) {
+		memset(msgs, 0, part * sizeof(mmsghdr));
+		for (size_t i = 0; i < part; ++i) {
+			iov[2 * i].iov_base = bufs[i].data;
+			iov[2 * i].iov_len = bufs[i].size;
+			iov[2 * i + 1].iov_base = trailers[i];
+			iov[2 * i + 1].iov_len = CRC_SIZE;
+			msghdr & hdr = msgs[i].msg_hdr;
+			hdr.msg_iov = &iov[2 * i];
+			hdr.msg_iovlen = _checksums ? 2 : 1;
+			if (_trackDrops) {
+				hdr.msg_control = control[i];
+				hdr.msg_controllen = sizeof(control[i]);
+			}
+			if (bufs[i].addr != NULL) {
+				hdr.msg_name = bufs[i].addr->_addr;
+				hdr.msg_namelen = bufs[i].addr->_addrMaxSize;
+			}
+		}
+
+		int got = ::recvmmsg(_handle, msgs, part, MSG_WAITFORONE, NULL);
+		if (got < 0)
+			SocketException::raiseLastError();
+
+		size_t valid = 0;
+		for (int i = 0; i < got; ++i) {
+			msghdr & hdr = msgs[i].msg_hdr;
+			if (bufs[i].addr != NULL)
+				bufs[i].addr->_addrSize = hdr.msg_namelen;
+#ifdef SO_RXQ_OVFL
+			for (cmsghdr * cmsg = CMSG_FIRSTHDR(&hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+				if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+					uint32_t drops;
+					memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+					_drops = drops;
+				}
+			}
+#endif
+			size_t len = msgs[i].msg_len;
+			if (_checksums && ((hdr.msg_flags & MSG_TRUNC) != 0 ||
+					!checkTrailer(bufs[i].data, bufs[i].size, trailers[i], len, &len))) {
+				++_checksumErrors;
+				continue;
+			}
+			bufs[i].length = len;
+			if (valid != static_cast<size_t> (i)) {
+				// move down over a dropped datagram, only after corruption;
+				// the buffers may differ in size, so swap the entries
+				std::swap(bufs[valid], bufs[i]);
+			}
+			++valid;
+		}
+		if (valid > 0)
+			return trace.result(valid);
+		// all dropped, wait for more
+	}
+#else
+	bufs[0].length = bufs[0].addr != NULL ?
+			receive(bufs[0].data, bufs[0].size, bufs[0].addr) :
+			receive(bufs[0].data, bufs[0].size);
+	return 1;
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+void Socket::setChecksums(bool enable)
+{
+#ifdef WIN32_API
+	if (enable)
+		throw SocketException("Checksums not supported on this platform", 0);
+#else
+	if (enable) {
+		// a trailer per call would corrupt a byte stream
+		int type = getIntOption(SO_TYPE);
+		if (type != SOCK_DGRAM && type != SOCK_SEQPACKET)
+			throw SocketException("Checksums need a datagram socket", EINVAL);
+	}
+	_checksums = enable;
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long Socket::checksumErrors()
+{
+	return _checksumErrors;
+}
+
 END_NKF_NET
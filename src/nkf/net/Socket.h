@@ -18,12 +18,25 @@
 
 START_NKF_NET
 
+class Connector;
+
 /**
  * The socket type to create.
  */
 enum SocketType {
 	TCP /* < A TCP IP socket */,
-	UDP /* < A UDP socket */
+	UDP /* < A UDP socket */,
+	UNIX_STREAM /* < A Unix domain stream socket */,
+	UNIX_DGRAM /* < A Unix domain datagram socket */,
+	UNIX_SEQPACKET /* < A Unix domain sequenced packet socket */
+};
+
+/**
+ * Named sets of TCP options, see Socket::applyProfile.
+ */
+enum TcpProfile {
+	LOW_LATENCY /* < Small messages, minimal delay */,
+	HIGH_THROUGHPUT /* < Bulk transfers, maximum throughput */
 };
 
 /**
@@ -48,19 +61,124 @@ inline timeval mktv(unsigned long secs, unsigned long usecs)
 static const timeval FOREVER = { 0xffffffff, 0xffffffff };
 
 
+/**
+ * A datagram to send with Socket::sendBatch.
+ */
+struct NKFNET_API Datagram {
+	/** The data to send. */
+	const void *	data;
+	/** The length of the data in bytes. */
+	size_t			length;
+	/** The address to send to, or NULL for a connected socket. */
+	const Address *	addr;
+};
+
+/**
+ * A buffer to receive a datagram in with Socket::receiveBatch.
+ */
+struct NKFNET_API DatagramBuffer {
+	/** The buffer to receive in. */
+	void *			data;
+	/** The size of the buffer in bytes. */
+	size_t			size;
+	/** Receives the length of the datagram in bytes. */
+	size_t			length;
+	/** Receives the address the datagram was sent from, may be NULL. */
+	Address *		addr;
+};
+
+/**
+ * A snapshot of the transport state of a TCP connection, see
+ * Socket::tcpInfo. Values the kernel does not report are 0.
+ */
+struct NKFNET_API TcpInfo {
+	/** The connection state, e.g. TCP_ESTABLISHED. */
+	unsigned int		state;
+	/** The smoothed round trip time, in microseconds. */
+	unsigned int		rtt;
+	/** The round trip time variance, in microseconds. */
+	unsigned int		rttVar;
+	/** The lowest round trip time seen, in microseconds. */
+	unsigned int		minRtt;
+	/** The retransmission timeout, in microseconds. */
+	unsigned int		rto;
+	/** The maximum segment size used for sending. */
+	unsigned int		mss;
+	/** The congestion window, in segments. */
+	unsigned int		cwnd;
+	/** The slow start threshold, in segments. */
+	unsigned int		ssthresh;
+	/** The number of segments sent and not yet acknowledged. */
+	unsigned int		unacked;
+	/** The number of segments in flight, i.e. not acknowledged, lost or sacked. */
+	unsigned int		inFlight;
+	/** The number of bytes in flight, estimated as inFlight * mss. */
+	unsigned long long	bytesInFlight;
+	/** The number of segments considered lost. */
+	unsigned int		lost;
+	/** The number of consecutive retransmission timeouts of the current segment. */
+	unsigned int		retransmits;
+	/** The total number of segments retransmitted. */
+	unsigned int		totalRetrans;
+	/** The number of unanswered zero window probes. */
+	unsigned int		zeroWindowProbes;
+	/** The receive window advertised by the peer, in bytes. */
+	unsigned int		peerWindow;
+	/** The space in the local receive buffer used for the window, in bytes. */
+	unsigned int		receiveSpace;
+	/** The number of bytes in the send queue not yet sent. */
+	unsigned int		notSent;
+	/** The total number of bytes sent, retransmissions included. */
+	unsigned long long	bytesSent;
+	/** The total number of bytes retransmitted. */
+	unsigned long long	bytesRetrans;
+	/** The total number of bytes acknowledged by the peer. */
+	unsigned long long	bytesAcked;
+	/** The total number of bytes received. */
+	unsigned long long	bytesReceived;
+	/** The recent delivery rate, in bytes per second. */
+	unsigned long long	deliveryRate;
+	/** The pacing rate, in bytes per second. */
+	unsigned long long	pacingRate;
+	/** The total time spent sending data, in microseconds. */
+	unsigned long long	busyTime;
+	/** The part of busyTime limited by the peer's receive window. */
+	unsigned long long	rwndLimited;
+	/** The part of busyTime limited by the local send buffer. */
+	unsigned long long	sndbufLimited;
+};
+
 /**
  * Socket is a small cross-platform socket abstraction, which aims to
- * unify sockets across several platforms. Currently only TCP and UDP
- * is supported.
+ * unify sockets across several platforms. Currently TCP, UDP and Unix
+ * domain sockets are supported.
+ *
+ * Unix domain sockets are much cheaper than TCP over the loopback
+ * interface for processes on the same host, and are used in the same
+ * way, with an Address created by Address::unixPath or
+ * Address::unixAbstract. Connected pairs can be created with createPair.
  */
 class NKFNET_API Socket {
+
+	friend class Connector;
+
 public:
 	/**
 	 * Create a new socket of the specific type.
-	 * \param   type  The socket type, either UDP and TCP.
+	 * \param   type  The socket type, e.g. UDP or TCP.
 	 */
 	Socket(SocketType type);
 
+	/**
+	 * Creates a pair of connected Unix domain sockets, like socketpair.
+	 * The caller becomes the owner of both sockets and must delete them.
+	 *
+	 * \param	type	The socket type, one of the UNIX_* types.
+	 * \param	first	Receives the first socket.
+	 * \param	second	Receives the second socket.
+	 */
+	static void createPair(SocketType type, Socket ** first, Socket ** second);
+
 	/**
 	 * Creates a socket with the specified handle / file descriptor.
 	 *
@@ -234,6 +352,42 @@ public:
 	 */
 	void	connect(const Address & addr);
 
+	/**
+	 * Connects to a specific hostname and port, waiting at most the given
+	 * time for the connection to be established.
+	 *
+	 * The connection is made non-blocking, and the socket is returned to
+	 * its original blocking mode afterwards. If the connection is not
+	 * established in time, a SocketException with code ETIMEDOUT is
+	 * thrown and the socket should be closed.
+	 *
+	 * To connect to many hosts at once, see Connector.
+	 *
+	 * \param	addr		The remote address to connect to.
+	 * \param	timeout		The maximum time to wait.
+	 */
+	void	connect(const Address & addr, timeval timeout);
+
+	/**
+	 * Connects to a specific hostname and port, sending the first data
+	 * along with the connection request using TCP Fast Open.
+	 *
+	 * If the server supports Fast Open and a cookie is known for it, the
+	 * data is carried in the SYN, saving a round trip. Else the data is
+	 * sent after the handshake. On platforms without Fast Open this is the
+	 * same as calling connect() followed by send().
+	 *
+	 * Note that the data may be delivered twice if the SYN is retransmitted,
+	 * so the first request must be idempotent.
+	 *
+	 * \param	addr		The remote address to connect to.
+	 * \param	buf			The buffer to send.
+	 * \param	len			The length of the buffer in bytes.
+	 *
+	 * \return				The number of bytes send.
+	 */
+	size_t	connect(const Address & addr, const void * buf, size_t len);
+
 	/**
 	 * Bind to a specific adapter, by address. Address must be a
 	 * local host address. Pass Socket::ANY if you want to bind
@@ -265,6 +419,124 @@ public:
 	 */
 	size_t	send(const void * buf, size_t len, const Address & addr);
 
+#ifndef WIN32_API
+	/**
+	 * Sends a number of buffers at once to the connected host (vectored or
+	 * gather send), as if they were one buffer.
+	 *
+	 * Like send(), a non-blocking TCP socket may send only part of the data.
+	 * Posix only.
+	 *
+	 * \param	vec		The buffers to send.
+	 * \param	count	The number of buffers, at most IOV_MAX.
+	 *
+	 * \return			The number of bytes send.
+	 */
+	size_t	send(const iovec * vec, size_t count);
+#endif
+
+	/**
+	 * Sends a number of datagrams with as few system calls as possible
+	 * (sendmmsg on Linux, else one send per datagram).
+	 *
+	 * A non-blocking socket may send only some of the datagrams, in which
+	 * case the remaining ones should be sent again later.
+	 *
+	 * \code
+	 * Datagram batch[2] = { { &hdr, sizeof(hdr), &dst1 }, { &hdr, sizeof(hdr), &dst2 } };
+	 * s.sendBatch(batch, 2);
+	 * \endcode
+	 *
+	 * \param	dgrams	The datagrams to send.
+	 * \param	count	The number of datagrams.
+	 *
+	 * \return			The number of datagrams sent.
+	 */
+	size_t	sendBatch(const Datagram * dgrams, size_t count);
+
+	/**
+	 * Sends (part of) a file to the connected host. On Linux the data is
+	 * sent by the kernel without copying it through user space (sendfile),
+	 * else it is read and sent in chunks.
+	 *
+	 * Like send(), a non-blocking socket may send only part of the data.
+	 * Not supported on Windows.
+	 *
+	 * \param	fd		The file descriptor of the file.
+	 * \param	offset	The offset in the file to start at.
+	 * \param	count	The number of bytes to send.
+	 *
+	 * \return			The number of bytes send, less than count at the end
+	 * 					of the file.
+	 */
+	size_t	sendFile(int fd, unsigned long long offset, size_t count);
+
+	/**
+	 * Sends a buffer as a series of equally sized UDP datagrams to the host
+	 * specified at address. Only the last datagram may be smaller.
+	 *
+	 * If the kernel supports UDP segmentation offload (UDP_SEGMENT), the
+	 * buffer is passed down in as few calls as possible and split by the
+	 * kernel or the network card. Else each datagram is sent separately.
+	 * Support is detected on first use, see segmentationSupported(), and
+	 * turned off for this socket if its device can not offload checksums.
+	 *
+	 * \param	buf			The buffer to send.
+	 * \param	len			The length of the buffer in bytes.
+	 * \param	segmentSize	The payload size of each datagram.
+	 * \param	addr		The address to send the data to.
+	 *
+	 * \return				The number of bytes send.
+	 */
+	size_t	sendSegmented(const void * buf, size_t len, size_t segmentSize, const Address & addr);
+
+	/**
+	 * Returns whether or not the kernel supports UDP segmentation offload.
+	 *
+	 * \return	true if UDP_SEGMENT is supported.
+	 */
+	bool	segmentationSupported();
+
+	/**
+	 * Limits the rate at which the kernel transmits data on this socket
+	 * (SO_MAX_PACING_RATE). For UDP the limit is enforced by the fq queueing
+	 * discipline, so it has no effect on interfaces using another one.
+	 * Linux only.
+	 *
+	 * \param	bytesPerSecond	The maximum rate, or 0 for no limit.
+	 *
+	 * \return					true if the limit was set, false if the kernel
+	 * 							does not support it.
+	 */
+	bool	setPacingRate(unsigned long long bytesPerSecond);
+
+	/**
+	 * Enables or disables launch times for datagrams (SO_TXTIME), see
+	 * sendAt(). Launch times are honoured by the fq and etf queueing
+	 * disciplines. Linux only.
+	 *
+	 * \param	enable	If true, launch times are enabled.
+	 *
+	 * \return			true if the setting was applied, false if the kernel
+	 * 					does not support launch times.
+	 */
+	bool	setLaunchTimes(bool enable);
+
+	/**
+	 * Sends a datagram which should not be transmitted before the given
+	 * launch time. If launch times are not enabled, see setLaunchTimes(),
+	 * the datagram is sent right away.
+	 *
+	 * \param	buf			The buffer to send.
+	 * \param	len			The length of the buffer in bytes.
+	 * \param	addr		The address to send the data to.
+	 * \param	launchTime	The launch time in nanoseconds on the
+	 * 						CLOCK_MONOTONIC clock.
+	 *
+	 * \return				The number of bytes send.
+	 */
+	size_t	sendAt(const void * buf, size_t len, const Address & addr, unsigned long long launchTime);
+
 
 	/**
 	 * Receive data into the given buffer.
@@ -307,6 +579,101 @@ public:
 	 */
 	size_t	receive(void * buf, size_t len, Address * addr);
 
+	/**
+	 * Receives a number of datagrams with a single system call (recvmmsg
+	 * on Linux, else one datagram per call). Waits for the first datagram
+	 * if the socket is blocking, then takes what has already arrived.
+	 *
+	 * \code
+	 * char data[32][9000];
+	 * DatagramBuffer bufs[32];
+	 * for (int i = 0; i < 32; ++i) {
+	 *   bufs[i].data = data[i];
+	 *   bufs[i].size = sizeof(data[i]);
+	 *   bufs[i].addr = NULL;
+	 * }
+	 * size_t n = s.receiveBatch(bufs, 32);
+	 * for (size_t i = 0; i < n; ++i) process(bufs[i].data, bufs[i].length);
+	 * \endcode
+	 *
+	 * With checksums, datagrams which fail the check are dropped and the
+	 * entries of the valid ones are swapped to the front of bufs, so the
+	 * entries may come back in a different order.
+	 *
+	 * \param	bufs	The buffers to receive in.
+	 * \param	count	The number of buffers, at least 1.
+	 *
+	 * \return			The number of datagrams received, at least 1.
+	 */
+	size_t	receiveBatch(DatagramBuffer * bufs, size_t count);
+
+	/**
+	 * Enables or disables UDP receive coalescing (UDP_GRO). When enabled,
+	 * the kernel may merge consecutive datagrams from the same sender into
+	 * one, which can be read with receiveCoalesced().
+	 *
+	 * \param	enable	If true, coalescing is enabled.
+	 *
+	 * \return			true if the setting was applied, false if the kernel
+	 * 					does not support coalescing.
+	 */
+	bool	setReceiveCoalescing(bool enable);
+
+	/**
+	 * Receives one or more coalesced datagrams into the given buffer.
+	 *
+	 * All datagrams have a payload of segmentSize bytes, except the last
+	 * one which may be smaller. The datagram at index i starts at
+	 * buf + i * segmentSize. If no coalescing took place, the segment size
+	 * equals the number of bytes received.
+	 *
+	 * The buffer should be able to hold 64 KiB, else coalesced data may be
+	 * truncated.
+	 *
+	 * \param	buf			The buffer to receive in.
+	 * \param	len			The length of the buffer in bytes.
+	 * \param	segmentSize	Receives the size of each datagram.
+	 * \param	addr		The address from which the data was received,
+	 * 						may be NULL.
+	 *
+	 * \return				The number of bytes received.
+	 */
+	size_t	receiveCoalesced(void * buf, size_t len, size_t * segmentSize, Address * addr);
+
+	/**
+	 * Sends data along with a number of handles (file descriptors) to the
+	 * connected peer, which must be a Unix domain socket (SCM_RIGHTS). The
+	 * peer receives duplicates of the handles, which refer to the same
+	 * sockets or files. Posix only.
+	 *
+	 * At least one byte of data must be sent.
+	 *
+	 * \param	buf		The buffer to send.
+	 * \param	len		The length of the buffer in bytes.
+	 * \param	handles	The handles to send.
+	 * \param	count	The number of handles.
+	 *
+	 * \return			The number of bytes send.
+	 */
+	size_t	sendHandles(const void * buf, size_t len, const SOCKET * handles, size_t count);
+
+	/**
+	 * Receives data along with handles sent with sendHandles. Handles which
+	 * do not fit in the given array are closed. Posix only.
+	 *
+	 * The received handles can be wrapped in a Socket using the
+	 * Socket(SOCKET handle) constructor, or used as a plain file descriptor.
+	 *
+	 * \param	buf		The buffer to receive in.
+	 * \param	len		The length of the buffer in bytes.
+	 * \param	handles	Receives the handles.
+	 * \param	count	On input the size of the handles array, on output
+	 * 					the number of handles received.
+	 *
+	 * \return			The number of bytes received.
+	 */
+	size_t	receiveHandles(void * buf, size_t len, SOCKET * handles, size_t * count);
+
 	/**
 	 * Puts the socket into a listening state.
 	 *
@@ -315,6 +682,16 @@ public:
 	 */
 	void	listen(int backlog = SOMAXCONN);
 
+	/**
+	 * Puts the socket into a listening state, accepting TCP Fast Open
+	 * connection requests.
+	 *
+	 * \param	backlog			Max of pending connections.
+	 * \param	fastOpenQueue	Max of pending Fast Open requests which
+	 * 							have not yet completed the handshake.
+	 */
+	void	listen(int backlog, int fastOpenQueue);
+
 	/**
 	 * Accepts incoming new connections. Blocks indefinitely if no
 	 * timeout was set.
@@ -348,6 +725,72 @@ public:
 	void	setBlocking(bool blocking);
 
 
+	/**
+	 * Applies a coherent set of TCP options for the given use.
+	 *
+	 * - LOW_LATENCY: disables Nagle (TCP_NODELAY), acknowledges
+	 *   immediately (TCP_QUICKACK), limits unsent data in the kernel to
+	 *   16 KiB (TCP_NOTSENT_LOWAT) and detects dead peers within about
+	 *   16 seconds (keepalive 10s idle, 2s interval, 3 probes).
+	 * - HIGH_THROUGHPUT: enables Nagle and delayed acknowledgements, uses the
+	 *   system default for unsent data and detects dead peers within about
+	 *   2 minutes (keepalive 60s idle, 10s interval, 5 probes).
+	 *
+	 * Both profiles clear any cork, see setCork. Options which are not
+	 * available on the platform are skipped. Note that the kernel may turn
+	 * TCP_QUICKACK off again by itself, so reapply the profile after
+	 * receiving if immediate acknowledgements are essential.
+	 *
+	 * \param	profile		The profile to apply.
+	 */
+	void	applyProfile(TcpProfile profile);
+
+	/**
+	 * Corks or uncorks the socket (TCP_CORK).
+	 *
+	 * While corked only full segments are sent, so a series of small sends
+	 * is batched into as few segments as possible. Uncorking sends anything
+	 * pending immediately. Data is never held for more than 200ms.
+	 *
+	 * \code
+	 * s.setCork(true);
+	 * s.send(&header, sizeof(header));
+	 * s.send(body, bodyLen);
+	 * s.setCork(false);	// flushes
+	 * \endcode
+	 *
+	 * \param	cork	If true, the socket will be corked.
+	 */
+	void	setCork(bool cork);
+
+	/**
+	 * Enables or disables TCP keepalive, with specific timings.
+	 *
+	 * \param	enable		If true, keepalive will be enabled.
+	 * \param	idle		Seconds of idleness before the first probe.
+	 * \param	interval	Seconds between probes.
+	 * \param	count		Number of unanswered probes before the connection
+	 * 						is dropped.
+	 */
+	void	setKeepAlive(bool enable, int idle, int interval, int count);
+
+	/**
+	 * Returns the CPU on which the kernel last processed incoming data for
+	 * this socket (SO_INCOMING_CPU). Linux only.
+	 *
+	 * \return	The CPU number, or -1 if not known (yet).
+	 */
+	int		incomingCpu();
+
+	/**
+	 * Returns the id of the NAPI context (receive queue of the network card)
+	 * which last delivered data for this socket (SO_INCOMING_NAPI_ID).
+	 * Linux only.
+	 *
+	 * \return	The NAPI id, or 0 if not known (yet).
+	 */
+	unsigned int incomingNapiId();
+
 	/**
 	 * Returns the OS-specific socket handle.
 	 *
@@ -355,11 +798,103 @@ public:
 	 */
 	SOCKET	handle();
 
+	/**
+	 * Enables or disables tracking of datagrams dropped by the kernel
+	 * because the receive buffer was full (SO_RXQ_OVFL).
+	 *
+	 * When enabled, the receive calls pick up the kernel drop counter with
+	 * every datagram received, see dropCount(). Linux only.
+	 *
+	 * \param	enable		If true, drops will be tracked.
+	 */
+	void	setDropTracking(bool enable);
+
+	/**
+	 * Returns the number of datagrams the kernel dropped on this socket, as
+	 * reported with the last datagram received. Always 0 if drop tracking
+	 * is not enabled.
+	 *
+	 * \return	The kernel drop counter.
+	 */
+	unsigned long dropCount();
+
+	/**
+	 * Enables or disables CRC32C checksums on datagrams, to detect payload
+	 * corruption which the UDP checksum misses, e.g. in switches which
+	 * recompute it.
+	 *
+	 * When enabled, send() and sendBatch() append a 4 byte CRC32C trailer
+	 * (little endian) to every datagram, and receive() and receiveBatch()
+	 * verify and strip it. Datagrams which fail the check, or do not fit
+	 * in the buffer, are dropped and counted, see checksumErrors(). Both
+	 * ends must enable checksums. The checksum is computed with the CRC
+	 * instructions of the processor where available, see Crc32c. Only for
+	 * datagram and sequenced packet sockets, enabling them on a stream
+	 * socket throws a SocketException (EINVAL). Posix only.
+	 *
+	 * \param	enable		If true, checksums are added and verified.
+	 */
+	void	setChecksums(bool enable);
+
+	/**
+	 * Returns the number of datagrams dropped because their checksum did
+	 * not match.
+	 *
+	 * \return	The number of datagrams.
+	 */
+	unsigned long checksumErrors();
+
+	/**
+	 * Returns the number of bytes waiting in the receive queue (SIOCINQ).
+	 *
+	 * \return	The number of bytes which can be read.
+	 */
+	size_t	pendingInput();
+
+	/**
+	 * Returns the number of bytes in the send queue which have not yet been
+	 * sent, or for TCP, not yet acknowledged by the peer (SIOCOUTQ).
+	 * Linux only.
+	 *
+	 * \return	The number of bytes in the send queue.
+	 */
+	size_t	pendingOutput();
+
+	/**
+	 * Returns a snapshot of the state of a TCP connection (TCP_INFO):
+	 * round trip times, congestion window, retransmissions, rates and
+	 * so on. Linux only.
+	 *
+	 * \return	The snapshot.
+	 */
+	TcpInfo	tcpInfo();
+
 private:
 
+	static void typeToNative(SocketType st, int * af, int * type, int * proto);
+
+	bool	beginConnect(const Address & addr);
+
+	int		connectError();
+
+	size_t	receiveMessage(void * buf, size_t len, Address * addr);
+
+	size_t	sendChecked(const void * buf, size_t len, const Address * addr);
 
 	SOCKET _handle;
 
+	bool	_trackDrops;
+
+	unsigned long _drops;
+
+	bool	_launchTimes;
+
+	int		_segmentSupport;	// UDP_SEGMENT: -1 unknown, 0 no, 1 yes
+
+	bool	_checksums;
+
+	unsigned long _checksumErrors;
+
 	Address _local;
 
 	Address _remote;
@@ -0,0 +1,191 @@
+/*
+ * SocketHandoff.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "SocketHandoff.h"
+#include "SocketException.h"
+#include <cstring>
+#include <sys/stat.h>
+
+START_NKF_NET
+
+/*
+ * The handoff protocol runs over a Unix domain sequenced packet socket,
+ * so every record arrives as one message:
+ *
+ * - One SOCKET record for every socket, carrying the handle (SCM_RIGHTS)
+ *   and its name.
+ * - One END record, after which the successor answers with a single ACK
+ *   byte once it has taken all sockets.
+ *
+ * A record is an 8 byte header followed by the name.
+ */
+
+static const char			HANDOFF_MAGIC[4]	= { 'N', 'K', 'F', 'H' };
+static const unsigned char	HANDOFF_VERSION		= 1;
+static const unsigned char	HANDOFF_SOCKET		= 1;
+static const unsigned char	HANDOFF_END			= 2;
+static const char			HANDOFF_ACK			= 'A';
+static const size_t			HANDOFF_HEADER		= 8;
+static const size_t			HANDOFF_MAX_NAME	= 255;
+static const long			HANDOFF_TIMEOUT		= 5;		// seconds, see serve()
+
+// --------------------------------------------------------------------------
+// SocketHandoff
+// --------------------------------------------------------------------------
+
+SocketHandoff::SocketHandoff(const Address & addr) :
+	_listener(UNIX_SEQPACKET),
+	_dev(0),
+	_ino(0) {
+	Address a(addr);
+	if (!a.isUnix())
+		throw SocketException("Handoff requires a Unix domain address", EINVAL);
+
+	_path = a.path();
+	if (!_path.empty() && _path[0] != '@') {
+		::unlink(_path.c_str());
+	} else {
+		_path.clear();	// nothing to clean up for abstract addresses
+	}
+
+	_listener.bind(addr);
+	_listener.listen(1);
+
+	struct stat st;
+	if (!_path.empty()) {
+		if (::stat(_path.c_str(), &st) == 0) {
+			_dev = st.st_dev;
+			_ino = st.st_ino;
+		} else {
+			_path.clear();
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void SocketHandoff::add(const std::string & name, Socket & sock) {
+	if (name.length() > HANDOFF_MAX_NAME)
+		throw SocketException("Handoff socket name too long", ENAMETOOLONG);
+	remove(name);
+	_sockets.push_back(std::make_pair(name, sock.handle()));
+}
+
+// --------------------------------------------------------------------------
+
+void SocketHandoff::remove(const std::string & name) {
+	for (size_t i = 0; i < _sockets.size(); ++i) {
+		if (_sockets[i].first == name) {
+			_sockets.erase(_sockets.begin() + i);
+			return;
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+
+Socket & SocketHandoff::socket() {
+	return _listener;
+}
+
+// --------------------------------------------------------------------------
+
+bool SocketHandoff::serve() {
+	timeval timeout = { HANDOFF_TIMEOUT, 0 };
+	return serve(timeout);
+}
+
+// --------------------------------------------------------------------------
+
+bool SocketHandoff::serve(timeval timeout) {
+	Socket * successor = _listener.accept();
+	char record[HANDOFF_HEADER + HANDOFF_MAX_NAME];
+	memcpy(record, HANDOFF_MAGIC, sizeof(HANDOFF_MAGIC));
+	record[4] = HANDOFF_VERSION;
+
+	bool acknowledged = false;
+	try {
+		// a successor which hangs must not block this process forever
+		successor->setOption(SO_SNDTIMEO, timeout);
+		successor->setOption(SO_RCVTIMEO, timeout);
+
+		for (size_t i = 0; i < _sockets.size(); ++i) {
+			const std::string & name = _sockets[i].first;
+			record[5] = HANDOFF_SOCKET;
+			record[6] = 0;
+			record[7] = static_cast<char> (name.length());
+			memcpy(record + HANDOFF_HEADER, name.data(), name.length());
+			successor->sendHandles(record, HANDOFF_HEADER + name.length(), &_sockets[i].second, 1);
+		}
+
+		record[5] = HANDOFF_END;
+		record[7] = 0;
+		successor->send(record, HANDOFF_HEADER);
+
+		char ack = 0;
+		acknowledged = successor->receive(&ack, 1) == 1 && ack == HANDOFF_ACK;
+	} catch (const SocketException &) {
+		acknowledged = false;
+	}
+
+	delete successor;
+	return acknowledged;
+}
+
+// --------------------------------------------------------------------------
+
+size_t SocketHandoff::take(const Address & addr, std::map<std::string, Socket*> & sockets,
+		timeval timeout) {
+	Socket predecessor(UNIX_SEQPACKET);
+	predecessor.connect(addr, timeout);
+	predecessor.setOption(SO_RCVTIMEO, timeout);
+
+	char record[HANDOFF_HEADER + HANDOFF_MAX_NAME];
+	size_t taken = 0;
+
+	while (true) {
+		SOCKET handle;
+		size_t count = 1;
+		size_t len = predecessor.receiveHandles(record, sizeof(record), &handle, &count);
+
+		if (len < HANDOFF_HEADER || memcmp(record, HANDOFF_MAGIC, sizeof(HANDOFF_MAGIC)) != 0
+				|| record[4] != HANDOFF_VERSION) {
+			if (count > 0) ::close(handle);
+			throw SocketException("Invalid handoff record", EPROTO);
+		}
+
+		if (record[5] == HANDOFF_END) break;
+
+		size_t nameLen = static_cast<unsigned char> (record[7]);
+		if (record[5] != HANDOFF_SOCKET || count != 1 || HANDOFF_HEADER + nameLen > len) {
+			if (count > 0) ::close(handle);
+			throw SocketException("Invalid handoff record", EPROTO);
+		}
+
+		std::string name(record + HANDOFF_HEADER, nameLen);
+		Socket *& slot = sockets[name];
+		delete slot;
+		slot = new Socket(handle);
+		++taken;
+	}
+
+	predecessor.send(&HANDOFF_ACK, 1);
+	return taken;
+}
+
+// --------------------------------------------------------------------------
+
+SocketHandoff::~SocketHandoff() {
+	_listener.close();
+	// a successor may have replaced the file with its own by now
+	struct stat st;
+	if (!_path.empty() && ::stat(_path.c_str(), &st) == 0 &&
+			st.st_dev == _dev && st.st_ino == _ino)
+		::unlink(_path.c_str());
+}
+
+END_NKF_NET
@@ -0,0 +1,153 @@
+/*
+ * SocketHandoff.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef SOCKETHANDOFF_H_
+#define SOCKETHANDOFF_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "net.h"
+#include "Socket.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * SocketHandoff passes listening and established sockets from a running
+ * process to its successor, so a daemon can be restarted without refusing
+ * or dropping a single connection.
+ *
+ * The old process creates a SocketHandoff on a well known Unix domain
+ * address, adds the sockets to pass on, and watches socket() for a
+ * successor to connect:
+ *
+ * \code
+ * SocketHandoff handoff(Address::unixAbstract("aggregator.handoff"));
+ * handoff.add("listener", listener);
+ * // ... in the event loop:
+ * work = master;	// contains handoff.socket()
+ * SocketSet::select(&work, NULL, NULL, tv);
+ * if (work.isSet(handoff.socket()) && handoff.serve()) {
+ *   // successor owns the sockets now, stop using them and exit
+ * }
+ * \endcode
+ *
+ * The new process takes the sockets over when it starts:
+ *
+ * \code
+ * std::map<std::string, Socket*> inherited;
+ * SocketHandoff::take(Address::unixAbstract("aggregator.handoff"), inherited, mktv(5, 0));
+ * Socket * listener = inherited["listener"];	// NULL if not inherited
+ * \endcode
+ *
+ * Both processes refer to the same kernel sockets, so pending connections
+ * and data remain queued in the kernel during the handoff. Data already
+ * read by the old process but not yet processed is not passed on, so the
+ * old process should stop reading from established connections before
+ * serving the handoff.
+ *
+ * Posix only.
+ */
+class NKFNET_API SocketHandoff {
+public:
+	/**
+	 * Creates a handoff point on the given Unix domain address, on which
+	 * a successor can connect. For a path address, an existing socket
+	 * file is replaced, and the destructor removes the file only while
+	 * it is still the one created here, so a successor which already
+	 * bound the path in turn keeps it.
+	 *
+	 * \param	addr	The Unix domain address to listen on.
+	 */
+	SocketHandoff(const Address & addr);
+
+	/**
+	 * Adds a socket to be passed on. The socket must stay valid until
+	 * serve() returns.
+	 *
+	 * \param	name	The name under which the successor finds the socket.
+	 * \param	sock	The socket to pass on.
+	 */
+	void	add(const std::string & name, Socket & sock);
+
+	/**
+	 * Removes a socket added earlier, e.g. when a connection is closed.
+	 *
+	 * \param	name	The name of the socket.
+	 */
+	void	remove(const std::string & name);
+
+	/**
+	 * Returns the listening socket a successor connects to, which can be
+	 * added to a SocketSet.
+	 *
+	 * \return	The listening socket.
+	 */
+	Socket & socket();
+
+	/**
+	 * Accepts a successor and passes all sockets on. Blocks until a
+	 * successor connects, then waits at most 5 seconds for it to take the
+	 * sockets.
+	 *
+	 * \return	true if the successor acknowledged having taken all sockets,
+	 * 			false if it disconnected prematurely or timed out.
+	 */
+	bool	serve();
+
+	/**
+	 * Accepts a successor and passes all sockets on. Blocks until a
+	 * successor connects.
+	 *
+	 * \param	timeout		The maximum time to wait for the successor on
+	 * 						each record sent and for its acknowledgement.
+	 *
+	 * \return	true if the successor acknowledged having taken all sockets,
+	 * 			false if it disconnected prematurely or timed out.
+	 */
+	bool	serve(timeval timeout);
+
+	/**
+	 * Connects to a process serving a handoff and takes over its sockets.
+	 *
+	 * \param	addr		The Unix domain address of the handoff point.
+	 * \param	sockets		Receives the sockets by name. The caller becomes
+	 * 						the owner of the sockets.
+	 * \param	timeout		The maximum time to wait for the connection.
+	 *
+	 * \return				The number of sockets taken over.
+	 */
+	static size_t take(const Address & addr, std::map<std::string, Socket*> & sockets,
+			timeval timeout);
+
+	/**
+	 * Destroys the handoff point. Sockets added are not closed.
+	 */
+	virtual ~SocketHandoff();
+
+private:
+	SocketHandoff(const SocketHandoff &);
+
+	SocketHandoff & operator=(const SocketHandoff &);
+
+	Socket		_listener;
+
+	std::string	_path;
+
+	dev_t		_dev;		// of the socket file at _path
+
+	ino_t		_ino;
+
+	std::vector<std::pair<std::string, SOCKET> > _sockets;
+};
+
+END_NKF_NET
+
+#endif /* SOCKETHANDOFF_H_ */
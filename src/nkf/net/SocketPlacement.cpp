@@ -0,0 +1,186 @@
+/*
+ * SocketPlacement.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "SocketPlacement.h"
+#include "SocketException.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <dirent.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED	1
+#endif
+
+START_NKF_NET
+
+// --------------------------------------------------------------------------
+// SocketPlacement
+// --------------------------------------------------------------------------
+
+SocketPlacement::SocketPlacement() {
+}
+
+// --------------------------------------------------------------------------
+
+Placement SocketPlacement::place(Socket & sock, PlacementMode mode) {
+	Placement p;
+	p.cpu = sock.incomingCpu();
+	p.node = p.cpu >= 0 ? nodeOfCpu(p.cpu) : -1;
+	p.napiId = sock.incomingNapiId();
+	p.thread = ::syscall(SYS_gettid);
+	p.pinned = false;
+
+	if (p.cpu >= 0 && mode != PLACE_NONE) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (mode == PLACE_NODE && p.node >= 0) {
+			std::vector<int> cpus = cpusOfNode(p.node);
+			for (size_t i = 0; i < cpus.size(); ++i) CPU_SET(cpus[i], &set);
+		}
+		if (CPU_COUNT(&set) == 0) {
+			// PLACE_CPU, or the CPUs of the node could not be read
+			CPU_SET(p.cpu, &set);
+		}
+		RoR(::sched_setaffinity(0, sizeof(set), &set));
+		p.pinned = true;
+	}
+
+	std::lock_guard<std::mutex> guard(_lock);
+	_placements[sock.handle()] = p;
+	return p;
+}
+
+// --------------------------------------------------------------------------
+
+Placement SocketPlacement::placement(Socket & sock) {
+	std::lock_guard<std::mutex> guard(_lock);
+	std::map<SOCKET, Placement>::iterator it = _placements.find(sock.handle());
+	if (it != _placements.end()) return it->second;
+
+	Placement p;
+	p.cpu = -1;
+	p.node = -1;
+	p.napiId = 0;
+	p.thread = 0;
+	p.pinned = false;
+	return p;
+}
+
+// --------------------------------------------------------------------------
+
+void SocketPlacement::forget(Socket & sock) {
+	std::lock_guard<std::mutex> guard(_lock);
+	_placements.erase(sock.handle());
+}
+
+// --------------------------------------------------------------------------
+
+void * SocketPlacement::allocate(Socket & sock, size_t size) {
+	int node = placement(sock).node;
+
+	void * mem = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED) SocketException::raiseLastError();
+
+	if (node >= 0) {
+		// Prefer the node, but do not fail if it runs out of memory. Pages
+		// are only placed when first touched, so the policy must be set
+		// before using the memory.
+		unsigned long mask[16];
+		memset(mask, 0, sizeof(mask));
+		if (static_cast<size_t> (node) < sizeof(mask) * 8) {
+			mask[node / (sizeof(long) * 8)] |= 1UL << (node % (sizeof(long) * 8));
+			// ENOSYS: a kernel without NUMA support, all memory is local
+			if (::syscall(SYS_mbind, mem, size, MPOL_PREFERRED, mask, sizeof(mask) * 8, 0) != 0
+					&& errno != ENOSYS) {
+				int code = errno;
+				::munmap(mem, size);
+				throw SocketException(strerror(code), code);
+			}
+		}
+	}
+	return mem;
+}
+
+// --------------------------------------------------------------------------
+
+void SocketPlacement::free(void * mem, size_t size) {
+	if (mem != NULL) ::munmap(mem, size);
+}
+
+// --------------------------------------------------------------------------
+
+std::string SocketPlacement::report() {
+	std::lock_guard<std::mutex> guard(_lock);
+	std::ostringstream ss;
+	for (std::map<SOCKET, Placement>::iterator it = _placements.begin(); it != _placements.end(); ++it) {
+		const Placement & p = it->second;
+		ss << "socket " << it->first << ": cpu " << p.cpu << ", node " << p.node
+				<< ", napi " << p.napiId << ", thread " << p.thread
+				<< (p.pinned ? " (pinned)" : "") << std::endl;
+	}
+	return ss.str();
+}
+
+// --------------------------------------------------------------------------
+
+int SocketPlacement::nodeOfCpu(int cpu) {
+	std::ostringstream path;
+	path << "/sys/devices/system/cpu/cpu" << cpu;
+
+	DIR * dir = ::opendir(path.str().c_str());
+	if (dir == NULL) return -1;
+
+	int node = -1;
+	dirent * entry;
+	while ((entry = ::readdir(dir)) != NULL) {
+		if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+			node = atoi(entry->d_name + 4);
+			break;
+		}
+	}
+	::closedir(dir);
+	return node;
+}
+
+// --------------------------------------------------------------------------
+
+std::vector<int> SocketPlacement::cpusOfNode(int node) {
+	std::vector<int> cpus;
+	std::ostringstream path;
+	path << "/sys/devices/system/node/node" << node << "/cpulist";
+
+	FILE * f = ::fopen(path.str().c_str(), "r");
+	if (f == NULL) return cpus;
+
+	// format: 0-3,8-11
+	int first, last;
+	char sep;
+	while (fscanf(f, "%d", &first) == 1) {
+		last = first;
+		sep = fgetc(f);
+		if (sep == '-') {
+			if (fscanf(f, "%d", &last) != 1) break;
+			sep = fgetc(f);
+		}
+		for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+		if (sep != ',') break;
+	}
+	::fclose(f);
+	return cpus;
+}
+
+// --------------------------------------------------------------------------
+
+SocketPlacement::~SocketPlacement() {
+}
+
+END_NKF_NET
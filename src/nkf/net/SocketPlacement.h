@@ -0,0 +1,170 @@
+/*
+ * SocketPlacement.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef SOCKETPLACEMENT_H_
+#define SOCKETPLACEMENT_H_
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "net.h"
+#include "Socket.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * How SocketPlacement pins a worker thread.
+ */
+enum PlacementMode {
+	PLACE_NONE /* < Only record the placement */,
+	PLACE_CPU /* < Pin to the CPU processing the socket's packets */,
+	PLACE_NODE /* < Pin to all CPUs of that CPU's NUMA node */
+};
+
+/**
+ * The placement of a socket, as recorded by SocketPlacement.
+ */
+struct NKFNET_API Placement {
+	/** The CPU processing incoming packets, or -1 if unknown. */
+	int				cpu;
+	/** The NUMA node of that CPU, or -1 if unknown. */
+	int				node;
+	/** The NAPI id of the receive queue, or 0 if unknown. */
+	unsigned int	napiId;
+	/** The thread id of the worker owning the socket. */
+	long			thread;
+	/** Whether the worker thread has been pinned. */
+	bool			pinned;
+};
+
+/**
+ * SocketPlacement keeps the worker thread handling a socket, and the
+ * socket's buffers, on the CPU or NUMA node where the kernel processes
+ * the socket's packets.
+ *
+ * The kernel reports the CPU which last processed incoming data for a
+ * socket (Socket::incomingCpu), so placement should be done after the
+ * first data has been received:
+ *
+ * \code
+ * SocketPlacement placement;
+ * // in the worker thread owning 'sock':
+ * sock.receive(buf, len);
+ * Placement p = placement.place(sock, PLACE_NODE);
+ * char * bufs = static_cast<char*>(placement.allocate(sock, 4 * 1024 * 1024));
+ * \endcode
+ *
+ * The recorded placement of every socket can be queried with placement()
+ * and report(). All functions are thread safe.
+ *
+ * Linux only.
+ */
+class NKFNET_API SocketPlacement {
+public:
+	/**
+	 * Creates a new, empty placement registry.
+	 */
+	SocketPlacement();
+
+	/**
+	 * Determines where the socket's packets are processed, records it, and
+	 * pins the calling thread accordingly.
+	 *
+	 * If the CPU is not known yet, the calling thread is not pinned.
+	 *
+	 * \param	sock	The socket owned by the calling thread.
+	 * \param	mode	How to pin the calling thread.
+	 *
+	 * \return			The placement.
+	 */
+	Placement place(Socket & sock, PlacementMode mode);
+
+	/**
+	 * Returns the recorded placement of a socket.
+	 *
+	 * \param	sock	The socket.
+	 *
+	 * \return			The placement, with cpu and node -1 if the socket was
+	 * 					never placed.
+	 */
+	Placement placement(Socket & sock);
+
+	/**
+	 * Removes the recorded placement of a socket, e.g. before closing it.
+	 *
+	 * \param	sock	The socket.
+	 */
+	void	forget(Socket & sock);
+
+	/**
+	 * Allocates memory on the NUMA node of a placed socket. If the node is
+	 * not known, memory is allocated as usual. The memory is page aligned.
+	 * Throws if the memory policy of the node can not be set, unless the
+	 * kernel has no NUMA support.
+	 *
+	 * \param	sock	The socket.
+	 * \param	size	The size in bytes.
+	 *
+	 * \return			The memory, to be freed with free().
+	 */
+	void *	allocate(Socket & sock, size_t size);
+
+	/**
+	 * Frees memory allocated with allocate().
+	 *
+	 * \param	mem		The memory.
+	 * \param	size	The size in bytes, as passed to allocate().
+	 */
+	static void free(void * mem, size_t size);
+
+	/**
+	 * Returns a human readable overview of all placements, one socket per
+	 * line.
+	 *
+	 * \return	The report.
+	 */
+	std::string report();
+
+	/**
+	 * Returns the NUMA node of a CPU.
+	 *
+	 * \param	cpu		The CPU number.
+	 *
+	 * \return			The node, or -1 if unknown.
+	 */
+	static int nodeOfCpu(int cpu);
+
+	/**
+	 * Returns the CPUs of a NUMA node.
+	 *
+	 * \param	node	The node number.
+	 *
+	 * \return			The CPU numbers.
+	 */
+	static std::vector<int> cpusOfNode(int node);
+
+	/**
+	 * Destroys the registry.
+	 */
+	virtual ~SocketPlacement();
+
+private:
+	SocketPlacement(const SocketPlacement &);
+
+	SocketPlacement & operator=(const SocketPlacement &);
+
+	std::mutex					_lock;
+
+	std::map<SOCKET, Placement>	_placements;
+};
+
+END_NKF_NET
+
+#endif /* SOCKETPLACEMENT_H_ */
@@ -7,6 +7,8 @@
 
 #include "SocketSet.h"
 #include "SocketException.h"
+#include "PerfCounters.h"
+#include "SocketTrace.h"
 
 START_NKF_NET
 
@@ -60,8 +62,16 @@ void SocketSet::zero() {
 // --------------------------------------------------------------------------
 
 void SocketSet::set(Socket & sock) {
+	set(sock.handle());
+}
+
+// --------------------------------------------------------------------------
 
-	SOCKET handle = sock.handle();
+void SocketSet::set(SOCKET handle) {
+#ifndef WIN32_API
+	if (handle < 0 || handle >= FD_SETSIZE)
+		throw SocketException("Socket handle out of range for SocketSet", EINVAL);
+#endif
 	FD_SET(handle, &_fd_set);
 	if (handle > _fd_max) {
 		_fd_max = handle;
@@ -70,14 +80,43 @@ void SocketSet::set(Socket & sock) {
 
 // --------------------------------------------------------------------------
 
+void SocketSet::clear(Socket & sock) {
+	clear(sock.handle());
+}
+
+// --------------------------------------------------------------------------
+
+void SocketSet::clear(SOCKET handle) {
+#ifndef WIN32_API
+	if (handle < 0 || handle >= FD_SETSIZE) return;
+#endif
+	FD_CLR(handle, &_fd_set);
+}
+
+// --------------------------------------------------------------------------
+
 bool SocketSet::isSet(Socket & sock) {
-	return FD_ISSET(sock.handle(), &_fd_set);
+	return isSet(sock.handle());
+}
+
+// --------------------------------------------------------------------------
+
+bool SocketSet::isSet(SOCKET handle) {
+	return FD_ISSET(handle, &_fd_set);
 }
 
 // --------------------------------------------------------------------------
 
-int SocketSet::select(SocketSet * read, SocketSet * write, SocketSet * error, timeval & timeout)
+int SocketSet::select(SocketSet * read, SocketSet * write, SocketSet * error, const timeval & timeout)
 {
+	PerfRegion perf("SocketSet::select");
+
+	// select may modify the timeout, and rejects FOREVER's microseconds
+	timeval tv = timeout;
+	bool forever = timeout.tv_usec >= 1000000;
+	TraceScope trace(TRACE_SELECT, INVALID_SOCKET, forever ? ~0ULL :
+			static_cast<unsigned long long> (timeout.tv_sec) * 1000000ULL + timeout.tv_usec);
+
 	SOCKET max = 0;
 	if (read != NULL && read->_fd_max > max) max = read->_fd_max;
 	if (write != NULL && write->_fd_max > max) max = write->_fd_max;
@@ -86,9 +125,9 @@ int SocketSet::select(SocketSet * read, SocketSet * write, SocketSet * error, ti
 			read != NULL ? &read->_fd_set : NULL,
 			write != NULL ? &write->_fd_set : NULL,
 			error != NULL ? &error->_fd_set : NULL,
-			&timeout);
+			forever ? NULL : &tv);
 	if (r < 0) SocketException::raiseLastError();
-	return r;
+	return trace.result(r);
 }
 
 // --------------------------------------------------------------------------
@@ -95,15 +95,45 @@ public:
 	void	zero();
 
 	/**
-	 * Adds a Socket to this set.
+	 * Adds a Socket to this set. On Posix systems the socket handle must
+	 * be below FD_SETSIZE, else a SocketException is thrown.
 	 */
 	void	set(Socket & sock);
 
+	/**
+	 * Adds a raw handle to this set, e.g. the handle of an event object
+	 * which is not a Socket. The same restrictions as set(Socket &) apply.
+	 *
+	 * \param	handle	The handle / file descriptor to add.
+	 */
+	void	set(SOCKET handle);
+
+	/**
+	 * Removes a Socket from this set.
+	 *
+	 * \param	sock	The socket to remove.
+	 */
+	void	clear(Socket & sock);
+
+	/**
+	 * Removes a raw handle from this set.
+	 *
+	 * \param	handle	The handle / file descriptor to remove.
+	 */
+	void	clear(SOCKET handle);
+
 	/**
 	 * Checks if a socket is set in this set.
 	 */
 	bool	isSet(Socket & sock);
 
+	/**
+	 * Checks if a raw handle is set in this set.
+	 *
+	 * \param	handle	The handle / file descriptor to check.
+	 */
+	bool	isSet(SOCKET handle);
+
 
 	/**
 	 * Executes a select call on the specified sockets sets. The SocketSets's contents will be
@@ -112,11 +142,12 @@ public:
 	 * \param	read	Check which sockets are ready for read, or connected.
 	 * \param	write	Check which sockets are ready for writing.
 	 * \param	error	Check which sockets have an error.
-	 * \param	timeout	Check for this period of time.
+	 * \param	timeout	Check for this period of time, or FOREVER to wait
+	 * 					until a socket is ready.
 	 *
 	 * \return	The number of sockets that have changed, may be 0.
 	 */
-	static	int	select(SocketSet * read, SocketSet * write, SocketSet * error, timeval & timeout);
+	static	int	select(SocketSet * read, SocketSet * write, SocketSet * error, const timeval & timeout);
 
 
 
@@ -0,0 +1,461 @@
+/*
+ * SocketTrace.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "SocketTrace.h"
+#include "SocketException.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <time.h>
+
+#ifndef WIN32_API
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+START_NKF_NET
+
+/*
+ * Every thread owns one ring, which only it writes: it stores the event in
+ * the slot of 'head' and then publishes it by raising 'head'. A dump reads
+ * 'head', copies the events below it straight from the ring, and reads
+ * 'head' again after; the reader drops the events which the thread may have
+ * overwritten in between. The slot being written is never copied, so a
+ * ring of N slots yields at most N - 1 events.
+ *
+ * Rings are only ever added to 'rings', never freed, so a dump from a
+ * signal handler can walk them without locks, using only write(2).
+ *
+ * Time stamp counter values are converted to time with the counter and the
+ * clocks read at enable() and at the dump.
+ */
+
+static const char		TRACE_MAGIC[8] = { 'N', 'K', 'F', 'T', 'R', 'C', '0', '1' };
+
+static const uint32_t	TRACE_BOM = 0x01020304;
+
+static const size_t		MAX_RINGS = 1024;
+
+struct TraceFileHeader {
+	char		magic[8];
+	uint32_t	bom;
+	uint32_t	eventSize;		// sizeof(TraceEvent)
+	uint64_t	startTicks;		// counter at enable()
+	uint64_t	startTime;		// CLOCK_REALTIME at enable(), ns
+	uint64_t	startMono;		// CLOCK_MONOTONIC at enable(), ns
+	uint64_t	dumpTicks;		// counter at the dump
+	uint64_t	dumpMono;		// CLOCK_MONOTONIC at the dump, ns
+};
+
+struct TraceRingHeader {
+	int32_t		thread;
+	uint32_t	size;			// slots in the ring
+	uint64_t	first;			// index of the first event
+	uint64_t	count;			// events which follow
+};
+
+// followed by a uint64_t, the head of the ring after the events were written
+
+struct TraceRing {
+	std::atomic<uint64_t>	head;
+	uint64_t				mask;
+	std::atomic<int>		thread;
+	std::atomic<bool>		owned;
+	std::atomic<uint64_t>	retired;	// order in which the owner ended
+	TraceEvent *			events;
+};
+
+static std::atomic<TraceRing*>	rings[MAX_RINGS];
+
+static std::atomic<size_t>		ringCount(0);
+
+static std::atomic<uint64_t>	retirements(0);
+
+static std::atomic<size_t>		ringSize(4096);
+
+static std::atomic<uint64_t>	startTicks(0);
+
+static std::atomic<uint64_t>	startTime(0);
+
+static std::atomic<uint64_t>	startMono(0);
+
+static char						signalPaths[2][4096];
+
+static std::atomic<const char*>	signalPath(NULL);	// one of signalPaths
+
+static thread_local TraceRing *	currentRing = NULL;
+
+static thread_local bool		noRing = false;		// all rings taken
+
+std::atomic<bool> SocketTrace::_enabled(false);
+
+// --------------------------------------------------------------------------
+
+static uint64_t clockNanoseconds(clockid_t clock) {
+	timespec ts;
+	clock_gettime(clock, &ts);
+	return static_cast<uint64_t> (ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// --------------------------------------------------------------------------
+
+static int threadId() {
+#if defined(__linux__) && defined(SYS_gettid)
+	return static_cast<int> (::syscall(SYS_gettid));
+#else
+	static std::atomic<int> next(1);
+	static thread_local int id = next.fetch_add(1);
+	return id;
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+// Releases the ring of a thread when it ends
+struct TraceRingOwner {
+	TraceRing *	ring;
+
+	~TraceRingOwner() {
+		if (ring == NULL) return;
+		ring->retired.store(retirements.fetch_add(1) + 1);
+		ring->owned.store(false);
+	}
+};
+
+static thread_local TraceRingOwner ringOwner = { NULL };
+
+// --------------------------------------------------------------------------
+
+static TraceRing * acquireRing() {
+	if (ringCount.load() < MAX_RINGS) {
+		size_t size = ringSize.load();
+		TraceRing * ring = new TraceRing();
+		ring->head.store(0);
+		ring->mask = size - 1;
+		ring->thread.store(threadId());
+		ring->owned.store(true);
+		ring->retired.store(0);
+		ring->events = new TraceEvent[size];
+
+		size_t index = ringCount.fetch_add(1);
+		if (index < MAX_RINGS) {
+			rings[index].store(ring, std::memory_order_release);
+			return ring;
+		}
+		ringCount.fetch_sub(1);
+		delete [] ring->events;
+		delete ring;
+	}
+
+	// all rings taken, reuse the one of the thread which ended first
+	for (;;) {
+		TraceRing * oldest = NULL;
+		for (size_t i = 0; i < MAX_RINGS; ++i) {
+			TraceRing * ring = rings[i].load(std::memory_order_acquire);
+			if (ring == NULL || ring->owned.load()) continue;
+			if (oldest == NULL || ring->retired.load() < oldest->retired.load())
+				oldest = ring;
+		}
+		if (oldest == NULL) return NULL;
+
+		bool expected = false;
+		if (oldest->owned.compare_exchange_strong(expected, true)) {
+			oldest->thread.store(threadId());
+			oldest->head.store(0);
+			return oldest;
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+
+static bool writeAll(int fd, const void * buf, size_t len) {
+	const char * data = static_cast<const char*> (buf);
+	while (len > 0) {
+		ssize_t bytes = ::write(fd, data, len);
+		if (bytes < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		data += bytes;
+		len -= bytes;
+	}
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+// Only async-signal-safe calls, this runs from the signal handler
+static bool dumpTo(int fd) {
+	TraceFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+	header.bom = TRACE_BOM;
+	header.eventSize = sizeof(TraceEvent);
+	header.startTicks = startTicks.load();
+	header.startTime = startTime.load();
+	header.startMono = startMono.load();
+	header.dumpTicks = SocketTrace::timestamp();
+	header.dumpMono = clockNanoseconds(CLOCK_MONOTONIC);
+	if (!writeAll(fd, &header, sizeof(header))) return false;
+
+	size_t count = ringCount.load();
+	if (count > MAX_RINGS) count = MAX_RINGS;
+	for (size_t i = 0; i < count; ++i) {
+		TraceRing * ring = rings[i].load(std::memory_order_acquire);
+		if (ring == NULL) continue;		// being added
+
+		uint64_t size = ring->mask + 1;
+		uint64_t head = ring->head.load(std::memory_order_acquire);
+		uint64_t events = head < size - 1 ? head : size - 1;
+
+		TraceRingHeader rh;
+		memset(&rh, 0, sizeof(rh));
+		rh.thread = ring->thread.load();
+		rh.size = static_cast<uint32_t> (size);
+		rh.first = head - events;
+		rh.count = events;
+		if (!writeAll(fd, &rh, sizeof(rh))) return false;
+
+		// oldest to newest, in two parts if they wrap around
+		uint64_t start = rh.first & ring->mask;
+		uint64_t part = size - start < events ? size - start : events;
+		if (!writeAll(fd, ring->events + start, part * sizeof(TraceEvent))) return false;
+		if (!writeAll(fd, ring->events, (events - part) * sizeof(TraceEvent))) return false;
+
+		uint64_t after = ring->head.load(std::memory_order_acquire);
+		if (!writeAll(fd, &after, sizeof(after))) return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+#ifndef WIN32_API
+static void dumpSignalHandler(int) {
+	int saved = errno;
+	int fd = ::open(signalPath.load(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd >= 0) {
+		dumpTo(fd);
+		::close(fd);
+	}
+	errno = saved;
+}
+#endif
+
+// --------------------------------------------------------------------------
+// SocketTrace
+// --------------------------------------------------------------------------
+
+void SocketTrace::enable(size_t events) {
+	size_t size = 2;
+	while (size < events) size <<= 1;
+	ringSize.store(size);
+
+	startTicks.store(timestamp());
+	startTime.store(clockNanoseconds(CLOCK_REALTIME));
+	startMono.store(clockNanoseconds(CLOCK_MONOTONIC));
+	_enabled.store(true);
+}
+
+// --------------------------------------------------------------------------
+
+void SocketTrace::disable() {
+	_enabled.store(false);
+}
+
+// --------------------------------------------------------------------------
+
+void SocketTrace::dump(const std::string & path) {
+#ifdef WIN32_API
+	throw SocketException("Trace dumps not supported on this platform", 0);
+#else
+	int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		SocketException::raiseLastError();
+	if (!dumpTo(fd)) {
+		int code = errno;
+		::close(fd);
+		throw SocketException(strerror(code), code);
+	}
+	if (::close(fd) != 0)
+		SocketException::raiseLastError();
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+void SocketTrace::dumpOnSignal(int signal, const std::string & path) {
+#ifdef WIN32_API
+	throw SocketException("Trace dumps not supported on this platform", 0);
+#else
+	if (path.size() >= sizeof(signalPaths[0]))
+		throw SocketException("Trace file path too long", ENAMETOOLONG);
+
+	// the new path is copied into the buffer which is not in use, and
+	// published whole; a handler which runs meanwhile uses the old one
+	const char * current = signalPath.load();
+	char * next = current == signalPaths[0] ? signalPaths[1] : signalPaths[0];
+	memcpy(next, path.c_str(), path.size() + 1);
+	signalPath.store(next);
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = dumpSignalHandler;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	if (::sigaction(signal, &action, NULL) != 0)
+		SocketException::raiseLastError();
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+const char * SocketTrace::opName(int op) {
+	static const char * const names[] = {
+		"unknown", "open", "close", "setOption", "getOption", "connect", "bind",
+		"listen", "accept", "send", "sendVector", "sendBatch", "sendFile",
+		"sendSegmented", "sendAt", "sendHandles", "receive", "receiveBatch",
+		"receiveCoalesced", "receiveHandles", "select"
+	};
+	if (op < 0 || op >= static_cast<int> (sizeof(names) / sizeof(names[0])))
+		return names[0];
+	return names[op];
+}
+
+// --------------------------------------------------------------------------
+
+void SocketTrace::record(const TraceEvent & event) {
+	TraceRing * ring = currentRing;
+	if (ring == NULL) {
+		if (noRing) return;
+		int saved = errno;		// callers may still look at it
+		ring = acquireRing();
+		errno = saved;
+		if (ring == NULL) {
+			noRing = true;
+			return;
+		}
+		currentRing = ring;
+		ringOwner.ring = ring;
+	}
+
+	uint64_t head = ring->head.load(std::memory_order_relaxed);
+	ring->events[head & ring->mask] = event;
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+// --------------------------------------------------------------------------
+// TraceScope
+// --------------------------------------------------------------------------
+
+void TraceScope::end() {
+	_event.end = SocketTrace::timestamp();
+	if (std::uncaught_exceptions() > _exceptions) {
+		_event.flags |= TRACE_FAILED;
+		_event.result = -errno;
+	}
+	SocketTrace::record(_event);
+}
+
+// --------------------------------------------------------------------------
+// TraceReader
+// --------------------------------------------------------------------------
+
+static bool lessByTime(const TraceRecord & a, const TraceRecord & b) {
+	return a.time < b.time;
+}
+
+TraceReader::TraceReader(const std::string & path) :
+	_ticksPerNs(1.0) {
+#ifdef WIN32_API
+	throw SocketException("Trace files not supported on this platform", 0);
+#else
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		SocketException::raiseLastError();
+
+	struct stat st;
+	if (::fstat(fd, &st) != 0) {
+		::close(fd);
+		SocketException::raiseLastError();
+	}
+	size_t size = st.st_size;
+
+	if (size < sizeof(TraceFileHeader)) {
+		::close(fd);
+		throw SocketException("Not a trace file", EINVAL);
+	}
+
+	void * map = ::mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (map == MAP_FAILED)
+		SocketException::raiseLastError();
+	const char * data = static_cast<const char*> (map);
+
+	TraceFileHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0) {
+		::munmap(map, size);
+		throw SocketException("Not a trace file", EINVAL);
+	}
+	if (header.bom != TRACE_BOM || header.eventSize != sizeof(TraceEvent)) {
+		::munmap(map, size);
+		throw SocketException("Trace file has a different byte order or layout", EINVAL);
+	}
+
+	if (header.dumpTicks > header.startTicks && header.dumpMono > header.startMono) {
+		_ticksPerNs = static_cast<double> (header.dumpTicks - header.startTicks) /
+				(header.dumpMono - header.startMono);
+	}
+
+	size_t pos = sizeof(header);
+	while (pos + sizeof(TraceRingHeader) <= size) {
+		TraceRingHeader rh;
+		memcpy(&rh, data + pos, sizeof(rh));
+		pos += sizeof(rh);
+		if (rh.count > (size - pos) / sizeof(TraceEvent)) break;	// truncated
+		const char * events = data + pos;
+		pos += rh.count * sizeof(TraceEvent);
+		if (pos + sizeof(uint64_t) > size) break;
+		uint64_t after;
+		memcpy(&after, data + pos, sizeof(after));
+		pos += sizeof(after);
+
+		// the thread may have overwritten events up to after - size
+		uint64_t valid = after >= rh.size ? after - rh.size + 1 : 0;
+		for (uint64_t i = 0; i < rh.count; ++i) {
+			if (rh.first + i < valid) continue;
+			TraceRecord rec;
+			memcpy(&rec.event, events + i * sizeof(TraceEvent), sizeof(TraceEvent));
+			double offset = static_cast<int64_t> (rec.event.start - header.startTicks) / _ticksPerNs;
+			rec.time = header.startTime + static_cast<long long> (offset);
+			rec.duration = rec.event.end > rec.event.start ?
+					static_cast<unsigned long long> ((rec.event.end - rec.event.start) / _ticksPerNs) : 0;
+			rec.thread = rh.thread;
+			_records.push_back(rec);
+		}
+	}
+	::munmap(map, size);
+
+	std::stable_sort(_records.begin(), _records.end(), lessByTime);
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+TraceReader::~TraceReader() {
+}
+
+END_NKF_NET
@@ -0,0 +1,325 @@
+/*
+ * SocketTrace.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef SOCKETTRACE_H_
+#define SOCKETTRACE_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <exception>
+#include <string>
+#include <vector>
+#include "net.h"
+
+#if !defined(__x86_64__) && !defined(__i386__) && !defined(__aarch64__)
+#include <chrono>
+#endif
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * The operations recorded by SocketTrace. What the argument of an event
+ * holds depends on the operation.
+ */
+enum TraceOp {
+	TRACE_OPEN = 1,				/**< Socket created, argument is the type. */
+	TRACE_CLOSE,				/**< Socket::close. */
+	TRACE_SET_OPTION,			/**< Argument is level << 32 | option. */
+	TRACE_GET_OPTION,			/**< Argument is level << 32 | option. */
+	TRACE_CONNECT,				/**< Argument is the IPv4 address << 16 | port. */
+	TRACE_BIND,					/**< Argument is the IPv4 address << 16 | port. */
+	TRACE_LISTEN,				/**< Argument is the backlog. */
+	TRACE_ACCEPT,				/**< Result is the new handle. */
+	TRACE_SEND,					/**< Argument is the length. */
+	TRACE_SEND_VECTOR,			/**< Argument is the number of buffers. */
+	TRACE_SEND_BATCH,			/**< Argument is the number of datagrams. */
+	TRACE_SEND_FILE,			/**< Argument is the length. */
+	TRACE_SEND_SEGMENTED,		/**< Argument is the length. */
+	TRACE_SEND_AT,				/**< Argument is the length. */
+	TRACE_SEND_HANDLES,			/**< Argument is the length. */
+	TRACE_RECEIVE,				/**< Argument is the size of the buffer. */
+	TRACE_RECEIVE_BATCH,		/**< Argument is the number of buffers. */
+	TRACE_RECEIVE_COALESCED,	/**< Argument is the size of the buffer. */
+	TRACE_RECEIVE_HANDLES,		/**< Argument is the size of the buffer. */
+	TRACE_SELECT				/**< Argument is the timeout in microseconds. */
+};
+
+/**
+ * An event as stored in the trace rings and files.
+ */
+struct NKFNET_API TraceEvent {
+	/** The time stamp counter at the start of the call. */
+	uint64_t	start;
+	/** The time stamp counter at the end of the call. */
+	uint64_t	end;
+	/** The result: bytes, count or handle, or minus errno if it failed. */
+	int64_t		result;
+	/** The argument, see TraceOp. */
+	uint64_t	arg;
+	/** The handle, -1 for none. */
+	int32_t		handle;
+	/** The operation, a TraceOp. */
+	uint16_t	op;
+	/** TRACE_FAILED if the call threw. */
+	uint16_t	flags;
+};
+
+/** TraceEvent::flags bit: the call threw an exception. */
+static const uint16_t TRACE_FAILED = 1;
+
+/**
+ * SocketTrace keeps the last socket calls of every thread in memory, to
+ * see what happened before an incident without running strace. It is off
+ * by default.
+ *
+ * Each thread writes to its own fixed-size ring of binary events, without
+ * locks or system calls; an event takes two reads of the time stamp
+ * counter and a 40 byte store. All calls of Socket and SocketSet which
+ * reach the kernel are recorded, with their handle, argument, result and
+ * duration.
+ *
+ * The rings are written to a file by dump(), or from a signal handler
+ * installed by dumpOnSignal(), which is safe to run at any time. The
+ * nkftrace tool decodes a file into a timeline, or use TraceReader.
+ *
+ * \code
+ * SocketTrace::enable();
+ * SocketTrace::dumpOnSignal(SIGUSR2, "/tmp/daq.nkftrace");
+ * // kill -USR2 <pid>; nkftrace /tmp/daq.nkftrace
+ * \endcode
+ *
+ * The file starts with the 8 byte magic "NKFTRC01" and a byte order mark,
+ * then the clock calibration, then per thread its id, the events, and the
+ * count of events written when the dump ended, so events overwritten
+ * while dumping are skipped. Numbers are in host byte order.
+ *
+ * A thread's ring is kept after the thread ends, and only reused by a new
+ * thread when the maximum number of rings is reached. Dumping is Posix
+ * only.
+ */
+class NKFNET_API SocketTrace {
+public:
+	/**
+	 * Starts recording. Rings are allocated when a thread records its
+	 * first event.
+	 *
+	 * \param	events	The number of events per thread, rounded up to a
+	 * 					power of two. Only used by threads which do not
+	 * 					have a ring yet.
+	 */
+	static void enable(size_t events = 4096);
+
+	/**
+	 * Stops recording, the rings are kept.
+	 */
+	static void disable();
+
+	/**
+	 * Checks whether recording is on.
+	 *
+	 * \return	true when recording.
+	 */
+	static bool enabled() {
+		return _enabled.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Writes the rings of all threads to a file.
+	 *
+	 * \param	path	The path of the file, replaced if it exists.
+	 */
+	static void dump(const std::string & path);
+
+	/**
+	 * Installs a handler which writes the rings to a file when the signal
+	 * arrives. It may be called again to change the path, even while the
+	 * signal is delivered, but not from two threads at once.
+	 *
+	 * \param	signal	The signal, e.g. SIGUSR2.
+	 * \param	path	The path of the file, replaced at each signal.
+	 */
+	static void dumpOnSignal(int signal, const std::string & path);
+
+	/**
+	 * Returns the name of an operation, e.g. "receive".
+	 *
+	 * \param	op		The operation.
+	 *
+	 * \return	The name.
+	 */
+	static const char * opName(int op);
+
+	/**
+	 * Reads the time stamp counter, or a clock in nanoseconds where there
+	 * is none.
+	 *
+	 * \return	The time stamp.
+	 */
+	static uint64_t timestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+		return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+		uint64_t value;
+		__asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(value));
+		return value;
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds> (
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	/**
+	 * Records an event in the ring of the calling thread.
+	 *
+	 * \param	event	The event.
+	 */
+	static void record(const TraceEvent & event);
+
+private:
+	SocketTrace();
+
+	static std::atomic<bool>	_enabled;
+};
+
+/**
+ * TraceScope records one call as an event when it goes out of scope,
+ * if SocketTrace is enabled.
+ *
+ * \code
+ * size_t Socket::send(const void * buf, size_t len) {
+ *     TraceScope trace(TRACE_SEND, _handle, len);
+ *     ...
+ *     return trace.result(bytes);
+ * }
+ * \endcode
+ *
+ * If the scope is left by an exception, the event is marked
+ * TRACE_FAILED, with minus errno as result.
+ */
+class NKFNET_API TraceScope {
+public:
+	/**
+	 * Starts a call.
+	 *
+	 * \param	op		The operation.
+	 * \param	handle	The handle.
+	 * \param	arg		The argument, see TraceOp.
+	 */
+	TraceScope(TraceOp op, SOCKET handle, unsigned long long arg) : _active(false) {
+		if (SocketTrace::enabled()) {
+			_event.start = SocketTrace::timestamp();
+			_event.result = 0;
+			_event.arg = arg;
+			_event.handle = static_cast<int32_t> (handle);
+			_event.op = static_cast<uint16_t> (op);
+			_event.flags = 0;
+			_exceptions = std::uncaught_exceptions();
+			_active = true;
+		}
+	}
+
+	/**
+	 * Sets the result of the call.
+	 *
+	 * \param	value	The result.
+	 *
+	 * \return			value
+	 */
+	template<typename T>
+	T		result(T value) {
+		_event.result = static_cast<int64_t> (value);
+		return value;
+	}
+
+	/**
+	 * Ends the call, and records it.
+	 */
+	~TraceScope() {
+		if (_active) end();
+	}
+
+private:
+	void	end();
+
+	TraceScope(const TraceScope &);
+
+	TraceScope & operator=(const TraceScope &);
+
+	bool		_active;
+
+	int			_exceptions;
+
+	TraceEvent	_event;
+};
+
+/**
+ * A decoded event, see TraceReader.
+ */
+struct NKFNET_API TraceRecord {
+	/** The start of the call, in nanoseconds since the epoch. */
+	unsigned long long	time;
+	/** The duration of the call in nanoseconds. */
+	unsigned long long	duration;
+	/** The id of the thread. */
+	int					thread;
+	/** The event, with time stamp counter values. */
+	TraceEvent			event;
+};
+
+/**
+ * TraceReader reads a file written by SocketTrace, and converts the time
+ * stamps to times.
+ *
+ * \code
+ * TraceReader trace("/tmp/daq.nkftrace");
+ * for (size_t i = 0; i < trace.records().size(); ++i) {
+ *     const TraceRecord & rec = trace.records()[i];
+ *     ...
+ * }
+ * \endcode
+ */
+class NKFNET_API TraceReader {
+public:
+	/**
+	 * Reads a trace file.
+	 *
+	 * \param	path	The path of the file.
+	 */
+	TraceReader(const std::string & path);
+
+	/**
+	 * Returns the events of all threads, in the order they started.
+	 *
+	 * \return	The events.
+	 */
+	const std::vector<TraceRecord> & records() const {
+		return _records;
+	}
+
+	/**
+	 * Returns the number of time stamp counter ticks per nanosecond,
+	 * measured between enabling and dumping.
+	 *
+	 * \return	The ticks per nanosecond.
+	 */
+	double	ticksPerNanosecond() const {
+		return _ticksPerNs;
+	}
+
+	virtual ~TraceReader();
+
+private:
+	std::vector<TraceRecord>	_records;
+
+	double						_ticksPerNs;
+};
+
+END_NKF_NET
+
+#endif /* SOCKETTRACE_H_ */
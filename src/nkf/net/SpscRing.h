@@ -0,0 +1,158 @@
+/*
+ * SpscRing.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef SPSCRING_H_
+#define SPSCRING_H_
+
+#include <atomic>
+#include "net.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * The assumed size of a cache line, used to keep data written by
+ * different threads apart.
+ */
+#define NKF_CACHE_LINE	64
+
+/**
+ * SpscRing is a bounded lock-free ring buffer for a single producer and a
+ * single consumer thread. The producer and consumer positions live in
+ * separate cache lines, and each side caches the other's position, so in
+ * the common case an operation touches no shared cache line but the slot.
+ *
+ * Besides popping by the consumer, the producer may also remove the
+ * oldest element with stealOldest(), to implement a drop-oldest policy.
+ * Because of this, T must be trivially copyable (e.g. a pointer), and the
+ * consumer only owns an element once pop() returned true.
+ */
+template <typename T>
+class SpscRing {
+public:
+	/**
+	 * Creates a ring which can hold at least the given number of elements.
+	 *
+	 * \param	capacity	The minimal capacity, rounded up to a power of two.
+	 */
+	SpscRing(size_t capacity) : _head(0), _tailCache(0), _tail(0), _headCache(0) {
+		size_t size = 2;
+		while (size < capacity) size <<= 1;
+		_slots = new std::atomic<T>[size];
+		_mask = size - 1;
+	}
+
+	/**
+	 * Destroys the ring.
+	 */
+	~SpscRing() {
+		delete [] _slots;
+	}
+
+	/**
+	 * Appends an element. Producer only.
+	 *
+	 * \param	value	The element to append.
+	 *
+	 * \return			false if the ring is full.
+	 */
+	bool push(const T & value) {
+		size_t head = _head.load(std::memory_order_relaxed);
+		if (head - _tailCache > _mask) {
+			_tailCache = _tail.load(std::memory_order_acquire);
+			if (head - _tailCache > _mask) return false;
+		}
+		_slots[head & _mask].store(value, std::memory_order_relaxed);
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Removes the oldest element. Consumer only.
+	 *
+	 * \param	value	Receives the element.
+	 *
+	 * \return			false if the ring is empty.
+	 */
+	bool pop(T & value) {
+		size_t tail = _tail.load(std::memory_order_relaxed);
+		while (true) {
+			// tail may pass a stale head cache when the producer steals
+			if (tail >= _headCache) {
+				_headCache = _head.load(std::memory_order_acquire);
+				if (tail >= _headCache) return false;
+			}
+			value = _slots[tail & _mask].load(std::memory_order_relaxed);
+			// the producer may have stolen this element meanwhile
+			if (_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_acq_rel,
+					std::memory_order_relaxed))
+				return true;
+		}
+	}
+
+	/**
+	 * Removes the oldest element on behalf of the producer, e.g. to make
+	 * room for a newer one. Producer only.
+	 *
+	 * \param	value	Receives the element.
+	 *
+	 * \return			false if the ring is empty.
+	 */
+	bool stealOldest(T & value) {
+		size_t head = _head.load(std::memory_order_relaxed);
+		size_t tail = _tail.load(std::memory_order_acquire);
+		while (tail != head) {
+			value = _slots[tail & _mask].load(std::memory_order_relaxed);
+			if (_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_acq_rel,
+					std::memory_order_acquire))
+				return true;
+		}
+		return false;
+	}
+
+	/**
+	 * Returns the number of elements in the ring. Only exact when called by
+	 * the producer or the consumer while the other is inactive.
+	 *
+	 * \return	The number of elements.
+	 */
+	size_t size() {
+		return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * Returns the capacity of the ring.
+	 *
+	 * \return	The maximum number of elements.
+	 */
+	size_t capacity() {
+		return _mask + 1;
+	}
+
+private:
+	SpscRing(const SpscRing &);
+
+	SpscRing & operator=(const SpscRing &);
+
+	// producer side
+	std::atomic<size_t>	_head;
+	size_t				_tailCache;
+	char				_pad0[NKF_CACHE_LINE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+	// consumer side
+	std::atomic<size_t>	_tail;
+	size_t				_headCache;
+	char				_pad1[NKF_CACHE_LINE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+	std::atomic<T> *	_slots;
+	size_t				_mask;
+};
+
+END_NKF_NET
+
+#endif /* SPSCRING_H_ */
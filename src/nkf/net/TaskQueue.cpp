@@ -0,0 +1,76 @@
+/*
+ * TaskQueue.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "TaskQueue.h"
+
+START_NKF_NET
+
+// --------------------------------------------------------------------------
+// TaskQueue
+// --------------------------------------------------------------------------
+
+TaskQueue::TaskQueue() :
+	_next(0) {
+}
+
+// --------------------------------------------------------------------------
+
+void TaskQueue::post(const Task & task) {
+	_queue.push(new Task(task));
+	_wakeup.wake();
+}
+
+// --------------------------------------------------------------------------
+
+size_t TaskQueue::run() {
+	// clear first, a task posted while running wakes us again
+	_wakeup.clear();
+
+	// only run what is queued now, so tasks posting tasks can not starve I/O
+	Task * task;
+	while (_queue.pop(task)) {
+		_batch.push_back(task);
+	}
+
+	size_t count = 0;
+	while (_next < _batch.size()) {
+		task = _batch[_next++];
+		try {
+			(*task)();
+		} catch (...) {
+			// the rest of the batch runs at the next call
+			delete task;
+			_wakeup.wake();
+			throw;
+		}
+		delete task;
+		++count;
+	}
+	_batch.clear();
+	_next = 0;
+	return count;
+}
+
+// --------------------------------------------------------------------------
+
+SOCKET TaskQueue::handle() {
+	return _wakeup.handle();
+}
+
+// --------------------------------------------------------------------------
+
+TaskQueue::~TaskQueue() {
+	for (size_t i = _next; i < _batch.size(); ++i) {
+		delete _batch[i];
+	}
+	Task * task;
+	while (_queue.pop(task)) {
+		delete task;
+	}
+}
+
+END_NKF_NET
@@ -0,0 +1,101 @@
+/*
+ * TaskQueue.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef TASKQUEUE_H_
+#define TASKQUEUE_H_
+
+#include <functional>
+#include <vector>
+#include "net.h"
+#include "MpscQueue.h"
+#include "Wakeup.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * TaskQueue lets any thread post work to be run on an I/O thread. Posting
+ * is lock-free and wakes the I/O thread through a Wakeup, whose handle
+ * the I/O thread adds to its SocketSet.
+ *
+ * \code
+ * TaskQueue tasks;
+ * // I/O thread:
+ * while (running) {
+ *   SocketSet read(sock);
+ *   read.set(tasks.handle());
+ *   SocketSet::select(&read, NULL, NULL, FOREVER);
+ *   if (read.isSet(tasks.handle())) tasks.run();
+ *   // ...
+ * }
+ * // any other thread:
+ * tasks.post([&sock, reply] { sock.send(reply.data(), reply.size()); });
+ * \endcode
+ *
+ * Tasks run in the order posted by each thread. If a task throws, the
+ * exception is passed on by run(), and the remaining tasks run at the
+ * next call. Tasks left when the queue is destroyed are dropped without
+ * running. Not supported on Windows.
+ */
+class NKFNET_API TaskQueue {
+public:
+	/**
+	 * A task, any callable without arguments.
+	 */
+	typedef std::function<void()> Task;
+
+	/**
+	 * Creates a new, empty task queue.
+	 */
+	TaskQueue();
+
+	/**
+	 * Posts a task. May be called from any thread.
+	 *
+	 * \param	task	The task to run on the I/O thread.
+	 */
+	void	post(const Task & task);
+
+	/**
+	 * Runs all tasks posted so far. Only to be called from the I/O thread.
+	 * A task may post new tasks, which run at the next call.
+	 *
+	 * \return	The number of tasks run.
+	 */
+	size_t	run();
+
+	/**
+	 * Returns the handle which becomes readable when tasks are posted, to
+	 * be added to the read set of a SocketSet.
+	 *
+	 * \return	The handle.
+	 */
+	SOCKET	handle();
+
+	/**
+	 * Destroys the queue, dropping tasks not yet run.
+	 */
+	virtual ~TaskQueue();
+
+private:
+	TaskQueue(const TaskQueue &);
+
+	TaskQueue & operator=(const TaskQueue &);
+
+	MpscQueue<Task *>	_queue;
+
+	std::vector<Task *>	_batch;
+
+	size_t				_next;
+
+	Wakeup				_wakeup;
+};
+
+END_NKF_NET
+
+#endif /* TASKQUEUE_H_ */
@@ -0,0 +1,196 @@
+/*
+ * TcpInfoSampler.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "TcpInfoSampler.h"
+#include "SocketException.h"
+#include <chrono>
+#include <cstring>
+
+START_NKF_NET
+
+/*
+ * A round takes the snapshots with '_lock' held, so remove() can not
+ * return while its socket is in use, and then reports them with only
+ * '_sampling' held, so a listener may call add() or remove().
+ */
+
+// --------------------------------------------------------------------------
+// TcpInfoSampler
+// --------------------------------------------------------------------------
+
+TcpInfoSampler::TcpInfoSampler(unsigned int interval) :
+	_running(false),
+	_interval(interval),
+	_rounds(0),
+	_listener(NULL),
+	_log(NULL) {
+}
+
+// --------------------------------------------------------------------------
+
+void TcpInfoSampler::add(Socket & sock, const std::string & name) {
+	Connection conn;
+	conn.sock = &sock;
+	conn.name = name;
+	memset(&conn.info, 0, sizeof(conn.info));
+	conn.sampled = false;
+
+	std::lock_guard<std::mutex> lock(_lock);
+	_connections.push_back(conn);
+}
+
+// --------------------------------------------------------------------------
+
+void TcpInfoSampler::remove(Socket & sock) {
+	std::lock_guard<std::mutex> lock(_lock);
+	for (size_t i = 0; i < _connections.size(); ++i) {
+		if (_connections[i].sock == &sock) {
+			_connections.erase(_connections.begin() + i);
+			return;
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void TcpInfoSampler::sample() {
+	std::lock_guard<std::mutex> sampling(_sampling);
+	TcpInfoListener * listener;
+	std::ostream * out;
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_samples.clear();
+		for (size_t i = 0; i < _connections.size(); ++i) {
+			Connection & conn = _connections[i];
+			Sample sample;
+			try {
+				sample.info = conn.sock->tcpInfo();
+			} catch (SocketException &) {
+				continue;	// closed, or not TCP
+			}
+			sample.name = conn.name;
+			sample.previous = conn.info;
+			conn.info = sample.info;
+			conn.sampled = true;
+			_samples.push_back(sample);
+		}
+		++_rounds;
+		listener = _listener;
+		out = _log;
+	}
+
+	for (size_t i = 0; i < _samples.size(); ++i) {
+		if (out != NULL) log(*out, _samples[i]);
+		if (listener != NULL) listener->sampled(_samples[i].name, _samples[i].info, _samples[i].previous);
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void TcpInfoSampler::log(std::ostream & out, const Sample & sample) {
+	const TcpInfo & info = sample.info;
+	const TcpInfo & prev = sample.previous;
+	unsigned long long busy = info.busyTime - prev.busyTime;
+	unsigned long long rwnd = info.rwndLimited - prev.rwndLimited;
+	unsigned long long sndbuf = info.sndbufLimited - prev.sndbufLimited;
+
+	out << "TcpInfoSampler: " << sample.name
+			<< " rtt " << info.rtt << "/" << info.rttVar << " us"
+			<< " cwnd " << info.cwnd
+			<< " in flight " << info.bytesInFlight << " B"
+			<< " retrans +" << info.totalRetrans - prev.totalRetrans
+			<< " rate " << info.deliveryRate / 1000000 << " MB/s"
+			<< " rwnd limited " << (busy > 0 ? rwnd * 100 / busy : 0) << "%"
+			<< " sndbuf limited " << (busy > 0 ? sndbuf * 100 / busy : 0) << "%"
+			<< std::endl;
+}
+
+// --------------------------------------------------------------------------
+
+void TcpInfoSampler::start() {
+	std::lock_guard<std::mutex> lock(_lock);
+	if (_running) return;
+	_running = true;
+	_thread = std::thread(&TcpInfoSampler::run, this);
+}
+
+// --------------------------------------------------------------------------
+
+void TcpInfoSampler::stop() {
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		if (!_running) return;
+		_running = false;
+	}
+	_wake.notify_all();
+	_thread.join();
+}
+
+// --------------------------------------------------------------------------
+
+void TcpInfoSampler::run() {
+	std::unique_lock<std::mutex> lock(_lock);
+	while (_running) {
+		std::chrono::steady_clock::time_point next =
+				std::chrono::steady_clock::now() + std::chrono::milliseconds(_interval);
+		while (_running && _wake.wait_until(lock, next) != std::cv_status::timeout) {
+		}
+		if (!_running) break;
+		lock.unlock();
+		sample();
+		lock.lock();
+	}
+}
+
+// --------------------------------------------------------------------------
+
+bool TcpInfoSampler::last(const std::string & name, TcpInfo * info) {
+	std::lock_guard<std::mutex> lock(_lock);
+	for (size_t i = 0; i < _connections.size(); ++i) {
+		if (_connections[i].name == name && _connections[i].sampled) {
+			*info = _connections[i].info;
+			return true;
+		}
+	}
+	return false;
+}
+
+// --------------------------------------------------------------------------
+
+void TcpInfoSampler::setInterval(unsigned int interval) {
+	std::lock_guard<std::mutex> lock(_lock);
+	_interval = interval;
+}
+
+// --------------------------------------------------------------------------
+
+void TcpInfoSampler::setListener(TcpInfoListener * listener) {
+	std::lock_guard<std::mutex> lock(_lock);
+	_listener = listener;
+}
+
+// --------------------------------------------------------------------------
+
+void TcpInfoSampler::setLog(std::ostream * log) {
+	std::lock_guard<std::mutex> lock(_lock);
+	_log = log;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long TcpInfoSampler::samples() {
+	std::lock_guard<std::mutex> lock(_lock);
+	return _rounds;
+}
+
+// --------------------------------------------------------------------------
+
+TcpInfoSampler::~TcpInfoSampler() {
+	stop();
+}
+
+END_NKF_NET
@@ -0,0 +1,205 @@
+/*
+ * TcpInfoSampler.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef TCPINFOSAMPLER_H_
+#define TCPINFOSAMPLER_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "net.h"
+#include "Socket.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * Implemented by users which want every sample of a TcpInfoSampler, e.g.
+ * to publish them to a monitoring system.
+ */
+class NKFNET_API TcpInfoListener {
+public:
+	/**
+	 * Called for each connection sampled.
+	 *
+	 * \param	name		The name the connection was added with.
+	 * \param	info		The new sample.
+	 * \param	previous	The previous sample, all 0 for the first one.
+	 */
+	virtual void	sampled(const std::string & name, const TcpInfo & info,
+			const TcpInfo & previous) = 0;
+
+	virtual ~TcpInfoListener() {}
+};
+
+/**
+ * TcpInfoSampler periodically takes a Socket::tcpInfo snapshot of a
+ * number of TCP connections, to tell whether a slow connection is held
+ * back by the network (retransmissions, a small congestion window) or
+ * by the receiver (a zero window).
+ *
+ * Each sample costs one getsockopt per connection. The latest sample of
+ * every connection can be requested at any time, new samples are passed
+ * to a listener, and can be logged:
+ *
+ * \code
+ * TcpInfoSampler sampler(1000);
+ * sampler.setLog(&std::clog);
+ * sampler.add(uplink, "storage-1");
+ * sampler.start();
+ * // ...
+ * TcpInfo info;
+ * if (sampler.last("storage-1", &info)) cout << info.rtt << " us" << endl;
+ * \endcode
+ *
+ * which logs lines like:
+ *
+ * \verbatim
+ * TcpInfoSampler: storage-1 rtt 180/40 us cwnd 10 in flight 14480 B retrans +0 rate 912 MB/s rwnd limited 73% sndbuf limited 0%
+ * \endverbatim
+ *
+ * where the limited percentages are the part of the time spent sending
+ * since the last sample. The sampler does not own the sockets, they must
+ * be removed before they are deleted. Linux only, thread safe.
+ */
+class NKFNET_API TcpInfoSampler {
+public:
+	/**
+	 * Creates a new sampler, without connections.
+	 *
+	 * \param	interval	The time between samples in milliseconds, when
+	 * 						started.
+	 */
+	TcpInfoSampler(unsigned int interval = 1000);
+
+	/**
+	 * Adds a connection.
+	 *
+	 * \param	sock	The connected TCP socket.
+	 * \param	name	The name to report the connection by.
+	 */
+	void	add(Socket & sock, const std::string & name);
+
+	/**
+	 * Removes a connection. When the call returns the socket is no longer
+	 * used, and may be deleted.
+	 *
+	 * \param	sock	The socket.
+	 */
+	void	remove(Socket & sock);
+
+	/**
+	 * Samples all connections now, in the calling thread.
+	 */
+	void	sample();
+
+	/**
+	 * Starts a thread sampling all connections every interval.
+	 */
+	void	start();
+
+	/**
+	 * Stops the sampling thread, if started.
+	 */
+	void	stop();
+
+	/**
+	 * Returns the latest sample of a connection.
+	 *
+	 * \param	name	The name of the connection.
+	 * \param	info	Receives the sample.
+	 *
+	 * \return	true if the connection has been sampled.
+	 */
+	bool	last(const std::string & name, TcpInfo * info);
+
+	/**
+	 * Changes the time between samples.
+	 *
+	 * \param	interval	The time in milliseconds.
+	 */
+	void	setInterval(unsigned int interval);
+
+	/**
+	 * Sets the listener for new samples. It is called from the thread
+	 * taking the sample.
+	 *
+	 * \param	listener	The listener, or NULL for none.
+	 */
+	void	setListener(TcpInfoListener * listener);
+
+	/**
+	 * Sets the stream to log the samples to. Default is none.
+	 *
+	 * \param	log		The stream to log to, or NULL to disable logging.
+	 */
+	void	setLog(std::ostream * log);
+
+	/**
+	 * Returns the number of rounds sampled.
+	 *
+	 * \return	The number of rounds.
+	 */
+	unsigned long samples();
+
+	/**
+	 * Stops the sampling thread.
+	 */
+	virtual ~TcpInfoSampler();
+
+private:
+	struct Connection {
+		Socket *		sock;
+		std::string		name;
+		TcpInfo			info;
+		bool			sampled;
+	};
+
+	struct Sample {
+		std::string		name;
+		TcpInfo			info;
+		TcpInfo			previous;
+	};
+
+	void	run();
+
+	void	log(std::ostream & out, const Sample & sample);
+
+	TcpInfoSampler(const TcpInfoSampler &);
+
+	TcpInfoSampler & operator=(const TcpInfoSampler &);
+
+	std::mutex				_lock;
+
+	std::condition_variable	_wake;
+
+	std::thread				_thread;
+
+	bool					_running;
+
+	unsigned int			_interval;
+
+	std::vector<Connection>	_connections;
+
+	std::vector<Sample>		_samples;	// of the current round
+
+	std::mutex				_sampling;	// one round at a time
+
+	unsigned long			_rounds;
+
+	TcpInfoListener *		_listener;
+
+	std::ostream *			_log;
+};
+
+END_NKF_NET
+
+#endif /* TCPINFOSAMPLER_H_ */
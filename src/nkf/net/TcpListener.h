@@ -0,0 +1,112 @@
+/*
+ * TcpListener.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef TCPLISTENER_H_
+#define TCPLISTENER_H_
+
+#include "net.h"
+#include "BasicSocket.h"
+#include "TcpSocket.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * TcpListener accepts TCP connections, the statically typed counterpart of
+ * a listening Socket(TCP). Accepted connections are returned by value as
+ * TcpSocket, so no heap allocation is needed per connection.
+ *
+ * \code
+ * TcpListener l;
+ * l.setReuseAddress(true);
+ * l.bind(Address(IP4(0,0,0,0), 5000));
+ * l.listen();
+ * std::vector<TcpSocket> clients;
+ * while (running) {
+ *   clients.push_back(l.accept());
+ * }
+ * \endcode
+ *
+ * See BasicSocket for ownership and moving.
+ */
+class NKFNET_API TcpListener final : public BasicSocket {
+public:
+	/**
+	 * Creates a new TCP socket for listening.
+	 */
+	TcpListener() : BasicSocket(AF_INET, SOCK_STREAM, IPPROTO_TCP) {
+	}
+
+	TcpListener(TcpListener && other) : BasicSocket(static_cast<BasicSocket&&> (other)) {
+	}
+
+	TcpListener & operator=(TcpListener && other) {
+		BasicSocket::operator=(static_cast<BasicSocket&&> (other));
+		return (*this);
+	}
+
+	/**
+	 * Allows binding to an address still in TIME_WAIT (SO_REUSEADDR).
+	 *
+	 * \param	reuse	If true, the address may be reused.
+	 */
+	void	setReuseAddress(bool reuse) {
+		setOption(SO_REUSEADDR, reuse ? 1 : 0);
+	}
+
+	/**
+	 * Binds to a local address.
+	 *
+	 * \param	addr	The address to bind to.
+	 */
+	void	bind(const Address & addr) {
+		bindTo(addr);
+	}
+
+	/**
+	 * Starts listening.
+	 *
+	 * \param	backlog	The maximum number of pending connections.
+	 */
+	void	listen(int backlog = SOMAXCONN) {
+		RoR(::listen(_handle, backlog));
+	}
+
+	/**
+	 * Accepts a connection. Blocks unless the listener is non-blocking.
+	 *
+	 * \return	The connection.
+	 */
+	TcpSocket accept() {
+		SOCKET handle = ::accept(_handle, NULL, NULL);
+		if (handle == INVALID_SOCKET)
+			SocketException::raiseLastError();
+		return TcpSocket(handle);
+	}
+
+	/**
+	 * Accepts a connection, and returns the address of the peer.
+	 *
+	 * \param	remote	Receives the address of the peer.
+	 *
+	 * \return			The connection.
+	 */
+	TcpSocket accept(Address * remote) {
+		sockaddr_un addr;	// large enough for any supported family
+		socklen_t size = sizeof(addr);
+		SOCKET handle = ::accept(_handle, reinterpret_cast<sockaddr*> (&addr), &size);
+		if (handle == INVALID_SOCKET)
+			SocketException::raiseLastError();
+		(*remote) = toAddress(reinterpret_cast<sockaddr*> (&addr), size);
+		return TcpSocket(handle);
+	}
+};
+
+END_NKF_NET
+
+#endif /* TCPLISTENER_H_ */
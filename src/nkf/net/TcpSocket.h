@@ -0,0 +1,171 @@
+/*
+ * TcpSocket.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef TCPSOCKET_H_
+#define TCPSOCKET_H_
+
+#include "net.h"
+#include "BasicSocket.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * TcpSocket is a connected TCP stream, the statically typed counterpart of
+ * Socket(TCP). It only offers what makes sense for a TCP connection, and
+ * the send and receive calls are inlined.
+ *
+ * \code
+ * TcpSocket s;
+ * s.connect(Address("daq-ctrl", 5000));
+ * s.setNoDelay(true);
+ * s.send(&cmd, sizeof(cmd));
+ * s.receive(&reply, sizeof(reply));
+ * \endcode
+ *
+ * Sending on a connection closed by the peer raises a SocketException
+ * instead of SIGPIPE, where the platform allows. See BasicSocket for
+ * ownership and moving.
+ */
+class NKFNET_API TcpSocket final : public BasicSocket {
+public:
+	/**
+	 * Creates a new, unconnected TCP socket.
+	 */
+	TcpSocket() : BasicSocket(AF_INET, SOCK_STREAM, IPPROTO_TCP) {
+	}
+
+	/**
+	 * Takes ownership of the handle of a connected TCP socket.
+	 *
+	 * \param	handle	The handle.
+	 */
+	explicit TcpSocket(SOCKET handle) : BasicSocket(handle) {
+	}
+
+	TcpSocket(TcpSocket && other) : BasicSocket(static_cast<BasicSocket&&> (other)) {
+	}
+
+	TcpSocket & operator=(TcpSocket && other) {
+		BasicSocket::operator=(static_cast<BasicSocket&&> (other));
+		return (*this);
+	}
+
+	/**
+	 * Connects to the given address.
+	 *
+	 * \param	addr	The address to connect to.
+	 */
+	void	connect(const Address & addr) {
+		connectTo(addr);
+	}
+
+	/**
+	 * Sends data. A non-blocking socket may send only part of it.
+	 *
+	 * \param	buf		The buffer to send.
+	 * \param	len		The length of the buffer in bytes.
+	 *
+	 * \return			The number of bytes send.
+	 */
+	size_t	send(const void * buf, size_t len) {
+		ssize_t bytes = ::send(_handle, static_cast<const char*> (buf), len, NKF_STREAM_SEND_FLAGS);
+		if (bytes < 0)
+			SocketException::raiseLastError();
+		return bytes;
+	}
+
+	/**
+	 * Sends all data, repeating the send as needed. Only for blocking
+	 * sockets.
+	 *
+	 * \param	buf		The buffer to send.
+	 * \param	len		The length of the buffer in bytes.
+	 */
+	void	sendAll(const void * buf, size_t len) {
+		const char * data = static_cast<const char*> (buf);
+		while (len > 0) {
+			size_t bytes = send(data, len);
+			data += bytes;
+			len -= bytes;
+		}
+	}
+
+#ifndef WIN32_API
+	/**
+	 * Sends a number of buffers at once, as if they were one buffer.
+	 * Posix only.
+	 *
+	 * \param	vec		The buffers to send.
+	 * \param	count	The number of buffers, at most IOV_MAX.
+	 *
+	 * \return			The number of bytes send.
+	 */
+	size_t	send(const iovec * vec, size_t count) {
+		msghdr msg = msghdr();
+		msg.msg_iov = const_cast<iovec*> (vec);
+		msg.msg_iovlen = count;
+		ssize_t bytes = ::sendmsg(_handle, &msg, NKF_STREAM_SEND_FLAGS);
+		if (bytes < 0)
+			SocketException::raiseLastError();
+		return bytes;
+	}
+#endif
+
+	/**
+	 * Receives data.
+	 *
+	 * \param	buf		The buffer to receive in.
+	 * \param	len		The length of the buffer in bytes.
+	 *
+	 * \return			The number of bytes received, 0 if the peer closed
+	 * 					the connection.
+	 */
+	size_t	receive(void * buf, size_t len) {
+		ssize_t bytes = ::recv(_handle, static_cast<char*> (buf), len, 0);
+		if (bytes < 0)
+			SocketException::raiseLastError();
+		return bytes;
+	}
+
+	/**
+	 * Shuts down sending, receiving or both.
+	 *
+	 * \param	how		SHUT_RD, SHUT_WR or SHUT_RDWR (SD_* on Windows).
+	 */
+	void	shutdown(int how) {
+		RoR(::shutdown(_handle, how));
+	}
+
+	/**
+	 * Enables or disables Nagle's algorithm (TCP_NODELAY).
+	 *
+	 * \param	noDelay	If true, small segments are sent right away.
+	 */
+	void	setNoDelay(bool noDelay) {
+		int value = noDelay ? 1 : 0;
+		setOption(IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+	}
+
+	/**
+	 * Returns the address of the peer. Not cached, so every call asks the
+	 * kernel.
+	 *
+	 * \return	The remote address.
+	 */
+	Address	remoteAddress() const {
+		sockaddr_un addr;	// large enough for any supported family
+		socklen_t size = sizeof(addr);
+		RoR(::getpeername(_handle, reinterpret_cast<sockaddr*> (&addr), &size));
+		return toAddress(reinterpret_cast<sockaddr*> (&addr), size);
+	}
+};
+
+END_NKF_NET
+
+#endif /* TCPSOCKET_H_ */
@@ -0,0 +1,139 @@
+/*
+ * UdpSocket.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef UDPSOCKET_H_
+#define UDPSOCKET_H_
+
+#include "net.h"
+#include "BasicSocket.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * UdpSocket is a UDP socket, the statically typed counterpart of
+ * Socket(UDP). The send and receive calls are inlined.
+ *
+ * \code
+ * UdpSocket s;
+ * s.bind(Address(IP4(0,0,0,0), 9000));
+ * Address from = Address::ANY;
+ * char buf[9000];
+ * size_t len = s.receive(buf, sizeof(buf), &from);
+ * s.send(buf, len, from);
+ * \endcode
+ *
+ * See BasicSocket for ownership and moving.
+ */
+class NKFNET_API UdpSocket final : public BasicSocket {
+public:
+	/**
+	 * Creates a new UDP socket.
+	 */
+	UdpSocket() : BasicSocket(AF_INET, SOCK_DGRAM, IPPROTO_UDP) {
+	}
+
+	/**
+	 * Takes ownership of the handle of a UDP socket.
+	 *
+	 * \param	handle	The handle.
+	 */
+	explicit UdpSocket(SOCKET handle) : BasicSocket(handle) {
+	}
+
+	UdpSocket(UdpSocket && other) : BasicSocket(static_cast<BasicSocket&&> (other)) {
+	}
+
+	UdpSocket & operator=(UdpSocket && other) {
+		BasicSocket::operator=(static_cast<BasicSocket&&> (other));
+		return (*this);
+	}
+
+	/**
+	 * Binds the socket to a local address.
+	 *
+	 * \param	addr	The address to bind to.
+	 */
+	void	bind(const Address & addr) {
+		bindTo(addr);
+	}
+
+	/**
+	 * Sets the default destination, and only receives from it.
+	 *
+	 * \param	addr	The address to connect to.
+	 */
+	void	connect(const Address & addr) {
+		connectTo(addr);
+	}
+
+	/**
+	 * Sends a datagram to the connected address.
+	 *
+	 * \param	buf		The buffer to send.
+	 * \param	len		The length of the buffer in bytes.
+	 *
+	 * \return			The number of bytes send.
+	 */
+	size_t	send(const void * buf, size_t len) {
+		ssize_t bytes = ::send(_handle, static_cast<const char*> (buf), len, 0);
+		if (bytes < 0)
+			SocketException::raiseLastError();
+		return bytes;
+	}
+
+	/**
+	 * Sends a datagram to the given address.
+	 *
+	 * \param	buf		The buffer to send.
+	 * \param	len		The length of the buffer in bytes.
+	 * \param	addr	The address to send the data to.
+	 *
+	 * \return			The number of bytes send.
+	 */
+	size_t	send(const void * buf, size_t len, const Address & addr) {
+		socklen_t size;
+		const sockaddr * to = native(addr, &size);
+		ssize_t bytes = ::sendto(_handle, static_cast<const char*> (buf), len, 0, to, size);
+		if (bytes < 0)
+			SocketException::raiseLastError();
+		return bytes;
+	}
+
+	/**
+	 * Receives a datagram.
+	 *
+	 * \param	buf		The buffer to receive in.
+	 * \param	len		The length of the buffer in bytes.
+	 *
+	 * \return			The number of bytes received, never exceeds len.
+	 */
+	size_t	receive(void * buf, size_t len) {
+		ssize_t bytes = ::recv(_handle, static_cast<char*> (buf), len, 0);
+		if (bytes < 0)
+			SocketException::raiseLastError();
+		return bytes;
+	}
+
+	/**
+	 * Receives a datagram, and its source address.
+	 *
+	 * \param	buf		The buffer to receive in.
+	 * \param	len		The length of the buffer in bytes.
+	 * \param	addr	Receives the address the datagram came from.
+	 *
+	 * \return			The number of bytes received, never exceeds len.
+	 */
+	size_t	receive(void * buf, size_t len, Address * addr) {
+		return receiveFrom(buf, len, addr);
+	}
+};
+
+END_NKF_NET
+
+#endif /* UDPSOCKET_H_ */
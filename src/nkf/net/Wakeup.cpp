@@ -0,0 +1,88 @@
+/*
+ * Wakeup.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "Wakeup.h"
+#include "SocketException.h"
+#include <stdint.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+START_NKF_NET
+
+/*
+ * '_pending' is set by the first wake() after a clear(), only that wake
+ * writes to the handle. clear() drains the handle first and only then
+ * resets '_pending' with an exchange, so it also sees everything done by
+ * the threads which skipped the write. Resetting first would let a wake()
+ * in between write to the handle, have that write drained, and leave
+ * '_pending' set, after which no wake() would ever write again.
+ */
+
+// --------------------------------------------------------------------------
+// Wakeup
+// --------------------------------------------------------------------------
+
+Wakeup::Wakeup() :
+	_fd(-1),
+	_writeFd(-1),
+	_pending(false) {
+#if defined(WIN32_API)
+	throw SocketException("Wakeup not supported on this platform", 0);
+#elif defined(__linux__)
+	_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (_fd < 0)
+		SocketException::raiseLastError();
+	_writeFd = _fd;
+#else
+	int fds[2];
+	RoR(::pipe(fds));
+	for (int i = 0; i < 2; ++i) {
+		::fcntl(fds[i], F_SETFL, ::fcntl(fds[i], F_GETFL, 0) | O_NONBLOCK);
+		::fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+	}
+	_fd = fds[0];
+	_writeFd = fds[1];
+#endif
+}
+
+// --------------------------------------------------------------------------
+
+void Wakeup::wake() {
+	if (_pending.exchange(true))
+		return;		// already woken
+	uint64_t one = 1;
+	// can only fail when the handle is full, which means woken anyway
+	ssize_t rc = ::write(_writeFd, &one, _writeFd == _fd ? sizeof(one) : 1);
+	(void) rc;
+}
+
+// --------------------------------------------------------------------------
+
+bool Wakeup::clear() {
+	uint64_t value;
+	while (::read(_fd, &value, sizeof(value)) > 0) {
+		if (_writeFd == _fd) break;		// an eventfd is reset by one read
+	}
+	return _pending.exchange(false);
+}
+
+// --------------------------------------------------------------------------
+
+SOCKET Wakeup::handle() {
+	return _fd;
+}
+
+// --------------------------------------------------------------------------
+
+Wakeup::~Wakeup() {
+	if (_writeFd != _fd) ::close(_writeFd);
+	::close(_fd);
+}
+
+END_NKF_NET
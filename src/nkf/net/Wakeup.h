@@ -0,0 +1,92 @@
+/*
+ * Wakeup.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef WAKEUP_H_
+#define WAKEUP_H_
+
+#include <atomic>
+#include "net.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * Wakeup lets any thread wake an I/O thread which is blocked in
+ * SocketSet::select. The I/O thread adds the handle to its read set, and
+ * clears the wakeup when it becomes readable.
+ *
+ * \code
+ * Wakeup wakeup;
+ * // I/O thread:
+ * while (running) {
+ *   SocketSet read(sock);
+ *   read.set(wakeup.handle());
+ *   SocketSet::select(&read, NULL, NULL, FOREVER);
+ *   if (read.isSet(wakeup.handle())) {
+ *     wakeup.clear();
+ *     // check what other threads asked for
+ *   }
+ *   // ...
+ * }
+ * // any other thread:
+ * running = false;
+ * wakeup.wake();
+ * \endcode
+ *
+ * Multiple wakes before the I/O thread clears are combined, and only the
+ * first costs a system call. Uses an eventfd on Linux, a pipe on other
+ * Posix systems. Not supported on Windows.
+ */
+class NKFNET_API Wakeup {
+public:
+	/**
+	 * Creates a new wakeup.
+	 */
+	Wakeup();
+
+	/**
+	 * Makes the handle readable. May be called from any thread, and from a
+	 * signal handler.
+	 */
+	void	wake();
+
+	/**
+	 * Makes the handle unreadable again. Call before handling whatever the
+	 * wake was for, so that a wake during handling is not lost.
+	 *
+	 * \return	true if the wakeup was woken since the last clear.
+	 */
+	bool	clear();
+
+	/**
+	 * Returns the handle, to be added to the read set of a SocketSet.
+	 *
+	 * \return	The handle.
+	 */
+	SOCKET	handle();
+
+	/**
+	 * Closes the handle.
+	 */
+	virtual ~Wakeup();
+
+private:
+	Wakeup(const Wakeup &);
+
+	Wakeup & operator=(const Wakeup &);
+
+	int					_fd;
+
+	int					_writeFd;
+
+	std::atomic<bool>	_pending;
+};
+
+END_NKF_NET
+
+#endif /* WAKEUP_H_ */
@@ -0,0 +1,270 @@
+/*
+ * WorkerPool.cpp
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "WorkerPool.h"
+#include "SocketException.h"
+
+START_NKF_NET
+
+/*
+ * Each queue has its own lock, held only to push or pop one entry, or by
+ * a thief to take half the queue from the back. The owner pops from the
+ * front, so it keeps the order of submission and contends with a thief
+ * only when the queue is nearly empty.
+ *
+ * '_pending' counts the tasks in all queues; it is raised before a task
+ * is pushed and lowered when it is taken. A worker which finds no work
+ * raises '_sleeping' under '_idleLock' before it checks '_pending' and
+ * waits, and a submitter raises '_pending' before it checks '_sleeping',
+ * so one of the two always sees the other and no wakeup is lost.
+ *
+ * Keys are hashed to a slot in '_affinity', which holds the worker to
+ * submit to; a thief takes over the slots of the tasks it steals.
+ */
+
+static const size_t		AFFINITY_SLOTS = 4096;
+
+static const uint32_t	NO_AFFINITY = 0xffffffff;
+
+static const size_t		MAX_STEAL = 32;		// tasks taken at once
+
+static thread_local WorkerPool *	currentPool = NULL;
+
+static thread_local size_t			currentWorker = 0;
+
+// --------------------------------------------------------------------------
+// WorkerPool
+// --------------------------------------------------------------------------
+
+WorkerPool::WorkerPool(size_t workers) :
+	_affinity(AFFINITY_SLOTS),
+	_next(0),
+	_pending(0),
+	_sleeping(0),
+	_stopping(false),
+	_failures(0),
+	_stopped(false) {
+	if (workers == 0) workers = std::thread::hardware_concurrency();
+	if (workers == 0) workers = 1;
+
+	for (size_t i = 0; i < AFFINITY_SLOTS; ++i) {
+		_affinity[i].store(static_cast<uint32_t> (i % workers));
+	}
+	for (size_t i = 0; i < workers; ++i) {
+		_workers.push_back(new Worker());
+		_workers[i]->random = static_cast<uint32_t> (i * 2654435761U + 1);
+	}
+	for (size_t i = 0; i < workers; ++i) {
+		_workers[i]->thread = std::thread(&WorkerPool::run, this, i);
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void WorkerPool::submit(const Task & task) {
+	size_t worker = currentPool == this ? currentWorker :
+			_next.fetch_add(1, std::memory_order_relaxed) % _workers.size();
+	push(worker, task, NO_AFFINITY);
+}
+
+// --------------------------------------------------------------------------
+
+void WorkerPool::submit(uint64_t key, const Task & task) {
+	uint32_t slot = static_cast<uint32_t> ((key * 0x9e3779b97f4a7c15ULL) >> 52);	// 4096 slots
+	push(_affinity[slot].load(std::memory_order_relaxed), task, slot);
+}
+
+// --------------------------------------------------------------------------
+
+void WorkerPool::push(size_t worker, const Task & task, uint32_t affinity) {
+	// tasks run during shutdown may still submit
+	if (_stopping.load() && currentPool != this)
+		throw SocketException("Worker pool shut down", EPIPE);
+
+	_pending.fetch_add(1);
+	Worker & w = *_workers[worker];
+	{
+		std::lock_guard<std::mutex> lock(w.lock);
+		Entry entry = { task, affinity };
+		w.tasks.push_back(entry);
+		w.size.store(w.tasks.size(), std::memory_order_relaxed);
+	}
+	if (_sleeping.load() > 0) {
+		std::lock_guard<std::mutex> lock(_idleLock);
+		_idle.notify_one();
+	}
+}
+
+// --------------------------------------------------------------------------
+
+bool WorkerPool::pop(size_t worker, Entry & entry) {
+	Worker & w = *_workers[worker];
+	if (w.size.load(std::memory_order_relaxed) == 0) return false;
+
+	std::lock_guard<std::mutex> lock(w.lock);
+	if (w.tasks.empty()) return false;
+	entry = std::move(w.tasks.front());
+	w.tasks.pop_front();
+	w.size.store(w.tasks.size(), std::memory_order_relaxed);
+	return true;
+}
+
+// --------------------------------------------------------------------------
+
+bool WorkerPool::steal(size_t worker, Entry & entry) {
+	Worker & self = *_workers[worker];
+	size_t count = _workers.size();
+	if (count < 2) return false;
+
+	// xorshift32, start at a random victim and try all
+	self.random ^= self.random << 13;
+	self.random ^= self.random >> 17;
+	self.random ^= self.random << 5;
+	size_t start = self.random % count;
+
+	for (size_t n = 0; n < count; ++n) {
+		size_t index = (start + n) % count;
+		if (index == worker) continue;
+		Worker & victim = *_workers[index];
+		if (victim.size.load(std::memory_order_relaxed) == 0) continue;
+
+		std::vector<Entry> taken;
+		{
+			std::lock_guard<std::mutex> lock(victim.lock);
+			size_t take = (victim.tasks.size() + 1) / 2;
+			if (take > MAX_STEAL) take = MAX_STEAL;
+			for (size_t i = 0; i < take; ++i) {
+				taken.push_back(std::move(victim.tasks.back()));
+				victim.tasks.pop_back();
+			}
+			victim.size.store(victim.tasks.size(), std::memory_order_relaxed);
+		}
+		if (taken.empty()) continue;
+
+		victim.stolen.fetch_add(taken.size(), std::memory_order_relaxed);
+		self.steals.fetch_add(taken.size(), std::memory_order_relaxed);
+		for (size_t i = 0; i < taken.size(); ++i) {
+			if (taken[i].affinity != NO_AFFINITY)
+				_affinity[taken[i].affinity].store(static_cast<uint32_t> (worker), std::memory_order_relaxed);
+		}
+
+		// run the oldest, queue the rest in their original order
+		entry = std::move(taken.back());
+		if (taken.size() > 1) {
+			std::lock_guard<std::mutex> lock(self.lock);
+			for (size_t i = taken.size() - 1; i-- > 0; ) {
+				self.tasks.push_back(std::move(taken[i]));
+			}
+			self.size.store(self.tasks.size(), std::memory_order_relaxed);
+		}
+		return true;
+	}
+	return false;
+}
+
+// --------------------------------------------------------------------------
+
+void WorkerPool::run(size_t worker) {
+	currentPool = this;
+	currentWorker = worker;
+	Worker & self = *_workers[worker];
+
+	Entry entry;
+	for (;;) {
+		if (pop(worker, entry) || steal(worker, entry)) {
+			_pending.fetch_sub(1);
+			try {
+				entry.task();
+			} catch (...) {
+				_failures.fetch_add(1, std::memory_order_relaxed);
+			}
+			entry.task = nullptr;
+			self.executed.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(_idleLock);
+		_sleeping.fetch_add(1);
+		while (_pending.load() == 0 && !_stopping.load()) {
+			_idle.wait(lock);
+		}
+		_sleeping.fetch_sub(1);
+		if (_pending.load() == 0 && _stopping.load()) break;
+	}
+
+	currentPool = NULL;
+}
+
+// --------------------------------------------------------------------------
+
+void WorkerPool::shutdown() {
+	if (_stopped) return;
+	{
+		std::lock_guard<std::mutex> lock(_idleLock);
+		_stopping.store(true);
+		_idle.notify_all();
+	}
+	for (size_t i = 0; i < _workers.size(); ++i) {
+		_workers[i]->thread.join();
+	}
+	_stopped = true;
+}
+
+// --------------------------------------------------------------------------
+
+size_t WorkerPool::workers() {
+	return _workers.size();
+}
+
+// --------------------------------------------------------------------------
+
+size_t WorkerPool::queued() {
+	size_t total = 0;
+	for (size_t i = 0; i < _workers.size(); ++i) {
+		total += _workers[i]->size.load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long WorkerPool::steals() {
+	unsigned long long total = 0;
+	for (size_t i = 0; i < _workers.size(); ++i) {
+		total += _workers[i]->steals.load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+// --------------------------------------------------------------------------
+
+unsigned long long WorkerPool::failures() {
+	return _failures.load(std::memory_order_relaxed);
+}
+
+// --------------------------------------------------------------------------
+
+WorkerPool::WorkerStats WorkerPool::stats(size_t worker) {
+	Worker & w = *_workers[worker];
+	WorkerStats stats;
+	stats.queued = w.size.load(std::memory_order_relaxed);
+	stats.executed = w.executed.load(std::memory_order_relaxed);
+	stats.steals = w.steals.load(std::memory_order_relaxed);
+	stats.stolen = w.stolen.load(std::memory_order_relaxed);
+	return stats;
+}
+
+// --------------------------------------------------------------------------
+
+WorkerPool::~WorkerPool() {
+	shutdown();
+	for (size_t i = 0; i < _workers.size(); ++i) {
+		delete _workers[i];
+	}
+}
+
+END_NKF_NET
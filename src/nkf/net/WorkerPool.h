@@ -0,0 +1,208 @@
+/*
+ * WorkerPool.h
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#ifndef WORKERPOOL_H_
+#define WORKERPOOL_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "net.h"
+
+/** \file */
+
+START_NKF_NET
+
+/**
+ * WorkerPool runs tasks, such as connection handlers, on a fixed set of
+ * worker threads which balance the load by stealing work from each other.
+ *
+ * Every worker has its own queue. A worker runs the tasks of its own queue
+ * in order, and when it runs out, it takes half the queue of a randomly
+ * chosen busy worker, so a few hot connections do not pile up on one
+ * thread while others sit idle.
+ *
+ * Tasks submitted with a key, e.g. the handle of a connection, go to the
+ * worker which ran the last task with that key, so the state of the
+ * connection stays warm in its cache. When a task is stolen, the key
+ * moves with it to the thief.
+ *
+ * \code
+ * WorkerPool pool;
+ * // readiness loop, a connection goes back in master when its handler is done
+ * read = master;
+ * SocketSet::select(&read, NULL, NULL, FOREVER);
+ * for (...) {
+ *     if (read.isSet(*conn)) {
+ *         master.clear(*conn);	// not again until the handler is done
+ *         pool.submit(conn->handle(), [conn] { handle(conn); });
+ *     }
+ * }
+ * \endcode
+ *
+ * Tasks with the same key run one after the other as long as they stay on
+ * one worker, but a stolen task may run at the same time as one left
+ * behind. A readiness loop which only schedules a connection again after
+ * its handler is done never has two at once.
+ *
+ * Tasks should not throw; an exception which escapes a task is dropped,
+ * and counted.
+ */
+class NKFNET_API WorkerPool {
+public:
+	/**
+	 * A task, any callable without arguments.
+	 */
+	typedef std::function<void()> Task;
+
+	/**
+	 * Statistics of one worker.
+	 */
+	struct WorkerStats {
+		/** The number of tasks in its queue. */
+		size_t				queued;
+		/** The number of tasks it ran. */
+		unsigned long long	executed;
+		/** The number of tasks it stole from others. */
+		unsigned long long	steals;
+		/** The number of tasks others stole from it. */
+		unsigned long long	stolen;
+	};
+
+	/**
+	 * Creates a new pool, and starts its workers.
+	 *
+	 * \param	workers		The number of workers, 0 for one per processor.
+	 */
+	WorkerPool(size_t workers = 0);
+
+	/**
+	 * Submits a task. From a worker of the pool, the task goes to the queue
+	 * of that worker, else the workers take turns.
+	 *
+	 * \param	task	The task.
+	 */
+	void	submit(const Task & task);
+
+	/**
+	 * Submits a task to the worker which ran the last task with the key.
+	 *
+	 * \param	key		The key, e.g. the handle of the connection.
+	 * \param	task	The task.
+	 */
+	void	submit(uint64_t key, const Task & task);
+
+	/**
+	 * Runs the tasks still queued and stops the workers. After, only tasks
+	 * which are still running may submit.
+	 */
+	void	shutdown();
+
+	/**
+	 * Returns the number of workers.
+	 *
+	 * \return	The number of workers.
+	 */
+	size_t	workers();
+
+	/**
+	 * Returns the number of tasks queued on all workers.
+	 *
+	 * \return	The number of tasks.
+	 */
+	size_t	queued();
+
+	/**
+	 * Returns the number of tasks stolen by all workers.
+	 *
+	 * \return	The number of tasks.
+	 */
+	unsigned long long steals();
+
+	/**
+	 * Returns the number of tasks which threw an exception.
+	 *
+	 * \return	The number of tasks.
+	 */
+	unsigned long long failures();
+
+	/**
+	 * Returns the statistics of one worker.
+	 *
+	 * \param	worker	The index of the worker, below workers().
+	 *
+	 * \return	The statistics.
+	 */
+	WorkerStats stats(size_t worker);
+
+	/**
+	 * Runs the tasks still queued and stops the workers.
+	 */
+	virtual ~WorkerPool();
+
+private:
+	struct Entry {
+		Task				task;
+		uint32_t			affinity;	// slot in _affinity, or NO_AFFINITY
+	};
+
+	struct Worker {
+		Worker() : size(0), executed(0), steals(0), stolen(0), random(0) {
+		}
+
+		std::mutex					lock;
+		std::deque<Entry>			tasks;
+		std::atomic<size_t>			size;
+		std::atomic<unsigned long long> executed;
+		std::atomic<unsigned long long> steals;
+		std::atomic<unsigned long long> stolen;
+		uint32_t					random;		// victim selection, worker only
+		std::thread					thread;
+		char						pad[64];	// keep workers off each other's cache lines
+	};
+
+	void	push(size_t worker, const Task & task, uint32_t affinity);
+
+	bool	pop(size_t worker, Entry & entry);
+
+	bool	steal(size_t worker, Entry & entry);
+
+	void	run(size_t worker);
+
+	WorkerPool(const WorkerPool &);
+
+	WorkerPool & operator=(const WorkerPool &);
+
+	std::vector<Worker *>			_workers;
+
+	std::vector<std::atomic<uint32_t> > _affinity;	// key slot to worker
+
+	std::atomic<size_t>				_next;		// round robin for outsiders
+
+	std::atomic<size_t>				_pending;	// tasks queued on all workers
+
+	std::atomic<size_t>				_sleeping;
+
+	std::atomic<bool>				_stopping;
+
+	std::atomic<unsigned long long>	_failures;
+
+	std::mutex						_idleLock;
+
+	std::condition_variable			_idle;
+
+	bool							_stopped;
+};
+
+END_NKF_NET
+
+#endif /* WORKERPOOL_H_ */
@@ -44,8 +44,13 @@
 #ifdef WIN32_API
 #include <winsock2.h>
 #include <Ws2tcpip.h>
+#include <afunix.h>
 // For compatibility with Linux
 typedef int socklent_t;
+#ifdef _MSC_VER
+#include <BaseTsd.h>
+typedef SSIZE_T ssize_t;
+#endif
 #else
 // Linux
 #include <arpa/inet.h>
@@ -56,7 +61,15 @@ typedef int socklent_t;
 #include <signal.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/un.h>
+#include <sys/uio.h>
 #include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/sockios.h>
+#endif
 // For compatibility with Windows
 typedef int SOCKET;
 #define INVALID_SOCKET -1
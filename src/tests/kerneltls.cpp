@@ -0,0 +1,127 @@
+/*
+ * kerneltls.cpp
+ *
+ * Runs KernelTls handshakes over the loopback interface with the
+ * self-signed certificates in this directory, exchanges data through the
+ * kernel, and checks that an untrusted certificate and a wrong server
+ * name are rejected. Skipped (77) when the kernel or the library has no
+ * kTLS support.
+ *
+ * The certificates (CN=localhost, valid until 2126) were made with:
+ *   openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 \
+ *     -nodes -days 36500 -subj /CN=localhost \
+ *     -addext subjectAltName=DNS:localhost \
+ *     -keyout tls-key.pem -out tls-cert.pem
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "nkf/net/KernelTls.h"
+#include "nkf/net/SocketException.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace nkf::net;
+
+static const unsigned short PORT = 47041;
+
+static const int SKIP = 77;
+
+static std::string dir;
+
+// --------------------------------------------------------------------------
+
+// Accepts one connection, runs the handshake with the given certificate,
+// and echoes one message.
+static void serve(Socket & listener, const std::string & cert, bool * ok) {
+	*ok = false;
+	Socket * conn = NULL;
+	try {
+		conn = listener.accept();
+		KernelTls tls(TLS_SERVER);
+		tls.setCertificate(dir + cert + "-cert.pem", dir + cert + "-key.pem");
+		tls.handshake(*conn);
+		char buf[64];
+		size_t len = conn->receive(buf, sizeof(buf));
+		conn->send(buf, len);
+		*ok = true;
+	} catch (SocketException &) {
+		// the client rejected the certificate
+	}
+	delete conn;
+}
+
+// --------------------------------------------------------------------------
+
+// Connects to a server presenting cert, trusting the first certificate
+// only, and checks that the handshake succeeds when it should.
+static bool exchange(Socket & listener, const std::string & cert,
+		const std::string & serverName, bool expected) {
+	bool served = false;
+	std::thread server(serve, std::ref(listener), cert, &served);
+
+	bool ok = false;
+	try {
+		Socket sock(TCP);
+		sock.connect(Address("127.0.0.1", PORT));
+		KernelTls tls(TLS_CLIENT);
+		tls.setTrustedCertificates(dir + "tls-cert.pem");
+		try {
+			tls.handshake(sock, serverName);
+		} catch (SocketException & se) {
+			if (expected)
+				std::cerr << "handshake with " << cert << " failed: " << se.what() << std::endl;
+			sock.close();
+			server.join();
+			return !expected && !served;
+		}
+
+		static const char hello[] = "hello through the kernel";
+		char buf[64];
+		sock.send(hello, sizeof(hello));
+		size_t len = sock.receive(buf, sizeof(buf));
+		ok = len == sizeof(hello) && memcmp(buf, hello, len) == 0;
+		if (!ok)
+			std::cerr << "echo through kTLS differs" << std::endl;
+	} catch (SocketException & se) {
+		std::cerr << "client: " << se.what() << std::endl;
+	}
+	server.join();
+
+	if (!expected) {
+		std::cerr << "handshake with " << cert << " as " << serverName
+				<< " accepted" << std::endl;
+		return false;
+	}
+	return ok && served;
+}
+
+// --------------------------------------------------------------------------
+
+int main() {
+	if (!KernelTls::supported()) {
+		std::cerr << "kerneltls: kTLS not available, skipped" << std::endl;
+		return SKIP;
+	}
+	const char * srcdir = getenv("srcdir");
+	dir = std::string(srcdir != NULL ? srcdir : ".") + "/tests/";
+
+	try {
+		Socket listener(TCP);
+		listener.setOption(SO_REUSEADDR, 1);
+		listener.bind(Address("127.0.0.1", PORT));
+		listener.listen();
+
+		bool ok = exchange(listener, "tls", "localhost", true);
+		ok &= exchange(listener, "tls-other", "localhost", false);
+		ok &= exchange(listener, "tls", "daq02", false);
+		return ok ? 0 : 1;
+	} catch (SocketException & se) {
+		std::cerr << "kerneltls: " << se.what() << std::endl;
+		return 1;
+	}
+}
@@ -0,0 +1,140 @@
+/*
+ * nkfreplay.cpp
+ *
+ * Sends the datagrams of a capture file, written by CaptureRecorder, to a
+ * destination: at the original timing, scaled, or as fast as possible.
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "nkf/net/Capture.h"
+#include "nkf/net/SocketException.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+
+using namespace nkf::net;
+
+static const unsigned long long NANOS = 1000000000ULL;
+
+// Datagrams due within this time are sent in the same batch
+static const unsigned long long BATCH_WINDOW = 50000ULL;	// 50 us
+
+// --------------------------------------------------------------------------
+
+static void usage() {
+	std::cerr << "Usage: nkfreplay [options] <capture file> <host:port>" << std::endl
+			<< "  -s <factor>  replay <factor> times faster than captured (default 1)" << std::endl
+			<< "  -f           replay as fast as possible" << std::endl
+			<< "  -b <count>   datagrams per batched send (default 32)" << std::endl
+			<< "  -l <loops>   replay the capture <loops> times (default 1)" << std::endl;
+	exit(2);
+}
+
+// --------------------------------------------------------------------------
+
+static unsigned long long now() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NANOS + ts.tv_nsec;
+}
+
+// --------------------------------------------------------------------------
+
+static void sleepUntil(unsigned long long time) {
+	timespec ts;
+	ts.tv_sec = time / NANOS;
+	ts.tv_nsec = time % NANOS;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+// --------------------------------------------------------------------------
+
+// Capture times come from CLOCK_REALTIME, which may step backwards
+static unsigned long long sinceFirst(unsigned long long timestamp, unsigned long long first) {
+	return timestamp > first ? timestamp - first : 0;
+}
+
+// --------------------------------------------------------------------------
+
+int main(int argc, char ** argv) {
+	double speed = 1.0;
+	bool fast = false;
+	size_t batchSize = 32;
+	unsigned long loops = 1;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "s:fb:l:")) != -1) {
+		switch (opt) {
+		case 's': speed = atof(optarg); break;
+		case 'f': fast = true; break;
+		case 'b': batchSize = strtoul(optarg, NULL, 10); break;
+		case 'l': loops = strtoul(optarg, NULL, 10); break;
+		default: usage();
+		}
+	}
+	if (argc - optind != 2 || speed <= 0 || batchSize == 0) usage();
+
+	std::string dest(argv[optind + 1]);
+	size_t colon = dest.rfind(':');
+	if (colon == std::string::npos) usage();
+
+	try {
+		CaptureReader capture(argv[optind]);
+		Address to(dest.substr(0, colon), atoi(dest.substr(colon + 1).c_str()));
+		Socket sock(UDP);
+
+		std::vector<Datagram> batch(batchSize);
+		unsigned long long sent = 0, bytes = 0;
+		unsigned long long start = now();
+
+		for (unsigned long loop = 0; loop < loops; ++loop) {
+			capture.rewind();
+			CapturedDatagram dgram;
+			bool more = capture.next(dgram);
+			unsigned long long first = dgram.timestamp;
+			unsigned long long loopStart = now();
+
+			while (more) {
+				size_t count = 0;
+				unsigned long long due = loopStart +
+						static_cast<unsigned long long> (sinceFirst(dgram.timestamp, first) / speed);
+				if (!fast && due > now()) sleepUntil(due);
+
+				unsigned long long horizon = now() + BATCH_WINDOW;
+				do {
+					batch[count].data = dgram.data;
+					batch[count].length = dgram.length;
+					batch[count].addr = &to;
+					bytes += dgram.length;
+					++count;
+					more = capture.next(dgram);
+					due = loopStart + static_cast<unsigned long long> (sinceFirst(dgram.timestamp, first) / speed);
+				} while (more && count < batchSize && (fast || due <= horizon));
+
+				size_t done = 0;
+				while (done < count) {
+					done += sock.sendBatch(&batch[done], count - done);
+				}
+				sent += count;
+			}
+		}
+
+		double elapsed = (now() - start) / 1e9;
+		std::cout << "Sent " << sent << " datagrams, " << bytes << " bytes in "
+				<< elapsed << " s";
+		if (elapsed > 0) {
+			std::cout << " (" << sent / elapsed << " datagrams/s, "
+					<< bytes * 8 / elapsed / 1e6 << " Mb/s)";
+		}
+		std::cout << std::endl;
+	} catch (const SocketException & se) {
+		std::cerr << "nkfreplay: " << se.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * nkftrace.cpp
+ *
+ * Prints a trace file, written by SocketTrace, as a timeline of the socket
+ * calls of all threads.
+ *
+ *  Created on: 19 oct. 2026
+ *      Author: vincentb
+ */
+
+#include "nkf/net/SocketTrace.h"
+#include "nkf/net/SocketException.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+
+using namespace nkf::net;
+
+static const unsigned long long NANOS = 1000000000ULL;
+
+// --------------------------------------------------------------------------
+
+static void usage() {
+	std::cerr << "Usage: nkftrace [options] <trace file>" << std::endl
+			<< "  -t <thread>  only the calls of thread <thread>" << std::endl
+			<< "  -h <handle>  only the calls on socket <handle>" << std::endl
+			<< "  -s           print a summary per operation instead" << std::endl;
+	exit(2);
+}
+
+// --------------------------------------------------------------------------
+
+// The argument as documented for each TraceOp
+static std::string formatArg(const TraceEvent & ev) {
+	char buf[64];
+	switch (ev.op) {
+	case TRACE_SET_OPTION:
+	case TRACE_GET_OPTION:
+		snprintf(buf, sizeof(buf), "level %u option %u",
+				static_cast<unsigned> (ev.arg >> 32), static_cast<unsigned> (ev.arg & 0xffffffff));
+		break;
+	case TRACE_CONNECT:
+	case TRACE_BIND:
+		snprintf(buf, sizeof(buf), "%u.%u.%u.%u:%u",
+				static_cast<unsigned> (ev.arg >> 40) & 0xff, static_cast<unsigned> (ev.arg >> 32) & 0xff,
+				static_cast<unsigned> (ev.arg >> 24) & 0xff, static_cast<unsigned> (ev.arg >> 16) & 0xff,
+				static_cast<unsigned> (ev.arg & 0xffff));
+		break;
+	case TRACE_SELECT:
+		if (ev.arg == ~0ULL) return "forever";
+		snprintf(buf, sizeof(buf), "%llu us", static_cast<unsigned long long> (ev.arg));
+		break;
+	case TRACE_CLOSE:
+	case TRACE_ACCEPT:
+		return "";
+	default:
+		snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long> (ev.arg));
+	}
+	return buf;
+}
+
+// --------------------------------------------------------------------------
+
+static void printTimeline(const TraceReader & trace, int thread, long handle) {
+	const std::vector<TraceRecord> & records = trace.records();
+	unsigned long long first = records.empty() ? 0 : records[0].time;
+
+	for (size_t i = 0; i < records.size(); ++i) {
+		const TraceRecord & rec = records[i];
+		if (thread >= 0 && rec.thread != thread) continue;
+		if (handle >= 0 && rec.event.handle != handle) continue;
+
+		time_t secs = rec.time / NANOS;
+		tm local;
+		localtime_r(&secs, &local);
+		char when[32];
+		strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &local);
+
+		char result[64];
+		if (rec.event.flags & TRACE_FAILED) {
+			snprintf(result, sizeof(result), "failed: %s",
+					strerror(static_cast<int> (-rec.event.result)));
+		} else {
+			snprintf(result, sizeof(result), "= %lld", static_cast<long long> (rec.event.result));
+		}
+
+		char line[256];
+		snprintf(line, sizeof(line), "%s.%09llu +%.6f  %6d  fd %-4d %-16s %-24s %-24s %10.1f us",
+				when, rec.time % NANOS, (rec.time - first) / 1e9, rec.thread,
+				rec.event.handle, SocketTrace::opName(rec.event.op), formatArg(rec.event).c_str(),
+				result, rec.duration / 1e3);
+		std::cout << line << std::endl;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+static void printSummary(const TraceReader & trace, int thread, long handle) {
+	static const int OPS = TRACE_SELECT + 1;
+	unsigned long long calls[OPS] = { 0 }, failed[OPS] = { 0 };
+	unsigned long long total[OPS] = { 0 }, longest[OPS] = { 0 };
+
+	const std::vector<TraceRecord> & records = trace.records();
+	for (size_t i = 0; i < records.size(); ++i) {
+		const TraceRecord & rec = records[i];
+		if (thread >= 0 && rec.thread != thread) continue;
+		if (handle >= 0 && rec.event.handle != handle) continue;
+		if (rec.event.op >= OPS) continue;
+		int op = rec.event.op;
+		++calls[op];
+		if (rec.event.flags & TRACE_FAILED) ++failed[op];
+		total[op] += rec.duration;
+		if (rec.duration > longest[op]) longest[op] = rec.duration;
+	}
+
+	char line[128];
+	snprintf(line, sizeof(line), "%-16s %10s %8s %12s %12s", "operation", "calls", "failed",
+			"mean us", "max us");
+	std::cout << line << std::endl;
+	for (int op = 1; op < OPS; ++op) {
+		if (calls[op] == 0) continue;
+		snprintf(line, sizeof(line), "%-16s %10llu %8llu %12.2f %12.2f", SocketTrace::opName(op),
+				calls[op], failed[op], total[op] / 1e3 / calls[op], longest[op] / 1e3);
+		std::cout << line << std::endl;
+	}
+}
+
+// --------------------------------------------------------------------------
+
+int main(int argc, char ** argv) {
+	int thread = -1;
+	long handle = -1;
+	bool summary = false;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "t:h:s")) != -1) {
+		switch (opt) {
+		case 't': thread = atoi(optarg); break;
+		case 'h': handle = atol(optarg); break;
+		case 's': summary = true; break;
+		default: usage();
+		}
+	}
+	if (argc - optind != 1) usage();
+
+	try {
+		TraceReader trace(argv[optind]);
+		if (summary) {
+			printSummary(trace, thread, handle);
+		} else {
+			printTimeline(trace, thread, handle);
+		}
+	} catch (const SocketException & se) {
+		std::cerr << "nkftrace: " << se.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}